@@ -12,6 +12,12 @@
 using namespace std;
 using namespace rapidjson;
 
+/**
+ * The smallest set of readings that is divided between the worker
+ * threads if the configuration does not give one
+ */
+#define DEFAULT_PARALLEL_BATCH	1000
+
 /**
  * Construct an asset filter. Call the base class constructor
  * and handle the configuration.
@@ -21,38 +27,84 @@ AssetFilter::AssetFilter(const std::string& filterName,
 				OUTPUT_HANDLE *outHandle,
 				OUTPUT_STREAM out) :
 					FledgeFilter(filterName, filterConfig, 
-                                                outHandle, out)
+                                                outHandle, out),
+					m_requested(0), m_compiled(0), m_shutdown(false)
 {
-	m_defaultRule = NULL;
 	m_logger = Logger::getLogger();
 	m_instanceName = filterConfig.getName();
 	handleConfig(filterConfig);
 }
 
 /**
- * Destructor for the asset filter
+ * Destructor for the asset filter. Stop the thread that compiles
+ * new rule sets, waiting for any rule set it is building.
  */
 AssetFilter::~AssetFilter()
 {
-	// Remove any rules
-	for (auto& r : m_rules)
-		delete r;
-	if (m_defaultRule)
-		delete m_defaultRule;
+	{
+		lock_guard<mutex> guard(m_compileMutex);
+		m_shutdown = true;
+		m_compileCV.notify_all();
+	}
+	if (m_compiler.joinable())
+		m_compiler.join();
 }
 
 /**
- * Handle the configuration of the asset filter
+ * Handle the configuration of the asset filter. A new rule set is
+ * built and compiled, then replaces the current rule set. Readings that
+ * are being processed by the current rule set are unaffected, the
+ * current rule set is deleted once they have been processed.
  *
  * @param category	The configuration category
  */
 void AssetFilter::handleConfig(ConfigCategory& category)
 {
 	lock_guard<mutex> guard(m_configMutex);
-	// Remove any rules
-	for (auto& r : m_rules)
-		delete r;
-	m_rules.clear();
+	unsigned int threads = 1;
+	if (category.itemExists("workerThreads"))
+		threads = strtoul(category.getValue("workerThreads").c_str(), NULL, 10);
+	unsigned int batchSize = DEFAULT_PARALLEL_BATCH;
+	if (category.itemExists("parallelBatchSize"))
+		batchSize = strtoul(category.getValue("parallelBatchSize").c_str(), NULL, 10);
+	if (threads > MAX_WORKER_THREADS)
+		m_logger->warn("The number of worker threads is limited to %d", MAX_WORKER_THREADS);
+	unsigned int stages = 1;
+	if (category.itemExists("pipelineStages"))
+		stages = strtoul(category.getValue("pipelineStages").c_str(), NULL, 10);
+	if (stages > MAX_PIPELINE_STAGES)
+		m_logger->warn("The number of pipeline stages is limited to %d", MAX_PIPELINE_STAGES);
+	if (stages > 1 && threads > 1)
+	{
+		m_logger->warn("The worker threads are not used when the rules are divided into pipeline stages");
+		threads = 1;
+	}
+
+	shared_ptr<RuleSet> rules(new RuleSet(threads, batchSize, stages));
+	rules->setEnabled(category.itemExists("enable")
+			&& category.getValue("enable").compare("true") == 0);
+	buildRules(category, *rules);
+	rules->compile();
+	atomic_store(&m_rules, rules);
+}
+
+/**
+ * Create the rules of a configuration and add them to a rule set
+ *
+ * @param category	The configuration category
+ * @param rules		The rule set to populate
+ */
+void AssetFilter::buildRules(ConfigCategory& category, RuleSet& rules)
+{
+	m_regexEngine = STANDARD_REGEX;
+	if (category.itemExists("regexEngine"))
+	{
+		string engine = category.getValue("regexEngine");
+		if (engine.compare("Linear") == 0)
+			m_regexEngine = LINEAR_REGEX;
+		else if (engine.compare("Standard") != 0)
+			m_logger->warn("Unrecognised regular expression engine '%s', the standard engine will be used", engine.c_str());
+	}
 
 	if (category.itemExists("config"))
 	{
@@ -67,7 +119,7 @@ void AssetFilter::handleConfig(ConfigCategory& category)
 		Value::MemberIterator defaultAction = doc.FindMember("defaultAction");
 		if (defaultAction == doc.MemberEnd() || !defaultAction->value.IsString())
 		{
-			m_defaultRule = new IncludeRule(m_instanceName);
+			rules.setDefaultRule(new IncludeRule(m_instanceName));
 			m_logger->info("No default action found in the plugin rules");
 		}
 		else
@@ -75,69 +127,95 @@ void AssetFilter::handleConfig(ConfigCategory& category)
 			string actionStr = defaultAction->value.GetString();
 			for (auto & c: actionStr) c = tolower(c);
 			if (actionStr == "include")
-				m_defaultRule = new IncludeRule(m_instanceName);
+				rules.setDefaultRule(new IncludeRule(m_instanceName));
 			else if (actionStr == "exclude")
-				m_defaultRule = new ExcludeRule(m_instanceName);
+				rules.setDefaultRule(new ExcludeRule(m_instanceName));
 			else if (actionStr == "flatten")
-				m_defaultRule = new FlattenRule(m_instanceName);
+				rules.setDefaultRule(new FlattenRule(m_instanceName));
 			else
 				m_logger->error("The rule '%s' is not a valid default rule",
 						actionStr.c_str());
 		}
 		if (!doc.HasMember("rules"))
 		{
-			if (m_defaultRule)
-				m_logger->warn("The asset filter configuration is missing the rules item. The default rule %s rule will be applied to all assets.", m_defaultRule->getName().c_str());
+			if (rules.getDefaultRule())
+				m_logger->warn("The asset filter configuration is missing the rules item. The default rule %s rule will be applied to all assets.", rules.getDefaultRule()->getName().c_str());
 			else
 				m_logger->error("The asset filter configuration is missing the rules item. No action will be taken by the filter.");
 			return;
 		}
-		Value &rules = doc["rules"];
-		if (!rules.IsArray())
+		Value &ruleArray = doc["rules"];
+		if (!ruleArray.IsArray())
 		{
 			m_logger->error("The rules item in the asset filter configuration should be an array of rules objects. The filter will have no effect.");
 			return;
 		}
-		for (Value::ConstValueIterator iter = rules.Begin(); iter != rules.End(); ++iter)
+		for (Value::ConstValueIterator iter = ruleArray.Begin(); iter != ruleArray.End(); ++iter)
 		{
 			if (!iter->IsObject())
 			{
 				m_logger->error("Asset filter configuration parse error. Each entry in rules array must be an object. The filter will have no effect.");
 				continue;
 			}
-			if (!iter->HasMember("asset_name"))
+			string asset_name;
+			if (iter->HasMember("asset_names"))
+			{
+				const Value& names = (*iter)["asset_names"];
+				if (iter->HasMember("asset_name"))
+				{
+					m_logger->error("The filter configuration contains a rule with both asset_name and asset_names properties. This rule will be ignored.");
+					continue;
+				}
+				if (!names.IsArray() || names.Empty())
+				{
+					m_logger->error("The asset_names property of a rule must be an array of asset names. This rule will be ignored.");
+					continue;
+				}
+				// The name is only used to identify the rule in messages
+				for (auto& name : names.GetArray())
+				{
+					if (!asset_name.empty())
+						asset_name.append(", ");
+					if (name.IsString())
+						asset_name.append(name.GetString());
+				}
+			}
+			else if (!iter->HasMember("asset_name"))
 			{
 				m_logger->error("The filter configuration contains a rule that has no asset_name property. This rule will be ignored.");
 				continue;
 			}
+			else
+			{
+				asset_name = (*iter)["asset_name"].GetString();
+			}
 			if (!iter->HasMember("action"))
 			{
-				m_logger->error("The rule for asset '%s' has no 'action' property. This rule will be ignored.", (*iter)["asset_name"].GetString());
+				m_logger->error("The rule for asset '%s' has no 'action' property. This rule will be ignored.", asset_name.c_str());
 				continue;
 			}
 			
-			string asset_name = (*iter)["asset_name"].GetString();
 			string action = (*iter)["action"].GetString();
 			if (action.compare("include") == 0)
-				m_rules.emplace_back(new IncludeRule(m_instanceName, asset_name));
+				rules.addRule(new IncludeRule(m_instanceName, asset_name, *iter, m_regexEngine));
 			else if (action.compare("exclude") == 0)
-				m_rules.emplace_back(new ExcludeRule(m_instanceName, asset_name));
+				rules.addRule(new ExcludeRule(m_instanceName, asset_name, *iter, m_regexEngine));
 			else if (action.compare("rename") == 0)
-				m_rules.emplace_back(new RenameRule(m_instanceName, asset_name, *iter));
+				rules.addRule(new RenameRule(m_instanceName, asset_name, *iter, m_regexEngine));
 			else if (action.compare("datapointmap") == 0)
-				m_rules.emplace_back(new DatapointMapRule(m_instanceName, asset_name, *iter));
+				rules.addRule(new DatapointMapRule(m_instanceName, asset_name, *iter, m_regexEngine));
 			else if (action.compare("remove") == 0)
-				m_rules.emplace_back(new RemoveRule(m_instanceName, asset_name, *iter));
+				rules.addRule(new RemoveRule(m_instanceName, asset_name, *iter, m_regexEngine));
 			else if (action.compare("flatten") == 0)
-				m_rules.emplace_back(new FlattenRule(m_instanceName, asset_name));
+				rules.addRule(new FlattenRule(m_instanceName, asset_name, *iter, m_regexEngine));
 			else if (action.compare("split") == 0)
-				m_rules.emplace_back(new SplitRule(m_instanceName, asset_name, *iter));
+				rules.addRule(new SplitRule(m_instanceName, asset_name, *iter, m_regexEngine));
 			else if (action.compare("select") == 0)
-				m_rules.emplace_back(new SelectRule(m_instanceName, asset_name, *iter));
+				rules.addRule(new SelectRule(m_instanceName, asset_name, *iter, m_regexEngine));
 			else if (action.compare("retain") == 0)
-				m_rules.emplace_back(new SelectRule(m_instanceName, asset_name, *iter));
+				rules.addRule(new SelectRule(m_instanceName, asset_name, *iter, m_regexEngine));
 			else if (action.compare("nest") == 0)
-				m_rules.emplace_back(new NestRule(m_instanceName, asset_name, *iter));
+				rules.addRule(new NestRule(m_instanceName, asset_name, *iter, m_regexEngine));
 			else
 				m_logger->error("Unrecognised action '%s'", action.c_str());
 		}
@@ -145,126 +223,87 @@ void AssetFilter::handleConfig(ConfigCategory& category)
 }
 
 /**
- * Process the readings by executing all the rules in turn
- * that match the asset name in each reading.
+ * Process a set of readings and pass the results on. The current rule
+ * set is held for the duration of the call, so that a reconfiguration
+ * of the filter while the readings are being processed takes effect
+ * from the next set of readings.
  *
- * NB Each input reading may result in zero or more output readings
+ * Whether the filter is enabled is part of the rule set, so that it
+ * changes along with the rules. If it is not enabled the readings are
+ * passed on unchanged.
  *
  * @param input	The readings to be processed
- * @param out	The resultant readings
  */
-void AssetFilter::ingest(READINGSET *input, vector<Reading*>& out)
+void AssetFilter::ingest(READINGSET *input)
 {
-	vector<Reading *> readings = input->getAllReadings();
-
-	for (Reading *reading : readings)
+	shared_ptr<RuleSet> rules = atomic_load(&m_rules);
+	if (!rules->isEnabled())
 	{
-		if (m_rules.size() == 0)
-		{
-			// We have no rules, run the default rule if there
-			// is one otherwise copy the reading through
-			if (m_defaultRule)
-				m_defaultRule->execute(reading, out);
-			else
-				out.emplace_back(reading);
-		}
-		else
-		{
-			int matches = 0; 
-			vector<Rule *>::const_iterator rule = m_rules.begin();
-			if (rule != m_rules.end())
-			{
-				matches = processReading(reading, out, rule, matches);
-				if (matches == 0 && m_defaultRule)
-				{
-					// No rules matched so run the default rule
-					m_defaultRule->execute(reading, out);
-				}
-				else if (matches == 0)
-				{
-					// No rules matched and we have no default rule
-					out.emplace_back(reading);
-				}
-			}
-		}
+		(*m_func)(m_data, input);
+		return;
 	}
-
-	// The readings in the input reading set will either have
-	// been deleted or reused by the rules. Therefore we must clear
-	// the reading set before deleting it to avoid double calls to
-	// delete for the readings.
-	input->clear();
-	delete input;
+	rules->ingest(input, m_func, m_data);
 }
 
 /**
- * Recursively process all the rules against a reading.
- * Each rule may result in zero of more readings resulting
- * from the execution of the reading. Therefore each rule
- * produces a vector of readings. We then move to the next
- * rule and execute that on each of the readings in the
- * result form the previous rule. Once we run out of new
- * rules to execute we add the resultant vector of readings
- * produced by the final rule in the list to the output vector.
+ * Reconfigure the filter. The new rule set is built by the compiler
+ * thread, which is started by the first reconfiguration. Unless the
+ * configuration asks to wait for the new rules the call returns
+ * without waiting for the rule set to be built.
  *
- * If a rule produces no results then we end the recursive
- * execution of the rules at that point.
- *
- * @param reading	The reading to process
- * @param out		The final output vector to add the results of all rule executions to
- * @param rule		Iterator on the rules to process
+ * @param config	The new configuration
  */
-int AssetFilter::processReading(Reading *reading, vector<Reading *>& out, vector<Rule *>::const_iterator rule, int matches)
+void AssetFilter::reconfigure(const string& config)
 {
-vector<Reading *> result;
+	setConfig(config);
+	ConfigCategory conf("AssetFilter", config);
+	bool wait = conf.itemExists("waitForRules")
+			&& conf.getValue("waitForRules").compare("true") == 0;
 
-	// Execute the rule on the reading if the reading matches
-	// the asset name or pattern in the rule. Otherwise simply
-	// execute the next rule on this reading.
-	if ((*rule)->match(reading))
-	{
-		(*rule)->execute(reading, result);
-		matches++;
-	}
-	else
+	unique_lock<mutex> lck(m_compileMutex);
+	m_pendingConfig = config;
+	unsigned long request = ++m_requested;
+	if (!m_compiler.joinable())
+		m_compiler = thread(&AssetFilter::compiler, this);
+	m_compileCV.notify_all();
+	if (wait)
 	{
-		result.emplace_back(reading);
+		m_compileCV.wait(lck, [this, request]() {
+				return m_compiled >= request || m_shutdown;
+			});
 	}
-	if (result.empty())
-	{
-		// The rule has removed the reading, therefore
-		// we need not process any more rules
-		return matches;
-	}
-	rule++;
-	if (rule != m_rules.end())
+}
+
+/**
+ * The compiler thread. Build a rule set for the latest configuration
+ * each time the filter is reconfigured. Configurations that are
+ * superseded before the thread reaches them are never built.
+ */
+void AssetFilter::compiler()
+{
+	unique_lock<mutex> lck(m_compileMutex);
+	while (!m_shutdown)
 	{
-		for (Reading *nReading : result)
+		if (m_compiled == m_requested)
 		{
-			matches = processReading(nReading, out, rule, matches);
+			m_compileCV.wait(lck);
+			continue;
 		}
-	}
-	else if (matches > 0)
-	{
-		// If any rules matched put the resulting readings in the 
-		// final output buffer. Otherwise it will be picked up by
-		// the defaultRule at the end and processed.
-		for (Reading *nReading : result)
+		string config = m_pendingConfig;
+		unsigned long request = m_requested;
+		lck.unlock();
+		try
 		{
-			out.emplace_back(nReading);
+			ConfigCategory conf("AssetFilter", config);
+			handleConfig(conf);
 		}
+		catch (exception& e)
+		{
+			m_logger->error("Unable to create the rules for the new configuration: %s",
+					e.what());
+		}
+		lck.lock();
+		m_compiled = request;
+		m_compileCV.notify_all();
 	}
-	return matches;
-}
-
-/**
- * Reconfigure the filter
- *
- * @param config	The new configuration
- */
-void AssetFilter::reconfigure(const string& config)
-{
-	setConfig(config);
-	ConfigCategory conf("AssetFilter", config);
-	handleConfig(conf);
 }
@@ -0,0 +1,437 @@
+/*
+ * Fledge "asset" filter plugin asset name matcher.
+ *
+ * Copyright (c) 2025 Dianomic Systems
+ *
+ * Released under the Apache 2.0 Licence
+ *
+ * Author: Mark Riddoch
+ */
+#include <asset_matcher.h>
+#include <algorithm>
+
+using namespace std;
+
+/**
+ * The longest fixed repetition that will be expanded when lowering
+ */
+#define MAX_EXPANDED_REPEAT	16
+
+/**
+ * The maximum number of characters in a class that will be expanded
+ * into literal names rather than tested as a character class
+ */
+#define MAX_EXPANDED_CLASS	4
+
+/**
+ * Construct a matcher that leaves every match to the regular
+ * expression itself
+ */
+AssetMatcher::AssetMatcher() : m_kind(REGEX), m_anyByte(true)
+{
+}
+
+/**
+ * Construct a matcher for a regular expression. The expression is
+ * lowered to the cheapest equivalent test.
+ *
+ * @param pattern	The regular expression for the asset name
+ */
+AssetMatcher::AssetMatcher(const string& pattern) : m_kind(REGEX), m_anyByte(true)
+{
+	RegexParser parser(pattern);
+	RegexNode *tree = parser.parse();
+	if (tree)
+	{
+		lower(tree);
+		delete tree;
+	}
+}
+
+/**
+ * Destructor for the matcher
+ */
+AssetMatcher::~AssetMatcher()
+{
+}
+
+/**
+ * Return the name of the kind of test the matcher uses
+ *
+ * @return const char*	The name of the test
+ */
+const char *AssetMatcher::kindName() const
+{
+	switch (m_kind)
+	{
+		case ALL:
+			return "match all";
+		case LITERAL:
+			return "literal";
+		case PREFIX:
+			return "prefix";
+		case SUFFIX:
+			return "suffix";
+		case CONTAINS:
+			return "contains";
+		case SET:
+			return "literal set";
+		case CHARCLASS:
+			return "character class";
+		default:
+			return "regular expression";
+	}
+}
+
+/**
+ * Match an asset name. A matcher of kind REGEX is unable to match
+ * the name and the caller must use the regular expression instead.
+ *
+ * @param asset	The asset name to match
+ * @return bool	True if the asset name matches
+ */
+bool AssetMatcher::match(const string& asset) const
+{
+	size_t len = m_literal.length();
+	switch (m_kind)
+	{
+		case ALL:
+			return noLineBreak(asset, 0, asset.length());
+		case LITERAL:
+			return asset.compare(m_literal) == 0;
+		case PREFIX:
+			return asset.length() >= len && asset.compare(0, len, m_literal) == 0
+				&& noLineBreak(asset, len, asset.length());
+		case SUFFIX:
+			return asset.length() >= len
+				&& asset.compare(asset.length() - len, len, m_literal) == 0
+				&& noLineBreak(asset, 0, asset.length() - len);
+		case CONTAINS:
+			return asset.find(m_literal) != string::npos
+				&& noLineBreak(asset, 0, asset.length());
+		case SET:
+			return binary_search(m_literals.begin(), m_literals.end(), asset);
+		case CHARCLASS:
+			if (asset.length() != m_classes.size())
+				return false;
+			for (size_t i = 0; i < asset.length(); i++)
+			{
+				if (!m_classes[i].test((unsigned char)asset[i]))
+					return false;
+			}
+			return true;
+		default:
+			return false;
+	}
+}
+
+/**
+ * Check that a portion of a string matched by ".*" contains no line
+ * break characters, which "." does not match.
+ *
+ * @param str	The string to check
+ * @param from	The start of the portion
+ * @param to	The end of the portion
+ * @return bool	True if the portion could be matched by ".*"
+ */
+bool AssetMatcher::noLineBreak(const string& str, size_t from, size_t to) const
+{
+	if (m_anyByte)
+		return true;
+	for (size_t i = from; i < to; i++)
+	{
+		if (str[i] == '\n' || str[i] == '\r')
+			return false;
+	}
+	return true;
+}
+
+/**
+ * Lower the parse tree of the expression to the cheapest test. The
+ * expression is treated as a sequence of items, any ".*" items at the
+ * start or end of the sequence become a prefix, suffix or contains
+ * test on the literal that remains, or a match all test if nothing
+ * remains. A sequence with no ".*" items is expanded to the set of
+ * literal names it matches or, failing that, a sequence of character
+ * classes.
+ *
+ * @param node	The parse tree of the expression
+ */
+void AssetMatcher::lower(RegexNode *node)
+{
+	vector<RegexNode *> items;
+	flatten(node, items);
+
+	// Anchors at the ends of the expression have no effect when
+	// matching the whole asset name
+	auto first = items.begin();
+	auto last = items.end();
+	while (first != last && (*first)->m_type == RegexNode::LINE_START)
+		++first;
+	while (last != first && (*(last - 1))->m_type == RegexNode::LINE_END)
+		--last;
+
+	bool leading = false, trailing = false, anyByte;
+	while (first != last && isAnyString(*first, anyByte))
+	{
+		if (leading && anyByte != m_anyByte)
+			return;
+		m_anyByte = anyByte;
+		leading = true;
+		++first;
+	}
+	while (last != first && isAnyString(*(last - 1), anyByte))
+	{
+		if ((leading || trailing) && anyByte != m_anyByte)
+			return;
+		m_anyByte = anyByte;
+		trailing = true;
+		--last;
+	}
+
+	if (leading && first == last)
+	{
+		// Nothing but ".*", the expression matches every name
+		m_kind = ALL;
+		return;
+	}
+
+	vector<string> strings;
+	if (!expand(first, last, strings))
+	{
+		if (leading || trailing)
+			return;
+		vector<CharSet> sequence;
+		for (auto it = first; it != last; ++it)
+		{
+			if (!classes(*it, sequence))
+				return;
+		}
+		m_classes = sequence;
+		m_kind = CHARCLASS;
+		return;
+	}
+
+	sort(strings.begin(), strings.end());
+	strings.erase(unique(strings.begin(), strings.end()), strings.end());
+	if (strings.empty())
+		return;
+	if (!leading && !trailing)
+	{
+		m_literals = strings;
+		m_literal = strings[0];
+		m_kind = strings.size() == 1 ? LITERAL : SET;
+		return;
+	}
+	if (strings.size() != 1)
+		return;
+	if (!m_anyByte && strings[0].find_first_of("\n\r") != string::npos)
+		return;
+	m_literal = strings[0];
+	if (leading && trailing)
+		m_kind = CONTAINS;
+	else if (leading)
+		m_kind = SUFFIX;
+	else
+		m_kind = PREFIX;
+}
+
+/**
+ * Flatten the top level of a parse tree into a sequence of items.
+ * Groups are transparent when only the match is of interest.
+ *
+ * @param node	The parse tree node
+ * @param items	The sequence to append the items to
+ */
+void AssetMatcher::flatten(RegexNode *node, vector<RegexNode *>& items)
+{
+	if (node->m_type == RegexNode::CONCAT)
+	{
+		for (auto& child : node->m_children)
+			flatten(child, items);
+	}
+	else if (node->m_type == RegexNode::GROUP)
+	{
+		flatten(node->m_children[0], items);
+	}
+	else
+	{
+		items.push_back(node);
+	}
+}
+
+/**
+ * Check if a node matches any string, i.e. it is ".*" or an
+ * equivalent such as "[\s\S]*"
+ *
+ * @param node		The parse tree node
+ * @param anyByte	Set true if the node matches every byte, false if
+ *			it is "." which does not match line breaks
+ * @return bool		True if the node matches any string
+ */
+bool AssetMatcher::isAnyString(RegexNode *node, bool& anyByte)
+{
+	while (node->m_type == RegexNode::GROUP)
+		node = node->m_children[0];
+	if (node->m_type != RegexNode::REPEAT || node->m_min != 0 || node->m_max >= 0)
+		return false;
+	RegexNode *child = node->m_children[0];
+	while (child->m_type == RegexNode::GROUP)
+		child = child->m_children[0];
+	if (child->m_type != RegexNode::CHARS)
+		return false;
+	CharSet dot;
+	dot.set();
+	dot.reset('\n');
+	dot.reset('\r');
+	if (child->m_chars.all())
+	{
+		anyByte = true;
+		return true;
+	}
+	if (child->m_chars == dot)
+	{
+		anyByte = false;
+		return true;
+	}
+	return false;
+}
+
+/**
+ * Expand a sequence of items into the set of literal strings it matches
+ *
+ * @param first		The first item in the sequence
+ * @param last		The end of the sequence
+ * @param strings	Populated with the strings
+ * @return bool		False if the sequence does not match a small finite set of strings
+ */
+bool AssetMatcher::expand(vector<RegexNode *>::iterator first,
+			vector<RegexNode *>::iterator last,
+			vector<string>& strings)
+{
+	strings.assign(1, "");
+	for (auto it = first; it != last; ++it)
+	{
+		vector<string> suffixes;
+		if (!expand(*it, suffixes))
+			return false;
+		if (strings.size() * suffixes.size() > MAX_MATCHER_LITERALS)
+			return false;
+		vector<string> product;
+		for (auto& prefix : strings)
+			for (auto& suffix : suffixes)
+				product.push_back(prefix + suffix);
+		strings.swap(product);
+	}
+	return true;
+}
+
+/**
+ * Expand a parse tree node into the set of literal strings it matches
+ *
+ * @param node		The parse tree node
+ * @param strings	Populated with the strings
+ * @return bool		False if the node does not match a small finite set of strings
+ */
+bool AssetMatcher::expand(RegexNode *node, vector<string>& strings)
+{
+	strings.clear();
+	switch (node->m_type)
+	{
+		case RegexNode::EMPTY:
+			strings.push_back("");
+			return true;
+		case RegexNode::CHARS:
+			if (node->m_chars.count() > MAX_EXPANDED_CLASS)
+				return false;
+			for (int c = 0; c < 256; c++)
+			{
+				if (node->m_chars.test(c))
+					strings.push_back(string(1, (char)c));
+			}
+			return true;
+		case RegexNode::GROUP:
+			return expand(node->m_children[0], strings);
+		case RegexNode::CONCAT:
+			return expand(node->m_children.begin(), node->m_children.end(), strings);
+		case RegexNode::ALTERNATE:
+			for (auto& child : node->m_children)
+			{
+				vector<string> alternative;
+				if (!expand(child, alternative))
+					return false;
+				strings.insert(strings.end(), alternative.begin(), alternative.end());
+				if (strings.size() > MAX_MATCHER_LITERALS)
+					return false;
+			}
+			return true;
+		case RegexNode::REPEAT:
+		{
+			if (node->m_max < 0 || node->m_max > MAX_EXPANDED_REPEAT)
+				return false;
+			vector<string> child;
+			if (!expand(node->m_children[0], child))
+				return false;
+			vector<string> repeated(1, "");
+			for (int i = 0; i <= node->m_max; i++)
+			{
+				if (i >= node->m_min)
+					strings.insert(strings.end(), repeated.begin(), repeated.end());
+				if (i == node->m_max)
+					break;
+				if (repeated.size() * child.size() > MAX_MATCHER_LITERALS)
+					return false;
+				vector<string> product;
+				for (auto& prefix : repeated)
+					for (auto& suffix : child)
+						product.push_back(prefix + suffix);
+				repeated.swap(product);
+				if (strings.size() > MAX_MATCHER_LITERALS)
+					return false;
+			}
+			return strings.size() <= MAX_MATCHER_LITERALS;
+		}
+		default:
+			return false;
+	}
+}
+
+/**
+ * Convert a parse tree node into a fixed length sequence of
+ * character classes
+ *
+ * @param node		The parse tree node
+ * @param sequence	The sequence to append the classes to
+ * @return bool		False if the node does not match a fixed length
+ */
+bool AssetMatcher::classes(RegexNode *node, vector<CharSet>& sequence)
+{
+	switch (node->m_type)
+	{
+		case RegexNode::EMPTY:
+			return true;
+		case RegexNode::CHARS:
+			sequence.push_back(node->m_chars);
+			return true;
+		case RegexNode::GROUP:
+			return classes(node->m_children[0], sequence);
+		case RegexNode::CONCAT:
+			for (auto& child : node->m_children)
+			{
+				if (!classes(child, sequence))
+					return false;
+			}
+			return true;
+		case RegexNode::REPEAT:
+			if (node->m_min != node->m_max || node->m_max > MAX_EXPANDED_REPEAT)
+				return false;
+			for (int i = 0; i < node->m_min; i++)
+			{
+				if (!classes(node->m_children[0], sequence))
+					return false;
+			}
+			return true;
+		default:
+			return false;
+	}
+}
@@ -0,0 +1,152 @@
+/*
+ * Fledge "asset" filter plugin benchmark.
+ *
+ * Copyright (c) 2025 Dianomic Systems
+ *
+ * Released under the Apache 2.0 Licence
+ *
+ * Author: Mark Riddoch
+ */
+#include <plugin_api.h>
+#include <config_category.h>
+#include <filter_plugin.h>
+#include <filter.h>
+#include <reading.h>
+#include <reading_set.h>
+#include <chrono>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+extern "C" {
+	PLUGIN_INFORMATION *plugin_info();
+	void plugin_ingest(void *handle, READINGSET *readingSet);
+	PLUGIN_HANDLE plugin_init(ConfigCategory *config,
+			OUTPUT_HANDLE *outHandle,
+			OUTPUT_STREAM output);
+	void plugin_shutdown(PLUGIN_HANDLE handle);
+};
+
+/**
+ * The number of readings in each reading set passed to the filter
+ */
+#define BATCH_SIZE	100
+
+/**
+ * The number of datapoints in each reading
+ */
+#define DATAPOINTS	8
+
+/**
+ * The rule sets that are measured
+ */
+static struct {
+	const char	*name;
+	const char	*config;
+} benchmarks[] = {
+	{ "remove datapoint", QUOTE({ "rules" : [
+		{ "asset_name" : "pump.*", "action" : "remove", "datapoint" : "dp3" } ] }) },
+	{ "remove regex", QUOTE({ "rules" : [
+		{ "asset_name" : "pump.*", "action" : "remove", "datapoint" : "dp[35]" } ] }) },
+	{ "remove type", QUOTE({ "rules" : [
+		{ "asset_name" : "pump.*", "action" : "remove", "type" : "string" } ] }) },
+	{ "remove datapoints", QUOTE({ "rules" : [
+		{ "asset_name" : "pump.*", "action" : "remove", "datapoints" : [ "dp1", "dp6" ] } ] }) },
+	{ "rename", QUOTE({ "rules" : [
+		{ "asset_name" : "pump.*", "action" : "rename", "new_asset_name" : "motor" } ] }) },
+	{ "rename regex", QUOTE({ "rules" : [
+		{ "asset_name" : "pump(.*)", "action" : "rename", "new_asset_name" : "motor$1" } ] }) },
+	{ "select datapoints", QUOTE({ "rules" : [
+		{ "asset_name" : "pump.*", "action" : "select", "datapoints" : [ "dp0", "dp2", "dp4" ] } ] }) },
+	{ "select type", QUOTE({ "rules" : [
+		{ "asset_name" : "pump.*", "action" : "select", "type" : "number" } ] }) },
+	{ "mixed chain", QUOTE({ "rules" : [
+		{ "asset_name" : "pump.*", "action" : "datapointmap", "map" : { "dp0" : "first" } },
+		{ "asset_name" : "pump.*", "action" : "include" },
+		{ "asset_name" : "pump.*", "action" : "remove", "datapoint" : "dp7" },
+		{ "asset_name" : "pump.*", "action" : "flatten" },
+		{ "asset_name" : "pump.*", "action" : "select", "type" : "number" },
+		{ "asset_name" : "pump.*", "action" : "include" },
+		{ "asset_name" : "pump.*", "action" : "rename", "new_asset_name" : "motor" } ] }) }
+};
+
+/**
+ * The output of the filter, count and discard the readings
+ */
+static void Handler(void *handle, READINGSET *readings)
+{
+	*(long *)handle += ((ReadingSet *)readings)->getAllReadings().size();
+	delete (ReadingSet *)readings;
+}
+
+/**
+ * Create a set of readings, each with a mixture of integer, float
+ * and string datapoints
+ */
+static ReadingSet *makeReadings()
+{
+	vector<Reading *> readings;
+	for (int i = 0; i < BATCH_SIZE; i++)
+	{
+		vector<Datapoint *> dps;
+		for (int j = 0; j < DATAPOINTS; j++)
+		{
+			string name = "dp" + to_string(j);
+			if (j % 3 == 0)
+			{
+				DatapointValue value((long)i);
+				dps.push_back(new Datapoint(name, value));
+			}
+			else if (j % 3 == 1)
+			{
+				DatapointValue value((double)i);
+				dps.push_back(new Datapoint(name, value));
+			}
+			else
+			{
+				DatapointValue value(string("value"));
+				dps.push_back(new Datapoint(name, value));
+			}
+		}
+		readings.push_back(new Reading("pump" + to_string(i % 10), dps));
+	}
+	return new ReadingSet(&readings);
+}
+
+/**
+ * Run each of the rule sets over a number of batches of readings and
+ * report the time taken per reading. Only the time spent in the filter
+ * is measured, the creation of the readings is excluded.
+ */
+int main(int argc, char **argv)
+{
+	int batches = argc > 1 ? atoi(argv[1]) : 2000;
+
+	for (auto& benchmark : benchmarks)
+	{
+		PLUGIN_INFORMATION *info = plugin_info();
+		ConfigCategory config("asset", info->config);
+		config.setItemsValueFromDefault();
+		config.setValue("config", benchmark.config);
+		config.setValue("enable", "true");
+		long count = 0;
+		void *handle = plugin_init(&config, (OUTPUT_HANDLE *)&count, Handler);
+
+		chrono::nanoseconds elapsed(0);
+		for (int i = 0; i < batches; i++)
+		{
+			ReadingSet *readings = makeReadings();
+			auto start = chrono::steady_clock::now();
+			plugin_ingest(handle, (READINGSET *)readings);
+			elapsed += chrono::steady_clock::now() - start;
+		}
+		plugin_shutdown(handle);
+
+		printf("%-20s %8.1f ns/reading (%ld readings)\n", benchmark.name,
+				(double)elapsed.count() / ((long)batches * BATCH_SIZE), count);
+	}
+	return 0;
+}
@@ -0,0 +1,200 @@
+/*
+ * Fledge "asset" filter plugin case folding.
+ *
+ * Copyright (c) 2025 Dianomic Systems
+ *
+ * Released under the Apache 2.0 Licence
+ *
+ * Author: Mark Riddoch
+ */
+#include <case_fold.h>
+#include <stdint.h>
+#include <string.h>
+
+using namespace std;
+
+#define ONES	0x0101010101010101ULL
+#define HIGHS	0x8080808080808080ULL
+
+/**
+ * Fold eight characters at once. The high bit of each byte of the
+ * two sums is set if the byte is at least 'A' and greater than 'Z'
+ * respectively; the seven bit values cannot carry between bytes.
+ * Bytes that are upper case letters have 0x20 added to them.
+ *
+ * @param word	Eight characters
+ * @return uint64_t	The folded characters
+ */
+static inline uint64_t foldWord(uint64_t word)
+{
+	uint64_t ascii = word & ~HIGHS;
+	uint64_t geA = ascii + (0x80 - 'A') * ONES;
+	uint64_t gtZ = ascii + (0x7F - 'Z') * ONES;
+	uint64_t upper = (geA ^ gtZ) & ~word & HIGHS;
+	return word | (upper >> 2);
+}
+
+/**
+ * Fold the ASCII upper case letters in a string to lower case,
+ * eight characters at a time.
+ *
+ * @param str		The string to fold
+ * @param folded	Populated with the folded string
+ */
+void foldCase(const string& str, string& folded)
+{
+	size_t len = str.length();
+	folded.resize(len);
+	const char *src = str.data();
+	char *dst = &folded[0];
+	size_t i = 0;
+	for ( ; i + 8 <= len; i += 8)
+	{
+		uint64_t word;
+		memcpy(&word, src + i, 8);
+		word = foldWord(word);
+		memcpy(dst + i, &word, 8);
+	}
+	for ( ; i < len; i++)
+	{
+		char c = src[i];
+		dst[i] = (c >= 'A' && c <= 'Z') ? c + ('a' - 'A') : c;
+	}
+}
+
+/**
+ * Fold the ASCII upper case letters in a string to lower case
+ *
+ * @param str		The string to fold
+ * @return string	The folded string
+ */
+string foldCase(const string& str)
+{
+	string folded;
+	foldCase(str, folded);
+	return folded;
+}
+
+/**
+ * Fold the literal characters of a regular expression to lower case,
+ * leaving the escape sequences unchanged
+ *
+ * @param pattern	The regular expression
+ * @return string	The folded regular expression
+ */
+string foldPattern(const string& pattern)
+{
+	string folded(pattern);
+	for (size_t i = 0; i < folded.length(); i++)
+	{
+		if (folded[i] == '\\')
+			i++;
+		else if (folded[i] >= 'A' && folded[i] <= 'Z')
+			folded[i] += 'a' - 'A';
+	}
+	return folded;
+}
+
+/**
+ * Check if folding the literal characters of a regular expression
+ * preserves its meaning
+ *
+ * @param pattern	The regular expression
+ * @return bool		True if foldPattern may be used on the expression
+ */
+bool canFoldPattern(const string& pattern)
+{
+	bool inClass = false;
+	for (size_t i = 0; i < pattern.length(); i++)
+	{
+		char c = pattern[i];
+		if (c == '\\')
+		{
+			// Characters given by their code are not folded
+			if (++i < pattern.length() && strchr("xuc0", pattern[i]))
+				return false;
+		}
+		else if (c == '[')
+		{
+			inClass = true;
+		}
+		else if (c == ']')
+		{
+			inClass = false;
+		}
+		else if (inClass && c == '-' && i > 0 && i + 1 < pattern.length()
+				&& pattern[i + 1] != ']' && pattern[i - 1] != '[')
+		{
+			// A range may only be folded if it lies within the
+			// upper case or the lower case letters, or has no
+			// letters in it at all
+			char lo = pattern[i - 1], hi = pattern[i + 1];
+			if (hi == '\\')
+				return false;
+			bool upper = lo >= 'A' && hi <= 'Z';
+			bool lower = lo >= 'a' && hi <= 'z';
+			bool none = hi < 'A' || lo > 'z' || (lo > 'Z' && hi < 'a');
+			if (!upper && !lower && !none)
+				return false;
+		}
+	}
+	return true;
+}
+
+/**
+ * Test if a string is equal to a folded string, ignoring the case of
+ * the first. The strings are compared eight characters at a time.
+ *
+ * @param str		The string to test
+ * @param folded	The folded string
+ * @return bool		True if the folded form of str equals folded
+ */
+bool equalsFolded(const string& str, const string& folded)
+{
+	size_t len = str.length();
+	if (len != folded.length())
+		return false;
+	const char *a = str.data();
+	const char *b = folded.data();
+	size_t i = 0;
+	for ( ; i + 8 <= len; i += 8)
+	{
+		uint64_t wa, wb;
+		memcpy(&wa, a + i, 8);
+		memcpy(&wb, b + i, 8);
+		if (foldWord(wa) != wb)
+			return false;
+	}
+	for ( ; i < len; i++)
+	{
+		char c = a[i];
+		if (((c >= 'A' && c <= 'Z') ? c + ('a' - 'A') : c) != b[i])
+			return false;
+	}
+	return true;
+}
+
+/**
+ * Compare two strings ignoring the case of ASCII letters
+ *
+ * @param a		The first string
+ * @param b		The second string
+ * @return int		Less than, equal to or greater than zero
+ */
+int compareFolded(const string& a, const string& b)
+{
+	size_t len = a.length() < b.length() ? a.length() : b.length();
+	for (size_t i = 0; i < len; i++)
+	{
+		unsigned char ca = a[i], cb = b[i];
+		if (ca >= 'A' && ca <= 'Z')
+			ca += 'a' - 'A';
+		if (cb >= 'A' && cb <= 'Z')
+			cb += 'a' - 'A';
+		if (ca != cb)
+			return ca < cb ? -1 : 1;
+	}
+	if (a.length() == b.length())
+		return 0;
+	return a.length() < b.length() ? -1 : 1;
+}
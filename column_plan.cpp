@@ -0,0 +1,154 @@
+/*
+ * Fledge "asset" filter plugin column plan.
+ *
+ * Copyright (c) 2025 Dianomic Systems
+ *
+ * Released under the Apache 2.0 Licence
+ *
+ * Author: Mark Riddoch
+ */
+#include <column_plan.h>
+
+using namespace std;
+
+/**
+ * The type recorded in the schema for a datapoint that has been removed
+ */
+#define REMOVED	-1
+
+/**
+ * Construct an empty column plan
+ */
+ColumnPlan::ColumnPlan() : m_valid(false), m_removes(false), m_renames(false), m_drop(false)
+{
+}
+
+/**
+ * Destructor for the column plan
+ */
+ColumnPlan::~ColumnPlan()
+{
+}
+
+/**
+ * Check if the datapoints of a reading have the schema the plan
+ * was made for. If not the schema of the reading is recorded and
+ * the caller must make the plan again.
+ *
+ * @param dps	The datapoints of the reading
+ * @return bool	True if the plan may be applied to the reading
+ */
+bool ColumnPlan::sameSchema(const vector<Datapoint *>& dps)
+{
+	bool same = m_valid && dps.size() == m_names.size();
+	for (unsigned int i = 0; same && i < dps.size(); i++)
+	{
+		if (!dps[i])
+			same = m_types[i] == REMOVED;
+		else
+			same = dps[i]->getData().getType() == m_types[i]
+				&& dps[i]->getName().compare(m_names[i]) == 0;
+	}
+	if (same)
+		return true;
+
+	m_names.resize(dps.size());
+	m_types.resize(dps.size());
+	for (unsigned int i = 0; i < dps.size(); i++)
+	{
+		if (!dps[i])
+		{
+			m_names[i].clear();
+			m_types[i] = REMOVED;
+			continue;
+		}
+		m_names[i] = dps[i]->getName();
+		m_types[i] = dps[i]->getData().getType();
+	}
+	m_valid = true;
+	return false;
+}
+
+/**
+ * Start a new plan, in which every column is kept unchanged
+ *
+ * @param columns	The number of columns
+ */
+void ColumnPlan::reset(unsigned int columns)
+{
+	m_keep.assign(columns, true);
+	m_renamed.assign(columns, false);
+	m_newNames.resize(columns);
+	m_removes = false;
+	m_renames = false;
+	m_drop = false;
+}
+
+/**
+ * Record that a column is removed
+ *
+ * @param column	The position of the column
+ */
+void ColumnPlan::remove(unsigned int column)
+{
+	m_keep[column] = false;
+	m_removes = true;
+}
+
+/**
+ * Record that a column is renamed
+ *
+ * @param column	The position of the column
+ * @param name		The new name of the column
+ */
+void ColumnPlan::rename(unsigned int column, const string& name)
+{
+	m_renamed[column] = true;
+	m_newNames[column] = name;
+	m_renames = true;
+}
+
+/**
+ * Apply the plan to a reading with the schema of the plan. The
+ * datapoints that are kept are compacted in a single pass, unless
+ * the removal is deferred in which case the removed datapoints are
+ * added to the list of removed datapoints.
+ *
+ * @param reading	The reading
+ * @param removed	The list of removed datapoints or NULL to delete them
+ */
+void ColumnPlan::apply(Reading *reading, vector<Datapoint *> *removed) const
+{
+	vector<Datapoint *>& dps = reading->getReadingData();
+	if (m_renames)
+	{
+		for (unsigned int i = 0; i < dps.size(); i++)
+		{
+			if (m_renamed[i] && dps[i])
+				dps[i]->setName(m_newNames[i]);
+		}
+	}
+	if (m_removes && removed)
+	{
+		for (unsigned int i = 0; i < dps.size(); i++)
+		{
+			if (!m_keep[i] && dps[i])
+			{
+				removed->push_back(dps[i]);
+				dps[i] = NULL;
+			}
+		}
+	}
+	else if (m_removes)
+	{
+		unsigned int keep = 0;
+		for (unsigned int i = 0; i < dps.size(); i++)
+		{
+			if (m_keep[i])
+				dps[keep++] = dps[i];
+			else
+				delete dps[i];
+		}
+		dps.resize(keep);
+	}
+}
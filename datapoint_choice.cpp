@@ -0,0 +1,61 @@
+/*
+ * Fledge "asset" filter plugin datapoint choice.
+ *
+ * Copyright (c) 2025 Dianomic Systems
+ *
+ * Released under the Apache 2.0 Licence
+ *
+ * Author: Mark Riddoch
+ */
+#include <datapoint_choice.h>
+
+using namespace std;
+
+/**
+ * Return the mode that chooses datapoints by a type name given in
+ * the configuration of a rule
+ *
+ * @param type	The type name, in upper case
+ * @return Mode	The mode for the type or class of types
+ */
+DatapointChoice::Mode DatapointChoice::typeMode(const string& type)
+{
+	if (type == "NUMBER")
+		return NUMBER;
+	if (type == "NON-NUMERIC")
+		return NON_NUMERIC;
+	if (type == "USER_ARRAY")
+		return USER_ARRAY;
+	return TYPE;
+}
+
+/**
+ * Test if a datapoint is chosen, using the test for the mode of the
+ * choice. This is used when a column plan is built, which happens only
+ * when the schema of the readings changes.
+ *
+ * @param dp	The datapoint to test
+ * @return bool	True if the datapoint is chosen
+ */
+bool DatapointChoice::chooses(Datapoint *dp) const
+{
+	switch (m_mode)
+	{
+		case NAME:
+			return chooses<NAME>(dp);
+		case REGEX:
+			return chooses<REGEX>(dp);
+		case NAMES:
+			return chooses<NAMES>(dp);
+		case TYPE:
+			return chooses<TYPE>(dp);
+		case NUMBER:
+			return chooses<NUMBER>(dp);
+		case NON_NUMERIC:
+			return chooses<NON_NUMERIC>(dp);
+		case USER_ARRAY:
+			return chooses<USER_ARRAY>(dp);
+		default:
+			return false;
+	}
+}
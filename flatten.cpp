@@ -10,6 +10,7 @@
 #include <rules.h>
 
 using namespace std;
+using namespace rapidjson;
 
 /**
  * Default constructor for the Flatten rule
@@ -25,8 +26,11 @@ FlattenRule::FlattenRule(const string& service) : Rule(service, "defaultAction")
  *
  * @param service The service name
  * @param asset	The asset name
+ * @param json	The JSON definition of the rule
+ * @param engine	The regular expression engine to use
  */
-FlattenRule::FlattenRule(const string& service, const string& asset) : Rule(service, asset)
+FlattenRule::FlattenRule(const string& service, const string& asset, const Value& json, RegexEngine engine) :
+	Rule(service, asset, json, engine)
 {
 }
 
@@ -72,10 +76,7 @@ void FlattenRule::execute(Reading *reading, vector<Reading *>& out)
 	reading->getUserTimestamp(&tm);
 	newReading->setUserTimestamp(tm);
 	delete reading;
-	if (m_tracker)
-	{
-		m_tracker->addAssetTrackingTuple(m_service, newReading->getAssetName(), "Filter");
-	}
+	track(newReading->getAssetName());
 	out.emplace_back(newReading);
 }
 
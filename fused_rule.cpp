@@ -0,0 +1,154 @@
+/*
+ * Fledge "asset" filter plugin fused rule.
+ *
+ * Copyright (c) 2025 Dianomic Systems
+ *
+ * Released under the Apache 2.0 Licence
+ *
+ * Author: Mark Riddoch
+ */
+#include <fused_rule.h>
+
+using namespace std;
+
+/**
+ * Construct an empty fused rule
+ */
+FusedRule::FusedRule() : m_lastSelect(-1)
+{
+}
+
+/**
+ * Destructor for the fused rule. The fused rule does not own the rules.
+ */
+FusedRule::~FusedRule()
+{
+}
+
+/**
+ * Add a remove rule to the end of the run of rules
+ *
+ * @param rule	The rule to add
+ */
+void FusedRule::add(RemoveRule *rule)
+{
+	m_stages.emplace_back(Stage::REMOVE, rule, rule->getChoice());
+}
+
+/**
+ * Add a select rule to the end of the run of rules
+ *
+ * @param rule	The rule to add
+ */
+void FusedRule::add(SelectRule *rule)
+{
+	m_lastSelect = m_stages.size();
+	m_stages.emplace_back(Stage::SELECT, rule, rule->getChoice());
+}
+
+/**
+ * Add a datapoint map rule to the end of the run of rules
+ *
+ * @param rule	The rule to add
+ */
+void FusedRule::add(DatapointMapRule *rule)
+{
+	m_stages.emplace_back(Stage::MAP, rule);
+}
+
+/**
+ * Execute the run of rules on a reading. The removed datapoints are
+ * left as NULL entries in the reading and added to the list of removed
+ * datapoints. With a column plan the datapoints only pass through the
+ * rules when the schema changes.
+ *
+ * @param reading	The reading to process
+ * @param out		The vector in which to place the result
+ * @param plan		The column plan for the rule or NULL
+ * @param removed	The list of removed datapoints
+ */
+void FusedRule::execute(Reading *reading, vector<Reading *>& out, ColumnPlan *plan,
+		vector<Datapoint *> *removed)
+{
+	vector<Datapoint *>& dps = reading->getReadingData();
+	bool drop;
+	if (plan && plan->sameSchema(dps))
+	{
+		plan->apply(reading, removed);
+		drop = plan->drops();
+	}
+	else
+	{
+		if (plan)
+			plan->reset(dps.size());
+		// The furthest any datapoint has passed through the rules
+		int furthest = -1;
+		for (unsigned int i = 0; i < dps.size(); i++)
+		{
+			Datapoint *dp = dps[i];
+			if (!dp)
+				continue;
+			bool renamed = false;
+			unsigned int stage = pass(dp, renamed);
+			if ((int)stage > furthest)
+				furthest = stage;
+			if (stage < m_stages.size())
+			{
+				if (plan)
+					plan->remove(i);
+				removed->push_back(dp);
+				dps[i] = NULL;
+			}
+			else if (renamed && plan)
+			{
+				plan->rename(i, dp->getName());
+			}
+		}
+		drop = m_lastSelect >= 0 && furthest <= m_lastSelect;
+		if (drop && plan)
+			plan->drop();
+	}
+	m_stages[0].m_rule->track(reading->getAssetName());
+	if (drop)
+		delete reading;
+	else
+		out.emplace_back(reading);
+}
+
+/**
+ * Pass a datapoint through the rules, renaming it as required
+ *
+ * @param dp		The datapoint
+ * @param renamed	Set true if the datapoint is renamed
+ * @return unsigned int	The position of the rule that removes the
+ *			datapoint, or the number of rules if it is kept
+ */
+unsigned int FusedRule::pass(Datapoint *dp, bool& renamed)
+{
+	for (unsigned int i = 0; i < m_stages.size(); i++)
+	{
+		const Stage& stage = m_stages[i];
+		switch (stage.m_kind)
+		{
+			case Stage::REMOVE:
+				if (stage.m_choice.chooses(dp))
+					return i;
+				break;
+			case Stage::SELECT:
+				if (!stage.m_choice.chooses(dp))
+					return i;
+				break;
+			case Stage::MAP:
+			{
+				string newName;
+				if (static_cast<DatapointMapRule *>(stage.m_rule)->mapName(dp->getName(), newName))
+				{
+					dp->setName(newName);
+					renamed = true;
+				}
+				break;
+			}
+		}
+	}
+	return m_stages.size();
+}
@@ -0,0 +1,160 @@
+/*
+ * Fledge "asset" filter plugin glob matcher.
+ *
+ * Copyright (c) 2025 Dianomic Systems
+ *
+ * Released under the Apache 2.0 Licence
+ *
+ * Author: Mark Riddoch
+ */
+#include <glob_matcher.h>
+
+using namespace std;
+
+/**
+ * Compile a glob pattern
+ *
+ * @param pattern	The glob pattern
+ */
+GlobMatcher::GlobMatcher(const string& pattern) : m_minLength(0)
+{
+	Segment segment;
+	for (size_t i = 0; i < pattern.length(); i++)
+	{
+		char c = pattern[i];
+		if (c == '\\' && i + 1 < pattern.length())
+		{
+			segment.m_text += pattern[++i];
+			segment.m_any.push_back(false);
+		}
+		else if (c == '*')
+		{
+			m_minLength += segment.m_text.length();
+			m_segments.push_back(segment);
+			segment = Segment();
+		}
+		else
+		{
+			segment.m_text += c;
+			segment.m_any.push_back(c == '?');
+		}
+	}
+	m_minLength += segment.m_text.length();
+	m_segments.push_back(segment);
+}
+
+/**
+ * Destructor for the glob matcher
+ */
+GlobMatcher::~GlobMatcher()
+{
+}
+
+/**
+ * Check if the pattern contains no wildcards
+ *
+ * @return bool	True if the pattern only matches a single name
+ */
+bool GlobMatcher::isLiteral() const
+{
+	if (m_segments.size() > 1)
+		return false;
+	for (bool any : m_segments[0].m_any)
+	{
+		if (any)
+			return false;
+	}
+	return true;
+}
+
+/**
+ * Return the name matched by a pattern with no wildcards
+ *
+ * @return string	The name the pattern matches
+ */
+string GlobMatcher::literal() const
+{
+	return m_segments[0].m_text;
+}
+
+/**
+ * Match the whole of a string against the pattern
+ *
+ * @param str	The string to match
+ * @return bool	True if the string matches the pattern
+ */
+bool GlobMatcher::match(const string& str) const
+{
+	if (str.length() < m_minLength)
+		return false;
+	const Segment& first = m_segments.front();
+	if (m_segments.size() == 1)
+		return str.length() == first.m_text.length() && matchAt(first, str, 0);
+
+	const Segment& last = m_segments.back();
+	size_t end = str.length() - last.m_text.length();
+	if (!matchAt(first, str, 0) || !matchAt(last, str, end))
+		return false;
+
+	size_t pos = first.m_text.length();
+	for (size_t i = 1; i < m_segments.size() - 1; i++)
+	{
+		const Segment& segment = m_segments[i];
+		while (pos + segment.m_text.length() <= end && !matchAt(segment, str, pos))
+			pos++;
+		if (pos + segment.m_text.length() > end)
+			return false;
+		pos += segment.m_text.length();
+	}
+	return true;
+}
+
+/**
+ * Match a segment of the pattern at a given position in the string.
+ * The caller ensures the segment fits within the string.
+ *
+ * @param segment	The segment to match
+ * @param str		The string
+ * @param pos		The position in the string
+ * @return bool		True if the segment matches at the position
+ */
+bool GlobMatcher::matchAt(const Segment& segment, const string& str, size_t pos) const
+{
+	for (size_t i = 0; i < segment.m_text.length(); i++)
+	{
+		if (!segment.m_any[i] && segment.m_text[i] != str[pos + i])
+			return false;
+	}
+	return true;
+}
+
+/**
+ * Return a regular expression that is equivalent to the pattern.
+ * This allows glob patterns to be combined with the regular
+ * expressions of other rules in a single automaton.
+ *
+ * @return string	The equivalent regular expression
+ */
+string GlobMatcher::toRegex() const
+{
+	static const string specials = "\\^$.|?*+()[]{}";
+	string regex;
+	for (size_t s = 0; s < m_segments.size(); s++)
+	{
+		if (s > 0)
+			regex += "[\\s\\S]*";
+		const Segment& segment = m_segments[s];
+		for (size_t i = 0; i < segment.m_text.length(); i++)
+		{
+			if (segment.m_any[i])
+			{
+				regex += "[\\s\\S]";
+				continue;
+			}
+			if (specials.find(segment.m_text[i]) != string::npos)
+				regex += '\\';
+			regex += segment.m_text[i];
+		}
+	}
+	return regex;
+}
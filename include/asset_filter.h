@@ -17,7 +17,11 @@
 #include <reading_set.h>
 #include <reading.h>
 #include <rules.h>
+#include <rule_set.h>
+#include <memory>
 #include <mutex>
+#include <condition_variable>
+#include <thread>
 #include <vector>
 
 /**
@@ -31,6 +35,28 @@
  * the asset name in the rule. Each rule may result in zero
  * or more readings being returned for a single reading
  * passed into the rule.
+ *
+ * If the default action includes readings and none of the readings
+ * in a set match any rule the set is passed on unchanged, without
+ * the cost of building a new set of readings. Otherwise the results
+ * replace the readings in the set that was passed in, the buffer that
+ * collects the results is kept between calls, so that processing a
+ * set of readings need not allocate any memory. The exception is a
+ * rename to a name too long to be held within the string object
+ * itself. Reading::setAssetName takes the name by value, so each
+ * reading renamed to a long name costs the allocations of copying it.
+ *
+ * The rules, and whether the filter is enabled, are held in a rule
+ * set that is replaced as a whole when the filter is reconfigured.
+ * Each set of readings takes a reference to the current rule set, so
+ * ingest never waits for a reconfiguration and a rule set is only
+ * deleted when no readings are using it.
+ *
+ * Creating the rules may take some time if there are many regular
+ * expressions, so when the filter is reconfigured the new rule set is
+ * built on a background thread. Readings are processed by the previous
+ * rule set until the new one is ready. If several reconfigurations
+ * arrive while a rule set is being built only the latest is built.
  */
 class AssetFilter : public FledgeFilter {
 	public:
@@ -39,20 +65,27 @@ class AssetFilter : public FledgeFilter {
                         OUTPUT_HANDLE *outHandle,
                         OUTPUT_STREAM out);
 		~AssetFilter();
-		void		ingest(READINGSET *input, std::vector<Reading*>& out);
+		void		ingest(READINGSET *input);
 		void		reconfigure(const std::string& conf);
 	private:
-		int		processReading(Reading *reading,
-						std::vector<Reading *>& out,
-						std::vector<Rule *>::const_iterator rule,
-						int matches);
 		void		handleConfig(ConfigCategory& category);
+		void		buildRules(ConfigCategory& category,
+						RuleSet& rules);
+		void		compiler();
 	private:
 		Logger		*m_logger;
 		std::mutex	m_configMutex;
-		std::vector<Rule *>
+		std::shared_ptr<RuleSet>
 				m_rules;
-		Rule		*m_defaultRule;
 		std::string	m_instanceName;
+		RegexEngine	m_regexEngine;
+		std::mutex	m_compileMutex;
+		std::condition_variable
+				m_compileCV;
+		std::thread	m_compiler;
+		std::string	m_pendingConfig;
+		unsigned long	m_requested;	// Reconfigurations requested
+		unsigned long	m_compiled;	// Reconfigurations compiled
+		bool		m_shutdown;
 };
 #endif
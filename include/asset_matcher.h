@@ -0,0 +1,67 @@
+#ifndef _ASSET_MATCHER_H
+#define _ASSET_MATCHER_H
+/*
+ * Fledge "asset" filter plugin asset name matcher.
+ *
+ * Copyright (c) 2025 Dianomic Systems
+ *
+ * Released under the Apache 2.0 Licence
+ *
+ * Author: Mark Riddoch
+ */
+#include <regex_automaton.h>
+#include <string>
+#include <vector>
+
+/**
+ * The maximum number of literal names a set matcher will hold
+ */
+#define MAX_MATCHER_LITERALS	64
+
+/**
+ * A matcher for the regular expression in the asset name of a rule.
+ *
+ * The expression is analysed when the rule is constructed and, where
+ * possible, lowered to a cheaper test that is equivalent to matching
+ * the whole asset name against the expression. Expressions such as
+ * "sensor_.*", ".*_temp", "(pump|fan)1" or "plant\d" become a prefix,
+ * suffix, set of literals or character class test respectively. Only
+ * expressions that cannot be lowered need a regular expression match.
+ *
+ * Expressions such as ".*" that match every asset name are recognised
+ * so that the rule may be treated as unconditional. Since "." does not
+ * match a line break such an expression only matches every name that
+ * contains no line break, anyByte() reports if it matches every name.
+ */
+class AssetMatcher {
+	public:
+		enum MatchKind { ALL, LITERAL, PREFIX, SUFFIX, CONTAINS, SET, CHARCLASS, REGEX };
+		AssetMatcher();
+		AssetMatcher(const std::string& pattern);
+		~AssetMatcher();
+		bool		match(const std::string& asset) const;
+		MatchKind	kind() const { return m_kind; };
+		bool		anyByte() const { return m_anyByte; };
+		const char	*kindName() const;
+		const std::vector<std::string>&
+				literals() const { return m_literals; };
+	private:
+		void		lower(RegexNode *node);
+		void		flatten(RegexNode *node, std::vector<RegexNode *>& items);
+		bool		isAnyString(RegexNode *node, bool& anyByte);
+		bool		expand(RegexNode *node, std::vector<std::string>& strings);
+		bool		expand(std::vector<RegexNode *>::iterator first,
+					std::vector<RegexNode *>::iterator last,
+					std::vector<std::string>& strings);
+		bool		classes(RegexNode *node, std::vector<CharSet>& sequence);
+		bool		noLineBreak(const std::string& str, size_t from, size_t to) const;
+	private:
+		MatchKind	m_kind;
+		std::string	m_literal;
+		bool		m_anyByte;
+		std::vector<std::string>
+				m_literals;
+		std::vector<CharSet>
+				m_classes;
+};
+#endif
@@ -0,0 +1,90 @@
+#ifndef _CASE_FOLD_H
+#define _CASE_FOLD_H
+/*
+ * Fledge "asset" filter plugin case folding.
+ *
+ * Copyright (c) 2025 Dianomic Systems
+ *
+ * Released under the Apache 2.0 Licence
+ *
+ * Author: Mark Riddoch
+ */
+#include <string>
+
+/**
+ * Fold the ASCII upper case letters in a string to lower case.
+ * Characters outside the ASCII range are not changed.
+ *
+ * @param str		The string to fold
+ * @param folded	Populated with the folded string
+ */
+void		foldCase(const std::string& str, std::string& folded);
+
+/**
+ * Fold the ASCII upper case letters in a string to lower case
+ *
+ * @param str		The string to fold
+ * @return string	The folded string
+ */
+std::string	foldCase(const std::string& str);
+
+/**
+ * Fold the literal characters of a regular expression to lower case.
+ * Escape sequences are left unchanged so that, for example, "\D" is
+ * not turned into "\d". The folded expression matches the folded
+ * form of the strings the original expression matches ignoring case.
+ *
+ * @param pattern	The regular expression
+ * @return string	The folded regular expression
+ */
+std::string	foldPattern(const std::string& pattern);
+
+/**
+ * Check if folding the literal characters of a regular expression
+ * preserves its meaning. This is not the case if the expression has a
+ * character range that only partly covers the letters, such as [X-c],
+ * or an escape that gives a character by its code.
+ *
+ * @param pattern	The regular expression
+ * @return bool		True if foldPattern may be used on the expression
+ */
+bool		canFoldPattern(const std::string& pattern);
+
+/**
+ * Test if a string is equal to a string that has been folded to lower
+ * case, ignoring the case of the ASCII letters of the first string.
+ * No memory is allocated.
+ *
+ * @param str		The string to test
+ * @param folded	The folded string
+ * @return bool		True if the folded form of str equals folded
+ */
+bool		equalsFolded(const std::string& str, const std::string& folded);
+
+/**
+ * Compare two strings ignoring the case of ASCII letters, without
+ * allocating memory
+ *
+ * @param a		The first string
+ * @param b		The second string
+ * @return int		Less than, equal to or greater than zero, as
+ *			std::string::compare of the folded strings
+ */
+int		compareFolded(const std::string& a, const std::string& b);
+
+/**
+ * The ordering of the names in a map of datapoint names. If the case of
+ * letters is ignored the names are compared as if folded to lower case,
+ * so that a name can be looked up without folding it first.
+ */
+class NameLess {
+	public:
+		NameLess(bool ignoreCase = false) : m_ignoreCase(ignoreCase) {};
+		bool	operator()(const std::string& a, const std::string& b) const
+			{
+				return m_ignoreCase ? compareFolded(a, b) < 0 : a.compare(b) < 0;
+			};
+	private:
+		bool	m_ignoreCase;
+};
+#endif
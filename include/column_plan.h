@@ -0,0 +1,62 @@
+#ifndef _COLUMN_PLAN_H
+#define _COLUMN_PLAN_H
+/*
+ * Fledge "asset" filter plugin column plan.
+ *
+ * Copyright (c) 2025 Dianomic Systems
+ *
+ * Released under the Apache 2.0 Licence
+ *
+ * Author: Mark Riddoch
+ */
+#include <reading.h>
+#include <string>
+#include <vector>
+
+/**
+ * The plan of a rule for the datapoints of readings that share a schema.
+ *
+ * Readings of the same asset usually have the same datapoints, with
+ * the same names and types in the same order. Such readings can be
+ * treated as the rows of a table whose columns are the datapoints.
+ * Rules that remove, select or rename datapoints by name or type make
+ * the same decision for every row of a column, so the decision is made
+ * once per column and recorded in the plan. The plan is then applied
+ * to each reading by position, without matching the names or types of
+ * its datapoints again.
+ *
+ * The plan records the schema it was made for. A reading with a
+ * different schema causes the plan to be made again. A plan may also
+ * record that the reading is dropped, as when a select rule selects
+ * none of the columns. The NULL entries left in a reading by deferred
+ * removals are part of the schema.
+ */
+class ColumnPlan {
+	public:
+		ColumnPlan();
+		~ColumnPlan();
+		bool		sameSchema(const std::vector<Datapoint *>& dps);
+		void		reset(unsigned int columns);
+		void		remove(unsigned int column);
+		void		rename(unsigned int column, const std::string& name);
+		void		drop() { m_drop = true; };
+		bool		drops() const { return m_drop; };
+		void		apply(Reading *reading,
+						std::vector<Datapoint *> *removed) const;
+	private:
+		bool		m_valid;
+		std::vector<std::string>
+				m_names;
+		std::vector<int>
+				m_types;
+		std::vector<bool>
+				m_keep;
+		std::vector<bool>
+				m_renamed;
+		std::vector<std::string>
+				m_newNames;
+		bool		m_removes;
+		bool		m_renames;
+		bool		m_drop;
+};
+#endif
@@ -0,0 +1,196 @@
+#ifndef _DATAPOINT_CHOICE_H
+#define _DATAPOINT_CHOICE_H
+/*
+ * Fledge "asset" filter plugin datapoint choice.
+ *
+ * Copyright (c) 2025 Dianomic Systems
+ *
+ * Released under the Apache 2.0 Licence
+ *
+ * Author: Mark Riddoch
+ */
+#include <logger.h>
+#include <reading.h>
+#include <regex_engine.h>
+#include <case_fold.h>
+#include <string>
+#include <vector>
+
+/**
+ * The datapoints chosen by a remove or select rule, by name, regular
+ * expression, list of names or type.
+ *
+ * The way the datapoints are chosen is fixed when the rule is
+ * constructed. The test for each mode is a template specialisation, so
+ * a kernel that is instantiated for the mode tests the datapoints
+ * without checking how the rule was configured.
+ *
+ * The choice is a small value. The rule holds one, and the rule program
+ * packs a copy into the op that executes the rule, so that the program
+ * tests the datapoints without referring back to the rule. The copies
+ * share the regular expressions, which are owned by the rule.
+ */
+class DatapointChoice {
+	public:
+		enum Mode { NONE, NAME, REGEX, NAMES, TYPE, NUMBER, NON_NUMERIC,
+				USER_ARRAY };
+		DatapointChoice() : m_mode(NONE), m_regex(NULL),
+			m_caseInsensitive(false) {};
+		static Mode	typeMode(const std::string& type);
+		template<Mode mode>
+		bool		chooses(Datapoint *dp) const;
+		bool		chooses(Datapoint *dp) const;
+		template<Mode mode, bool select>
+		void		remove(Reading *reading,
+						std::vector<Datapoint *> *removed) const;
+		template<bool select>
+		void		remove(Reading *reading,
+						std::vector<Datapoint *> *removed) const;
+	public:
+		Mode		m_mode;
+		std::string	m_name;		// The datapoint name or type
+		Regex		*m_regex;
+		std::vector<std::string>
+				m_names;	// The literal names of a list
+		std::vector<Regex *>
+				m_regexes;	// The regular expressions of a list
+		bool		m_caseInsensitive;
+};
+
+/**
+ * Test if a datapoint is chosen. The literal names of a list are
+ * tested before the regular expressions, which are comparatively slow.
+ *
+ * @param dp	The datapoint to test
+ * @return bool	True if the datapoint is chosen
+ */
+template<DatapointChoice::Mode mode>
+bool DatapointChoice::chooses(Datapoint *dp) const
+{
+	switch (mode)
+	{
+		case NAME:
+			return m_caseInsensitive ? equalsFolded(dp->getName(), m_name)
+				: m_name.compare(dp->getName()) == 0;
+		case REGEX:
+			return m_regex->match(dp->getName());
+		case NAMES:
+		{
+			const std::string& name = dp->getName();
+			for (const std::string& literal : m_names)
+			{
+				if (m_caseInsensitive ? equalsFolded(name, literal)
+						: literal.compare(name) == 0)
+					return true;
+			}
+			for (Regex *re : m_regexes)
+			{
+				if (re->match(name))
+					return true;
+			}
+			return false;
+		}
+		case TYPE:
+			return dp->getData().getTypeStr() == m_name;
+		case NUMBER:
+		{
+			std::string type = dp->getData().getTypeStr();
+			return type == "FLOAT" || type == "INTEGER";
+		}
+		case NON_NUMERIC:
+		{
+			std::string type = dp->getData().getTypeStr();
+			return type != "FLOAT" && type != "INTEGER";
+		}
+		case USER_ARRAY:
+		{
+			std::string type = dp->getData().getTypeStr();
+			return type == "FLOAT_ARRAY" || type == "2D_FLOAT_ARRAY";
+		}
+		default:
+			return false;
+	}
+}
+
+/**
+ * Remove datapoints from a reading, either those that are chosen or,
+ * for a select rule, those that are not. The datapoints that remain
+ * are compacted in a single pass, unless the removal is deferred in
+ * which case the removed datapoints are left as NULL entries.
+ *
+ * @param reading	The reading to process
+ * @param removed	The list of removed datapoints or NULL to delete them
+ */
+template<DatapointChoice::Mode mode, bool select>
+void DatapointChoice::remove(Reading *reading, std::vector<Datapoint *> *removed) const
+{
+	std::vector<Datapoint *>& dps = reading->getReadingData();
+	if (removed)
+	{
+		for (auto& dp : dps)
+		{
+			if (dp && chooses<mode>(dp) != select)
+			{
+				removed->push_back(dp);
+				dp = NULL;
+			}
+		}
+		return;
+	}
+	auto keep = dps.begin();
+	for (auto it = dps.begin(); it != dps.end(); ++it)
+	{
+		Datapoint *dp = *it;
+		if (chooses<mode>(dp) != select)
+		{
+			if (!select)
+				Logger::getLogger()->debug("Removing datapoint with name %s", dp->getName().c_str());
+			delete dp;
+		}
+		else
+		{
+			*keep++ = dp;
+		}
+	}
+	dps.erase(keep, dps.end());
+}
+
+/**
+ * Remove datapoints from a reading with the kernel for the mode of the
+ * choice
+ *
+ * @param reading	The reading to process
+ * @param removed	The list of removed datapoints or NULL to delete them
+ */
+template<bool select>
+void DatapointChoice::remove(Reading *reading, std::vector<Datapoint *> *removed) const
+{
+	switch (m_mode)
+	{
+		case NAME:
+			remove<NAME, select>(reading, removed);
+			break;
+		case REGEX:
+			remove<REGEX, select>(reading, removed);
+			break;
+		case NAMES:
+			remove<NAMES, select>(reading, removed);
+			break;
+		case TYPE:
+			remove<TYPE, select>(reading, removed);
+			break;
+		case NUMBER:
+			remove<NUMBER, select>(reading, removed);
+			break;
+		case NON_NUMERIC:
+			remove<NON_NUMERIC, select>(reading, removed);
+			break;
+		case USER_ARRAY:
+			remove<USER_ARRAY, select>(reading, removed);
+			break;
+		default:
+			remove<NONE, select>(reading, removed);
+			break;
+	}
+}
+#endif
@@ -0,0 +1,71 @@
+#ifndef _FUSED_RULE_H
+#define _FUSED_RULE_H
+/*
+ * Fledge "asset" filter plugin fused rule.
+ *
+ * Copyright (c) 2025 Dianomic Systems
+ *
+ * Released under the Apache 2.0 Licence
+ *
+ * Author: Mark Riddoch
+ */
+#include <rules.h>
+#include <column_plan.h>
+#include <reading.h>
+#include <vector>
+
+/**
+ * A run of consecutive remove, select and datapoint map rules that
+ * match the same asset names, executed as a single pass over the
+ * datapoints of a reading.
+ *
+ * None of these rules change the asset name, so a reading that
+ * matches the first rule of the run matches every rule of the run.
+ * Each rule makes its decision for a datapoint independently of the
+ * other datapoints, so the rules may be applied to one datapoint at a
+ * time: each datapoint passes through the rules in order, being
+ * renamed by a map or stopped by a remove or select, and a later rule
+ * sees the name given by an earlier map. This gives the same result as
+ * applying each rule to the whole reading in turn.
+ *
+ * A select rule drops the reading if it leaves no datapoints. The
+ * reading is dropped if no datapoint passes the last select rule of
+ * the run, since a datapoint that passes the last passes them all.
+ *
+ * Each stage holds a copy of the datapoint choice of a remove or
+ * select rule, so the datapoints are tested without referring back
+ * to the rule.
+ *
+ * The fused rule is only executed by the rule program, which defers
+ * the removal of datapoints.
+ */
+class FusedRule {
+	public:
+		FusedRule();
+		~FusedRule();
+		void		add(RemoveRule *rule);
+		void		add(SelectRule *rule);
+		void		add(DatapointMapRule *rule);
+		void		execute(Reading *reading, std::vector<Reading *>& out,
+						ColumnPlan *plan,
+						std::vector<Datapoint *> *removed);
+		unsigned int	size() const { return m_stages.size(); };
+	private:
+		class Stage {
+			public:
+				enum Kind { REMOVE, SELECT, MAP };
+				Stage(Kind kind, Rule *rule) : m_kind(kind), m_rule(rule) {};
+				Stage(Kind kind, Rule *rule, const DatapointChoice& choice) :
+					m_kind(kind), m_rule(rule), m_choice(choice) {};
+				Kind	m_kind;
+				Rule	*m_rule;
+				DatapointChoice
+					m_choice;
+		};
+		unsigned int	pass(Datapoint *dp, bool& renamed);
+	private:
+		std::vector<Stage>
+				m_stages;
+		int		m_lastSelect;
+};
+#endif
@@ -0,0 +1,52 @@
+#ifndef _GLOB_MATCHER_H
+#define _GLOB_MATCHER_H
+/*
+ * Fledge "asset" filter plugin glob matcher.
+ *
+ * Copyright (c) 2025 Dianomic Systems
+ *
+ * Released under the Apache 2.0 Licence
+ *
+ * Author: Mark Riddoch
+ */
+#include <string>
+#include <vector>
+
+/**
+ * A matcher for glob style wildcard patterns.
+ *
+ * A '*' in the pattern matches any sequence of characters, including
+ * an empty sequence, and a '?' matches any single character. Either
+ * may be preceded by a '\' to match the character itself. All other
+ * characters match themselves.
+ *
+ * The pattern is compiled into the literal segments between the '*'
+ * wildcards. The first segment must match at the start of the string
+ * and the last at the end, each of the others is matched at its
+ * leftmost position after the previous segment. Since a '*' matches
+ * anything the leftmost position is always the best choice, so the
+ * match never needs to backtrack.
+ */
+class GlobMatcher {
+	public:
+		GlobMatcher(const std::string& pattern);
+		~GlobMatcher();
+		bool		match(const std::string& str) const;
+		bool		isLiteral() const;
+		std::string	literal() const;
+		std::string	toRegex() const;
+	private:
+		class Segment {
+			public:
+				std::string		m_text;
+				std::vector<bool>	m_any;
+		};
+		bool		matchAt(const Segment& segment,
+						const std::string& str,
+						size_t pos) const;
+	private:
+		std::vector<Segment>
+				m_segments;
+		size_t		m_minLength;
+};
+#endif
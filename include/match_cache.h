@@ -0,0 +1,75 @@
+#ifndef _MATCH_CACHE_H
+#define _MATCH_CACHE_H
+/*
+ * Fledge "asset" filter plugin match cache.
+ *
+ * Copyright (c) 2025 Dianomic Systems
+ *
+ * Released under the Apache 2.0 Licence
+ *
+ * Author: Mark Riddoch
+ */
+#include <rule_index.h>
+#include <string>
+#include <vector>
+#include <unordered_map>
+
+/**
+ * The maximum number of distinct asset names for which we will
+ * hold a match plan. Once this is reached the least used plans
+ * are discarded, this bounds the memory used in pipelines that
+ * generate asset names dynamically.
+ */
+#define MAX_CACHED_PLANS	10000
+
+/**
+ * A match cache for the asset filter rules.
+ *
+ * Whether a rule is executed on a reading depends only upon the
+ * asset name of the reading. Rather than match every reading against
+ * every rule we hold, for each asset name we have seen, the ordered
+ * list of the rules that match that name. After the cache has warmed
+ * up the cost of matching a reading against the rules is a single
+ * hash lookup. The plan for a new asset name is built using the
+ * rule index.
+ *
+ * Each plan records when it was built and whether it has been used
+ * again since the cache was last full. The flag is only written the
+ * first time a plan is reused, so a lookup that finds a plan does not
+ * normally write to it. When the cache is full half of the plans are
+ * discarded, those that have not been reused first and the oldest
+ * first within each. Asset names that are seen often keep their plans
+ * while names that are seen only once are rebuilt when seen again.
+ * The flags of the plans that are kept are cleared, so that names that
+ * are no longer seen eventually lose their plans.
+ *
+ * The cache must be cleared whenever the set of rules changes.
+ */
+class MatchCache {
+	public:
+		MatchCache(const RuleIndex& index);
+		~MatchCache();
+		unsigned int	next(const std::string& asset, unsigned int rule);
+		void		clear();
+		unsigned int	size() const { return m_plans.size(); };
+		bool		cached(const std::string& asset) const;
+	private:
+		class Plan {
+			public:
+				Plan() : m_age(0), m_used(false) {};
+				std::vector<unsigned int>
+						m_rules;
+				unsigned long	m_age;		// The order in which the plan was built
+				bool		m_used;		// Used since the cache was last full
+		};
+		const std::vector<unsigned int>&
+				lookup(const std::string& asset);
+		void		evict();
+	private:
+		const RuleIndex&
+				m_index;
+		std::unordered_map<std::string, Plan>
+				m_plans;
+		unsigned long	m_built;
+};
+#endif
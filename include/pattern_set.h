@@ -0,0 +1,71 @@
+#ifndef _PATTERN_SET_H
+#define _PATTERN_SET_H
+/*
+ * Fledge "asset" filter plugin pattern set.
+ *
+ * Copyright (c) 2025 Dianomic Systems
+ *
+ * Released under the Apache 2.0 Licence
+ *
+ * Author: Mark Riddoch
+ */
+#include <regex_automaton.h>
+#include <string>
+#include <vector>
+
+/**
+ * The maximum number of DFA states that will be built for a pattern
+ * set. Any state beyond this is matched by simulating the NFA.
+ */
+#define MAX_DFA_STATES	4096
+
+/**
+ * A set of regular expressions compiled into a single automaton.
+ *
+ * All of the expressions are combined into one NFA, from which a DFA
+ * is built when the set is compiled. Matching a string against the set
+ * is then a single pass over the string that returns the identifiers of
+ * every expression that matches the whole of the string.
+ *
+ * The set is immutable once compiled and may be matched from many
+ * threads at once.
+ */
+class PatternSet {
+	public:
+		PatternSet();
+		~PatternSet();
+		bool		add(const std::string& pattern, unsigned int id,
+						bool ignoreCase = false);
+		void		compile();
+		void		clear();
+		bool		empty() const { return m_starts.empty(); };
+		unsigned int	size() const { return m_starts.size(); };
+		unsigned int	dfaStates() const { return m_dfa.size(); };
+		void		match(const std::string& str,
+					std::vector<unsigned int>& ids) const;
+	private:
+		class DFAState {
+			public:
+				std::vector<int>	m_states;
+				std::vector<int>	m_next;
+				std::vector<unsigned int>
+							m_accept;
+		};
+		void		buildClasses();
+		void		accepting(std::vector<int> states, bool atStart,
+					std::vector<char>& marks,
+					std::vector<unsigned int>& ids) const;
+		void		simulate(const std::vector<int>& states,
+					const std::string& str, size_t pos,
+					std::vector<unsigned int>& ids) const;
+	private:
+		RegexNFA	m_nfa;
+		std::vector<int>
+				m_starts;
+		int		m_start;
+		unsigned char	m_classes[256];
+		unsigned int	m_nClasses;
+		std::vector<DFAState>
+				m_dfa;
+};
+#endif
@@ -0,0 +1,137 @@
+#ifndef _PIPELINE_H
+#define _PIPELINE_H
+/*
+ * Fledge "asset" filter plugin rule pipeline.
+ *
+ * Copyright (c) 2025 Dianomic Systems
+ *
+ * Released under the Apache 2.0 Licence
+ *
+ * Author: Mark Riddoch
+ */
+#include <filter.h>
+#include <logger.h>
+#include <reading_set.h>
+#include <reading.h>
+#include <rules.h>
+#include <rule_index.h>
+#include <match_cache.h>
+#include <rule_program.h>
+#include <ring_buffer.h>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <thread>
+#include <vector>
+
+/**
+ * The maximum number of stages the rules may be divided into
+ */
+#define MAX_PIPELINE_STAGES	16
+
+/**
+ * The number of chunks of a set of readings that may be in the
+ * pipeline for each stage
+ */
+#define PIPELINE_BATCHES_PER_STAGE	2
+
+/**
+ * The fewest readings in a chunk of a set of readings
+ */
+#define MIN_PIPELINE_CHUNK	16
+
+/**
+ * The interval in seconds between reports of the occupancy of the stages
+ */
+#define PIPELINE_REPORT_INTERVAL	60
+
+/**
+ * The rules of the filter divided into stages that are run by
+ * threads of their own.
+ *
+ * A set of readings is divided into chunks of consecutive readings.
+ * Each stage executes a contiguous range of the compiled rules on a
+ * chunk and passes the chunk on to the next stage, through a single
+ * producer, single consumer ring buffer. Several chunks are processed
+ * at once, each in a different stage. The last stage applies the
+ * default rule and returns the chunk to the thread that delivered the
+ * readings, which collects the results of the chunks in order. Ingest
+ * returns once the whole set has been processed, so the results are
+ * passed on by the caller just as they are without a pipeline.
+ *
+ * The stages are divided between the ops that the program dispatches,
+ * the ops within a fused run are not counted, and no stage is empty.
+ *
+ * The chunks are carried through the pipeline in batches that are
+ * allocated when the pipeline is created. If there is no free batch
+ * the delivering thread waits for the oldest chunk to complete.
+ *
+ * The proportion of the time each stage is busy and the average
+ * number of chunks waiting for it are reported in the log, so that the
+ * number of stages can be chosen to balance the stages.
+ */
+class Pipeline {
+	public:
+		Pipeline(const RuleIndex& index, const std::vector<Rule *>& rules,
+				Rule *defaultRule, unsigned int stages);
+		~Pipeline();
+		void		ingest(READINGSET *input);
+		unsigned int	stages() const { return m_stages.size(); };
+	private:
+		class Batch {
+			public:
+				std::vector<Reading *>
+						m_readings;
+				std::vector<RuleProgram::Pending>
+						m_items;
+				std::vector<RuleProgram::Pending>
+						m_next;
+				std::vector<Reading *>
+						m_output;
+		};
+		class Stage {
+			public:
+				Stage(const RuleIndex& index, unsigned int batches) :
+					m_cache(index), m_program(m_cache),
+					m_from(0), m_to(0), m_queue(batches),
+					m_busy(0), m_batches(0), m_queued(0),
+					m_reportedBusy(0), m_reportedBatches(0),
+					m_reportedQueued(0) {};
+				MatchCache	m_cache;
+				RuleProgram	m_program;
+				unsigned int	m_from;		// The first op of the stage
+				unsigned int	m_to;		// The op after the last op
+				RingBuffer<Batch *>
+						m_queue;	// The batches waiting for the stage
+				std::thread	m_thread;
+				std::atomic<uint64_t>
+						m_busy;		// Nanoseconds spent processing
+				std::atomic<uint64_t>
+						m_batches;	// Batches processed
+				std::atomic<uint64_t>
+						m_queued;	// Sum of the queue lengths seen
+				uint64_t	m_reportedBusy;
+				uint64_t	m_reportedBatches;
+				uint64_t	m_reportedQueued;
+		};
+		Pipeline(const Pipeline&) = delete;
+		Pipeline&	operator=(const Pipeline&) = delete;
+		void		run(unsigned int stage);
+		void		report();
+	private:
+		Logger		*m_logger;
+		Rule		*m_defaultRule;
+		std::vector<Stage *>
+				m_stages;
+		std::vector<Batch *>
+				m_batches;	// All the batches of the pipeline
+		std::vector<Batch *>
+				m_spare;	// The free batches held by the delivering thread
+		RingBuffer<Batch *>
+				m_done;		// The batches completed by the last stage
+		std::vector<Reading *>
+				m_output;	// The results of the set of readings
+		std::chrono::steady_clock::time_point
+				m_lastReport;
+};
+#endif
@@ -0,0 +1,127 @@
+#ifndef _REGEX_AUTOMATON_H
+#define _REGEX_AUTOMATON_H
+/*
+ * Fledge "asset" filter plugin regular expression automaton.
+ *
+ * Copyright (c) 2025 Dianomic Systems
+ *
+ * Released under the Apache 2.0 Licence
+ *
+ * Author: Mark Riddoch
+ */
+#include <string>
+#include <vector>
+#include <bitset>
+
+/**
+ * A set of characters, one bit for each of the possible byte values
+ */
+typedef std::bitset<256> CharSet;
+
+/**
+ * A node in the parse tree of a regular expression
+ */
+class RegexNode {
+	public:
+		enum NodeType { EMPTY, CHARS, CONCAT, ALTERNATE, REPEAT, GROUP,
+				LINE_START, LINE_END };
+		RegexNode(NodeType type);
+		~RegexNode();
+		bool		nullable() const;
+		bool		repeatsEmpty() const;
+	public:
+		NodeType	m_type;
+		CharSet		m_chars;
+		std::vector<RegexNode *>
+				m_children;
+		int		m_min;
+		int		m_max;
+		bool		m_greedy;
+		int		m_group;
+};
+
+/**
+ * A parser for the regular expressions used in the asset filter rules.
+ *
+ * The parser supports the subset of the ECMAScript syntax that can be
+ * matched without backtracking; literals, escapes, character classes,
+ * the any character, groups, alternation, the greedy and lazy
+ * quantifiers and the start and end anchors. Back references, look
+ * ahead and word boundaries are not supported, the parse will fail
+ * for any expression that uses them and the caller should fall back
+ * to std::regex for that expression.
+ *
+ * If the case of letters is to be ignored each character set in the
+ * tree includes both cases of any ASCII letter it contains, as the
+ * icase flag of std::regex would.
+ */
+class RegexParser {
+	public:
+		RegexParser(const std::string& pattern, bool ignoreCase = false);
+		~RegexParser();
+		RegexNode	*parse();
+		int		groups() const { return m_groups; };
+	private:
+		RegexNode	*parseAlternate();
+		RegexNode	*parseConcat();
+		RegexNode	*parseRepeat();
+		RegexNode	*parseAtom();
+		bool		parseBounds(int& min, int& max);
+		bool		parseClass(CharSet& chars);
+		bool		parseEscape(CharSet& chars, bool& single);
+		bool		atEnd() const { return m_pos >= m_pattern.length(); };
+		char		peek() const { return m_pattern[m_pos]; };
+	private:
+		const std::string	m_pattern;
+		size_t			m_pos;
+		int			m_groups;
+		bool			m_error;
+		bool			m_ignoreCase;
+};
+
+/**
+ * A Thompson NFA built from one or more regular expression parse trees.
+ *
+ * Each expression compiled into the NFA ends in a match state that
+ * carries the identifier given when the expression was compiled,
+ * allowing a single NFA to recognise many expressions at once. Split
+ * states try their first branch before the second, this preserves the
+ * priority of alternation and greedy or lazy repetition.
+ */
+class RegexNFA {
+	public:
+		enum StateType { CHARS, SPLIT, JUMP, SAVE, LINE_START, LINE_END, MATCH };
+		class State {
+			public:
+				StateType	m_type;
+				int		m_out;
+				int		m_out1;
+				int		m_arg;
+		};
+		RegexNFA();
+		~RegexNFA();
+		int		compile(RegexNode *node, int id);
+		int		split(int first, int second);
+		void		closure(std::vector<int>& states,
+						std::vector<char>& marks,
+						bool atStart, bool atEnd) const;
+		void		step(const std::vector<int>& states,
+						unsigned char c,
+						std::vector<int>& next) const;
+		bool		tooLarge() const { return m_tooLarge; };
+		unsigned int	size() const { return m_states.size(); };
+		const State&	state(int i) const { return m_states[i]; };
+		const CharSet&	chars(int i) const { return m_charSets[m_states[i].m_arg]; };
+		const std::vector<CharSet>&
+				charSets() const { return m_charSets; };
+	private:
+		int		add(StateType type, int out, int out1, int arg);
+		int		emit(RegexNode *node, int next);
+	private:
+		std::vector<State>
+				m_states;
+		std::vector<CharSet>
+				m_charSets;
+		bool		m_tooLarge;
+};
+#endif
@@ -0,0 +1,86 @@
+#ifndef _REGEX_ENGINE_H
+#define _REGEX_ENGINE_H
+/*
+ * Fledge "asset" filter plugin regular expressions.
+ *
+ * Copyright (c) 2025 Dianomic Systems
+ *
+ * Released under the Apache 2.0 Licence
+ *
+ * Author: Mark Riddoch
+ */
+#include <regex_automaton.h>
+#include <pattern_set.h>
+#include <regex>
+#include <string>
+#include <vector>
+
+/**
+ * The regular expression engines that may be used by the rules
+ */
+enum RegexEngine {
+	STANDARD_REGEX,	// The C++ standard library regular expressions
+	LINEAR_REGEX	// The linear time automaton
+};
+
+/**
+ * A compiled regular expression used by the rules to match and
+ * substitute asset and datapoint names.
+ *
+ * The expression is matched either by the C++ standard library or,
+ * if the linear engine is requested, by an automaton that takes time
+ * proportional to the length of the string being matched. Whole string
+ * matches are done with a DFA, substitutions use a Pike VM to track the
+ * capture groups. The semantics of regex_match and regex_replace are
+ * preserved, including the priority of alternation and of greedy and
+ * lazy repetition when choosing the capture groups.
+ *
+ * If the case of letters is ignored the automaton includes both cases
+ * of each letter in its character sets. The standard library is given
+ * the expression with its letters folded to lower case and matches it
+ * against a folded copy of the string, the matches are then applied to
+ * the original string. Only expressions that cannot be folded, because
+ * they contain a range such as [X-c] or give characters by their code,
+ * use the icase flag.
+ *
+ * Expressions that the automaton does not support fall back to the
+ * standard library. So do expressions that repeat a sub-expression
+ * that can match the empty string, such as (a*)+ or (.*?)*, for which
+ * the automaton would choose different capture groups and match
+ * extents than std::regex. Invalid expressions throw std::regex_error, as the
+ * standard library does.
+ */
+class Regex {
+	public:
+		Regex(const std::string& pattern, RegexEngine engine = STANDARD_REGEX,
+						bool ignoreCase = false);
+		~Regex();
+		bool		match(const std::string& str) const;
+		std::string	replace(const std::string& str,
+						const std::string& format) const;
+		bool		isLinear() const { return m_regex == NULL; };
+	private:
+		Regex(const Regex&) = delete;
+		Regex&		operator=(const Regex&) = delete;
+		bool		search(const std::string& str, size_t from,
+						bool notNull, std::vector<int>& captures) const;
+		void		addThread(std::vector<int>& threads,
+						std::vector<std::vector<int> >& captures,
+						std::vector<unsigned int>& marks,
+						unsigned int generation,
+						int state, const std::vector<int>& caps,
+						const std::string& str, size_t pos) const;
+		std::string	replaceFolded(const std::string& str,
+						const std::string& format) const;
+		void		format(std::string& result, const std::string& format,
+						const std::string& str, size_t prefix,
+						const std::vector<int>& captures) const;
+	private:
+		std::regex	*m_regex;
+		PatternSet	m_set;
+		RegexNFA	m_nfa;
+		int		m_start;
+		int		m_groups;
+		bool		m_folded;	// The standard expression has been folded
+};
+#endif
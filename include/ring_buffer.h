@@ -0,0 +1,172 @@
+#ifndef _RING_BUFFER_H
+#define _RING_BUFFER_H
+/*
+ * Fledge "asset" filter plugin ring buffer.
+ *
+ * Copyright (c) 2025 Dianomic Systems
+ *
+ * Released under the Apache 2.0 Licence
+ *
+ * Author: Mark Riddoch
+ */
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/**
+ * The number of times a thread checks a ring buffer before it sleeps
+ * waiting for the buffer
+ */
+#define RING_BUFFER_SPINS	100
+
+/**
+ * A bounded ring buffer that passes values from one producer thread
+ * to one consumer thread.
+ *
+ * The producer only writes the tail and the consumer only writes the
+ * head, so neither needs a lock to add or remove a value. A thread
+ * that finds the buffer full or empty checks it a few times before
+ * it sleeps. The other thread only takes the mutex to wake it when a
+ * thread has said that it is sleeping.
+ */
+template<class T> class RingBuffer {
+	public:
+		/**
+		 * Construct a ring buffer
+		 *
+		 * @param capacity	The minimum number of values the buffer holds
+		 */
+		RingBuffer(unsigned int capacity) : m_head(0), m_tail(0), m_sleepers(0)
+		{
+			unsigned int size = 1;
+			while (size < capacity)
+				size <<= 1;
+			m_slots.resize(size);
+			m_mask = size - 1;
+		};
+
+		/**
+		 * Add a value to the buffer if there is room
+		 *
+		 * @param value	The value to add
+		 * @return bool	False if the buffer is full
+		 */
+		bool		tryPush(const T& value)
+		{
+			unsigned long tail = m_tail.load(std::memory_order_relaxed);
+			if (tail - m_head.load(std::memory_order_acquire) > m_mask)
+				return false;
+			m_slots[tail & m_mask] = value;
+			m_tail.store(tail + 1, std::memory_order_seq_cst);
+			wake();
+			return true;
+		};
+
+		/**
+		 * Remove the oldest value from the buffer if there is one
+		 *
+		 * @param value	Set to the value removed
+		 * @return bool	False if the buffer is empty
+		 */
+		bool		tryPop(T& value)
+		{
+			unsigned long head = m_head.load(std::memory_order_relaxed);
+			if (head == m_tail.load(std::memory_order_acquire))
+				return false;
+			value = m_slots[head & m_mask];
+			m_head.store(head + 1, std::memory_order_seq_cst);
+			wake();
+			return true;
+		};
+
+		/**
+		 * Add a value to the buffer, waiting for room if it is full
+		 *
+		 * @param value	The value to add
+		 */
+		void		push(const T& value)
+		{
+			while (!tryPush(value))
+				wait([this]() { return size() <= m_mask; });
+		};
+
+		/**
+		 * Remove the oldest value, waiting for one if the buffer is empty
+		 *
+		 * @return T	The value removed
+		 */
+		T		pop()
+		{
+			T value;
+			while (!tryPop(value))
+				wait([this]() { return size() > 0; });
+			return value;
+		};
+
+		/**
+		 * Return the number of values in the buffer
+		 */
+		unsigned int	size() const
+		{
+			return m_tail.load() - m_head.load();
+		};
+
+		/**
+		 * Return the number of values the buffer can hold
+		 */
+		unsigned int	capacity() const { return m_mask + 1; };
+	private:
+		RingBuffer(const RingBuffer&) = delete;
+		RingBuffer&	operator=(const RingBuffer&) = delete;
+
+		/**
+		 * Wait until a condition holds, first by checking it a few
+		 * times then by sleeping until the other thread changes the
+		 * buffer
+		 *
+		 * @param ready	The condition to wait for
+		 */
+		template<class Condition> void	wait(Condition ready)
+		{
+			for (int i = 0; i < RING_BUFFER_SPINS; i++)
+			{
+				if (ready())
+					return;
+				std::this_thread::yield();
+			}
+			std::unique_lock<std::mutex> lck(m_mutex);
+			m_sleepers++;
+			m_cv.wait(lck, ready);
+			m_sleepers--;
+		};
+
+		/**
+		 * Wake the other thread if it is sleeping on the buffer
+		 */
+		void		wake()
+		{
+			if (m_sleepers.load() > 0)
+			{
+				std::lock_guard<std::mutex> guard(m_mutex);
+				m_cv.notify_all();
+			}
+		};
+	private:
+		std::vector<T>	m_slots;
+		unsigned int	m_mask;
+		char		m_pad1[64];
+		std::atomic<unsigned long>
+				m_head;		// Written by the consumer
+		char		m_pad2[64];
+		std::atomic<unsigned long>
+				m_tail;		// Written by the producer
+		char		m_pad3[64];
+		std::atomic<int>
+				m_sleepers;
+		std::mutex	m_mutex;
+		std::condition_variable
+				m_cv;
+};
+#endif
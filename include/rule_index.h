@@ -0,0 +1,67 @@
+#ifndef _RULE_INDEX_H
+#define _RULE_INDEX_H
+/*
+ * Fledge "asset" filter plugin rule index.
+ *
+ * Copyright (c) 2025 Dianomic Systems
+ *
+ * Released under the Apache 2.0 Licence
+ *
+ * Author: Mark Riddoch
+ */
+#include <rules.h>
+#include <pattern_set.h>
+#include <string>
+#include <vector>
+#include <unordered_map>
+
+/**
+ * An index of the rules by the asset name they match.
+ *
+ * Rules whose asset name is a literal name, that have a list of asset
+ * names, or a regular expression that matches only a small set of
+ * literal names, are held in a hash index keyed by those names. A
+ * single lookup finds all the literal rules for an asset. The regular
+ * expressions of the remaining rules are compiled into a single
+ * automaton that finds all the matching rules in one pass over the
+ * asset name. Only expressions that the automaton cannot represent
+ * need to be tried one by one.
+ *
+ * Rules whose asset name matches every name, such as ".*", are held
+ * as unconditional rules and need no matching. If every rule is
+ * unconditional then every asset name matches every rule.
+ *
+ * Rules that ignore case are indexed by their folded literal names.
+ * The asset name is folded once, and the folded copy is used both to
+ * look these up and to match the rules that are tried one by one.
+ * Their regular expressions ignore case within the automaton.
+ *
+ * The positions of the rules are always returned in the order
+ * the rules appear in the configuration.
+ */
+class RuleIndex {
+	public:
+		RuleIndex();
+		~RuleIndex();
+		void		build(const std::vector<Rule *>& rules);
+		void		clear();
+		void		matches(const std::string& asset,
+						std::vector<unsigned int>& rules) const;
+		bool		matchesAll(const std::string& asset) const;
+		unsigned int	size() const { return m_rules.size(); };
+	private:
+		std::vector<Rule *>
+				m_rules;
+		std::unordered_map<std::string, std::vector<unsigned int> >
+				m_literals;
+		std::unordered_map<std::string, std::vector<unsigned int> >
+				m_foldedLiterals;
+		PatternSet	m_patterns;
+		std::vector<unsigned int>
+				m_fallback;
+		std::vector<unsigned int>
+				m_unconditional;
+		bool		m_anyName;
+		bool		m_ignoreCase;	// Some of the rules ignore case
+};
+#endif
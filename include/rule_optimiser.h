@@ -0,0 +1,65 @@
+#ifndef _RULE_OPTIMISER_H
+#define _RULE_OPTIMISER_H
+/*
+ * Fledge "asset" filter plugin rule optimiser.
+ *
+ * Copyright (c) 2025 Dianomic Systems
+ *
+ * Released under the Apache 2.0 Licence
+ *
+ * Author: Mark Riddoch
+ */
+#include <rules.h>
+#include <logger.h>
+#include <string>
+#include <vector>
+
+/**
+ * A static analysis of the rules of the filter that removes the rules
+ * that can never be executed and moves exclude rules ahead of the
+ * rules that transform the readings they exclude.
+ *
+ * A rule can never be executed if an earlier rule matches every asset
+ * name the rule matches and either excludes those readings or renames
+ * them to a fixed name the rule does not match, provided that no rule
+ * in between could give a reading one of the names again. A rename
+ * with a regular expression, a split or a rule of an unknown class
+ * may give a reading any name.
+ *
+ * An exclude rule may be moved ahead of any rule that neither changes
+ * the name of a reading it excludes, nor gives a reading a name it
+ * excludes, nor creates new readings. A reading it excludes then has
+ * the same name at either position and the rules it passes over only
+ * have effects on the reading itself. The
+ * exclude is moved ahead of the earliest such rule that may match the
+ * same assets, after which the rules it fully covers can never be
+ * executed and are removed. A chain of transformations that ends in
+ * an exclude of the same asset therefore reduces to the exclude.
+ *
+ * The analysis is conservative. Only rules whose asset names are
+ * literal names or sets of names are shown to be covered by, or to
+ * not overlap with, another rule, other than rules with identical
+ * matches.
+ */
+class RuleOptimiser {
+	public:
+		RuleOptimiser();
+		~RuleOptimiser();
+		void		optimise(std::vector<Rule *>& rules);
+	private:
+		enum Kind { INCLUDE, EXCLUDE, RENAME, TRANSFORM, SPLIT, OTHER };
+		static Kind	kind(Rule *rule);
+		static const char
+				*actionName(Rule *rule);
+		bool		names(Rule *rule, std::vector<std::string>& names);
+		bool		covers(Rule *rule, Rule *other);
+		bool		disjoint(Rule *rule, Rule *other);
+		bool		kills(Rule *rule, Rule *other);
+		bool		mayProduce(Rule *rule, Rule *other);
+		bool		canPass(Rule *exclude, Rule *rule);
+		bool		hoistExcludes(std::vector<Rule *>& rules);
+		bool		removeDeadRules(std::vector<Rule *>& rules);
+	private:
+		Logger		*m_logger;
+};
+#endif
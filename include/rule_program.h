@@ -0,0 +1,249 @@
+#ifndef _RULE_PROGRAM_H
+#define _RULE_PROGRAM_H
+/*
+ * Fledge "asset" filter plugin rule program.
+ *
+ * Copyright (c) 2025 Dianomic Systems
+ *
+ * Released under the Apache 2.0 Licence
+ *
+ * Author: Mark Riddoch
+ */
+#include <rules.h>
+#include <fused_rule.h>
+#include <match_cache.h>
+#include <column_plan.h>
+#include <reading.h>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+/**
+ * The compiled form of the rules of the asset filter.
+ *
+ * The rules are compiled into a flat program of action ops, one per
+ * rule in the order of the configuration. The match cache acts as the
+ * match op, giving for each asset name the position of the next op
+ * whose rule matches the name.
+ *
+ * Each op is a tagged record and the ops are held contiguously. The
+ * tag gives both the kind of the rule and the way it was configured,
+ * a remove rule that removes a datapoint by name has a different tag
+ * from one that removes datapoints by type. The fields the rule reads
+ * for each reading are packed into the op when it is compiled: the new
+ * name of a rename, and the names, expressions or type that choose the
+ * datapoints of a remove or select. The interpreter dispatches on the
+ * tag with a single switch to a kernel specialised for the tag, which
+ * reads only the op. The rule itself is only referred to when a reading
+ * has an asset name the op has not passed to it for tracking.
+ *
+ * The rules that flatten, split, nest or map datapoints do work for
+ * each datapoint that outweighs the dispatch, the interpreter calls
+ * the execute method of the rule class directly, rather than through
+ * the virtual function table. Rules of any other class are executed
+ * through the Rule interface.
+ *
+ * The program is executed by an iterative interpreter. Each rule may
+ * turn a reading into zero or more readings, each of which must then
+ * pass through the remaining rules. Rather than recursing once per
+ * rule the interpreter keeps a work list of readings and the op at
+ * which each resumes. The work list and the buffer that receives the
+ * results of each action are reused for every reading, so running the
+ * program allocates no memory of its own once they have grown to size.
+ * The readings are processed depth first, which gives the same output
+ * order as executing the rules recursively.
+ *
+ * A whole set of readings may instead be run grouped by asset name.
+ * The readings are grouped and the first matching op is found once
+ * for each group. Each op is then applied in a tight loop to all of
+ * the readings that have reached it before moving on to the next op.
+ * This relies upon every rule producing at most one reading from each
+ * reading, so that the original order of the readings can be restored
+ * simply by keeping the position of the reading each result came from.
+ * Programs that include a split rule, or a rule of a class the program
+ * does not know, must be run a reading at a time.
+ *
+ * When run grouped, the rules that remove, select or map datapoints
+ * use a column plan per op. The readings of a group usually share a
+ * schema, so the datapoints are matched once per schema rather than
+ * once per reading.
+ *
+ * A run of consecutive rules that remove, select or map datapoints
+ * and match exactly the same asset names is fused into a single op
+ * when the program is compiled. The op passes each datapoint through
+ * all the rules of the run in one pass. The other ops of the run are
+ * left in place but are never reached, since the op that follows the
+ * fused op is the one after the end of the run.
+ *
+ * The removal of datapoints is deferred along the chain of rules.
+ * The rules that remove or select datapoints leave a NULL entry in
+ * place of each datapoint they remove and pass the datapoint to the
+ * program, rather than compacting the datapoints of the reading and
+ * deleting the datapoint each time. The rules that rename or map
+ * datapoints skip the NULL entries. The reading is compacted once,
+ * before it reaches a rule that is unaware of the NULL entries or
+ * when it leaves the program, and the removed datapoints are deleted
+ * together at the end of the run.
+ *
+ * Once the buffers of the program have grown to size, and the asset
+ * names have been seen before, running the program allocates no
+ * memory. The asset names of the groups are kept from one run to the
+ * next, along with the run in which they were last used, so that a
+ * name that has been seen before is grouped without copying it.
+ *
+ * The program may also be run in stages, each stage executing a
+ * contiguous range of the ops on a whole set of readings. A reading
+ * passes from one stage to the next as a pending item that records
+ * the next op that matches it, so that the stages may be run by
+ * different programs compiled from the same rules, one batch of
+ * readings behind another. The items stay in the order in which run
+ * would have produced them. Only the ops that may be dispatched mark
+ * the start of a stage, a stage that started inside a fused run would
+ * never be reached.
+ *
+ * The program is not reentrant, it must only be run by one thread
+ * at a time.
+ */
+class RuleProgram {
+	public:
+		/**
+		 * A reading part way through a staged run of the program
+		 */
+		class Pending {
+			public:
+				Pending(Reading *reading, unsigned int op, bool dirty,
+						bool matched) :
+					m_reading(reading), m_op(op), m_dirty(dirty),
+					m_matched(matched) {};
+				Reading		*m_reading;
+				unsigned int	m_op;		// The next op that matches the reading
+				bool		m_dirty;
+				bool		m_matched;	// An op has been executed
+		};
+		RuleProgram(MatchCache& cache);
+		~RuleProgram();
+		void		compile(const std::vector<Rule *>& rules);
+		void		clear();
+		int		run(Reading *reading, std::vector<Reading *>& out);
+		void		runGrouped(const std::vector<Reading *>& readings,
+						Rule *defaultRule,
+						std::vector<Reading *>& out);
+		void		start(const std::vector<Reading *>& readings,
+						std::vector<Pending>& pending);
+		void		runStage(const std::vector<Pending>& in,
+						unsigned int from, unsigned int to,
+						std::vector<Pending>& out);
+		void		finish(const std::vector<Pending>& pending,
+						Rule *defaultRule,
+						std::vector<Reading *>& out);
+		bool		canGroup() const { return m_canGroup; };
+		unsigned int	size() const { return m_ops.size(); };
+		void		dispatched(std::vector<unsigned int>& ops) const;
+	private:
+		class Op {
+			public:
+				// The remove and select codes follow the order
+				// of the modes of DatapointChoice
+				enum OpCode { INCLUDE, EXCLUDE, RENAME, RENAME_REGEX,
+						REMOVE_NONE, REMOVE_NAME, REMOVE_REGEX,
+						REMOVE_NAMES, REMOVE_TYPE, REMOVE_NUMBER,
+						REMOVE_NON_NUMERIC, REMOVE_USER_ARRAY,
+						SELECT_NONE, SELECT_NAME, SELECT_REGEX,
+						SELECT_NAMES, SELECT_TYPE, SELECT_NUMBER,
+						SELECT_NON_NUMERIC, SELECT_USER_ARRAY,
+						FLATTEN, DATAPOINTMAP, SPLIT, NEST, GENERIC,
+						FUSED };
+				Op(OpCode code, Rule *rule) : m_code(code), m_rule(rule),
+					m_deferred(code != FLATTEN && code != SPLIT &&
+						code != NEST && code != GENERIC),
+					m_length(1), m_fused(NULL), m_regex(NULL),
+					m_hasTracked(false) {};
+				OpCode		m_code;
+				Rule		*m_rule;
+				bool		m_deferred;	// The rule allows removed datapoints
+				unsigned int	m_length;	// The number of rules executed by the op
+				FusedRule	*m_fused;
+				std::string	m_name;		// The new name or format of a rename
+				const Regex	*m_regex;	// The asset expression of a rename
+				DatapointChoice	m_choice;	// The datapoints of a remove or select
+				std::string	m_tracked;	// The asset name last tracked
+				bool		m_hasTracked;
+		};
+		class Work {
+			public:
+				Work(Reading *reading, unsigned int op, bool dirty) :
+					m_reading(reading), m_op(op), m_dirty(dirty) {};
+				Reading		*m_reading;
+				unsigned int	m_op;
+				bool		m_dirty;
+		};
+		class Item {
+			public:
+				Item(Reading *reading, unsigned int origin, bool dirty) :
+					m_reading(reading), m_origin(origin), m_dirty(dirty) {};
+				Reading		*m_reading;
+				unsigned int	m_origin;
+				bool		m_dirty;
+		};
+		class Group {
+			public:
+				Group() : m_index(0), m_generation(0) {};
+				unsigned int	m_index;
+				unsigned long	m_generation;
+		};
+		static Op::OpCode
+				opCode(Rule *rule);
+		static void	pack(Op& op);
+		void		fuse();
+		static bool	isRemove(Op::OpCode code)
+				{
+					return code >= Op::REMOVE_NONE && code <= Op::REMOVE_USER_ARRAY;
+				};
+		static bool	isSelect(Op::OpCode code)
+				{
+					return code >= Op::SELECT_NONE && code <= Op::SELECT_USER_ARRAY;
+				};
+		static bool	canFuse(const Op& op)
+				{
+					return isRemove(op.m_code) || isSelect(op.m_code)
+						|| op.m_code == Op::DATAPOINTMAP;
+				};
+		void		execute(Op& op, Reading *reading,
+						std::vector<Reading *>& out,
+						ColumnPlan *plan);
+		static bool	track(Op& op, const std::string& asset);
+		template<bool isRegex>
+		static void	rename(Op& op, Reading *reading,
+						std::vector<Reading *>& out);
+		template<DatapointChoice::Mode mode, bool select>
+		void		choose(Op& op, Reading *reading,
+						std::vector<Reading *>& out,
+						ColumnPlan *plan);
+		static void	sweep(Reading *reading);
+		void		release();
+	private:
+		MatchCache&	m_cache;
+		std::vector<Op>	m_ops;
+		std::vector<Work>
+				m_work;
+		std::vector<Reading *>
+				m_results;
+		bool		m_canGroup;
+		std::unordered_map<std::string, Group>
+				m_groups;
+		std::vector<const std::string *>
+				m_groupNames;
+		unsigned long	m_generation;
+		std::string	m_lastName;
+		std::vector<std::vector<unsigned int> >
+				m_groupReadings;
+		std::vector<std::vector<Item> >
+				m_stages;
+		std::vector<Reading *>
+				m_slots;
+		std::vector<ColumnPlan>
+				m_plans;
+		std::vector<Datapoint *>
+				m_removed;
+};
+#endif
@@ -0,0 +1,111 @@
+#ifndef _RULE_SET_H
+#define _RULE_SET_H
+/*
+ * Fledge "asset" filter plugin rule set.
+ *
+ * Copyright (c) 2025 Dianomic Systems
+ *
+ * Released under the Apache 2.0 Licence
+ *
+ * Author: Mark Riddoch
+ */
+#include <filter.h>
+#include <reading_set.h>
+#include <reading.h>
+#include <rules.h>
+#include <rule_index.h>
+#include <match_cache.h>
+#include <rule_program.h>
+#include <worker_pool.h>
+#include <pipeline.h>
+#include <vector>
+
+/**
+ * The compiled rules of one configuration of the asset filter.
+ *
+ * A rule set is built when the filter is configured. The filter
+ * publishes the rule set by replacing a shared pointer, each set of
+ * readings is processed by the rule set that was current when the
+ * readings arrived. A reconfiguration therefore never waits for, or
+ * interferes with, a set of readings that is being processed. The rules
+ * are deleted with the rule set, once the last set of readings that uses
+ * it has been processed.
+ *
+ * The rules, the default rule, the rule index and whether the filter is
+ * enabled are fixed once the rule set has been compiled, and are only
+ * read after it has been published. The state of the rules themselves,
+ * such as the assets they have tracked, may still change.
+ *
+ * The contexts, each with a match cache, a program and buffers, the
+ * results of the ranges of readings and the pipeline hold the working
+ * state of the ingest, which changes with every set of readings. They
+ * are only used by the thread that delivers readings to the filter and
+ * by the worker or pipeline threads it passes the readings to. Fledge
+ * passes one set of readings at a time to a filter.
+ *
+ * If more than one thread is configured a large set of readings is
+ * divided into contiguous ranges that are processed by a pool of
+ * threads. Each thread has its own working state, the rules themselves
+ * are shared. Assets that the rules have not tracked before are held by
+ * each thread and tracked once all the threads have finished. The
+ * results of each range are kept apart and placed in the reading set
+ * in the order of the ranges, so the order of the results is the same
+ * as if the set had been processed by a single thread.
+ *
+ * Alternatively the rules may be divided into a pipeline of stages,
+ * each run by a thread of its own. A large set of readings is divided
+ * into chunks that pass through the stages one behind another. The
+ * results are collected in order and passed on before ingest returns,
+ * as they are by the other ways of processing the readings.
+ */
+class RuleSet {
+	public:
+		RuleSet(unsigned int threads = 1, unsigned int threshold = 0,
+				unsigned int stages = 1);
+		~RuleSet();
+		void		addRule(Rule *rule);
+		void		setDefaultRule(Rule *rule);
+		Rule		*getDefaultRule() const { return m_defaultRule; };
+		void		setEnabled(bool enabled) { m_enabled = enabled; };
+		bool		isEnabled() const { return m_enabled; };
+		void		compile();
+		void		ingest(READINGSET *input, OUTPUT_STREAM func,
+					OUTPUT_HANDLE *data);
+	private:
+		class Context {
+			public:
+				Context(const RuleIndex& index) :
+					m_cache(index), m_program(m_cache) {};
+				MatchCache	m_cache;
+				RuleProgram	m_program;
+				std::vector<Reading *>
+						m_input;
+				std::vector<Reading *>
+						m_output;
+				DeferredTracking
+						m_tracking;
+		};
+		RuleSet(const RuleSet&) = delete;
+		RuleSet&	operator=(const RuleSet&) = delete;
+		void		process(Context& context,
+						const std::vector<Reading *>& readings,
+						std::vector<Reading *>& out);
+		bool		passthrough(READINGSET *input);
+		void		ingestInline(READINGSET *input);
+		void		ingestParallel(READINGSET *input);
+	private:
+		std::vector<Rule *>
+				m_rules;
+		Rule		*m_defaultRule;
+		RuleIndex	m_index;
+		std::vector<Context *>
+				m_contexts;
+		WorkerPool	*m_pool;
+		unsigned int	m_threshold;
+		Pipeline	*m_pipeline;
+		unsigned int	m_stages;
+		bool		m_enabled;
+		std::vector<std::vector<Reading *> >
+				m_outputs;	// The results of each range of readings
+};
+#endif
@@ -12,8 +12,40 @@
 #include <logger.h>
 #include <reading.h>
 #include <asset_tracking.h>
+#include <regex_engine.h>
+#include <asset_matcher.h>
+#include <glob_matcher.h>
+#include <case_fold.h>
+#include <column_plan.h>
+#include <datapoint_choice.h>
 #include <map>
 #include <regex>
+#include <unordered_map>
+#include <unordered_set>
+
+/**
+ * The maximum number of asset names a rule remembers having tracked.
+ * Once this is reached the names are forgotten and tracked again.
+ */
+#define MAX_TRACKED_ASSETS	10000
+
+class Rule;
+
+/**
+ * The asset names that rules have processed for the first time while
+ * a thread is processing readings on behalf of the thread that
+ * delivers readings to the filter. The names are passed to the asset
+ * tracker by the delivering thread once all the threads have finished,
+ * so that the threads never wait for one another to track an asset.
+ */
+class DeferredTracking {
+	public:
+		void		add(Rule *rule, const std::string& asset);
+		void		apply();
+	private:
+		std::unordered_map<Rule *, std::unordered_set<std::string> >
+				m_assets;
+};
 
 /**
  * The base rule class upon which all rules are implemented.
@@ -23,24 +55,91 @@
  * either based on the exact match of a rule or by using a regex.
  * Since regex is comparitively slow we cache the compiled regex
  * expression and only use regex if the asset name in the rule
- * contains any special characters.
+ * contains any special characters. The regular expression engine
+ * used by the rule is chosen when the rule is constructed.
+ *
+ * Regular expressions for the asset name are analysed when the rule
+ * is constructed and, where possible, matched with a simpler test
+ * such as a prefix or set of literal names.
+ *
+ * A rule may also be given a list of asset names, these are held in
+ * a hash set so that the cost of matching does not depend upon the
+ * number of names in the list.
+ *
+ * The rule definition may set the match mode to "literal", "glob" or
+ * "regex" to override the check for special characters in the name.
+ *
+ * If the rule sets case_insensitive the case of ASCII letters is
+ * ignored when matching asset and datapoint names. Literal names are
+ * folded to lower case once when the rule is constructed. Datapoint
+ * names are folded as they are compared, without making a copy. The
+ * asset name is folded once by the caller and shared by all the rules.
+ * Regular expressions ignore case within the automaton, or are folded
+ * in the same way for the standard engine, rather than using
+ * regex::icase.
  */
 class Rule {
 	public:
-		Rule(const std::string& service, const std::string& asset);
+		Rule(const std::string& service, const std::string& asset,
+				RegexEngine engine = STANDARD_REGEX);
+		Rule(const std::string& service, const std::string& asset,
+				const rapidjson::Value& json,
+				RegexEngine engine = STANDARD_REGEX);
 		virtual ~Rule();
 		virtual void	execute(Reading *reading, std::vector<Reading *>& out) = 0;
 		bool		match(Reading *reading);
+		bool		match(const std::string& asset);
+		bool		match(const std::string& asset,
+						const std::string& folded);
 		std::string	getName() { return m_asset; };
+		bool		isLiteral() { return !m_assetIsRegex && !m_assetIsSet && !m_glob; };
+		bool		isAssetSet() { return m_assetIsSet; };
+		const std::unordered_set<std::string>&
+				getAssetNames() { return m_assetNames; };
+		bool		isUnconditional() { return m_matcher && m_matcher->kind() == AssetMatcher::ALL; };
+		const AssetMatcher
+				*getMatcher() { return m_matcher; };
+		const GlobMatcher
+				*getGlob() { return m_glob; };
+		bool		isCaseInsensitive() { return m_caseInsensitive; };
+		void		track(const std::string& asset);
+		static void	deferTracking(DeferredTracking *deferred);
+		bool		sameMatch(const Rule& other) const;
 	protected:
 		bool		isRegexString(const std::string& str);
+		std::string	foldName(const std::string& name)
+				{
+					return m_caseInsensitive ? foldCase(name) : name;
+				};
+		bool		sameName(const std::string& name, const std::string& other)
+				{
+					return m_caseInsensitive ? equalsFolded(other, name)
+						: name.compare(other) == 0;
+				};
+	private:
+		bool		matchName(const std::string& asset);
+		void		compileAsset(const std::string& asset);
+		void		compileRegex(const std::string& asset);
+		void		compileGlob(const std::string& asset);
 	protected:
 		Logger		*m_logger;
 		std::string	m_asset;
 		bool		m_assetIsRegex;
-		std::regex	*m_asset_re;
+		Regex		*m_asset_re;
+		AssetMatcher	*m_matcher;
+		bool		m_assetIsSet;
+		GlobMatcher	*m_glob;
+		std::unordered_set<std::string>
+				m_assetNames;
 		std::string	m_service;
 		AssetTracker	*m_tracker;
+		RegexEngine	m_engine;
+		bool		m_caseInsensitive;
+	private:
+		std::unordered_set<std::string>
+				m_tracked;
+		static thread_local DeferredTracking
+				*m_deferred;	// Where the calling thread defers tracking
 };
 
 /**
@@ -51,7 +150,8 @@ class Rule {
  */
 class IncludeRule : public Rule {
 	public:
-		IncludeRule(const std::string& service, const std::string& asset);
+		IncludeRule(const std::string& service, const std::string& asset, const rapidjson::Value& json,
+				RegexEngine engine = STANDARD_REGEX);
 		IncludeRule(const std::string& service);
 		~IncludeRule();
 		void		execute(Reading *reading, std::vector<Reading *>& out);
@@ -65,7 +165,8 @@ class IncludeRule : public Rule {
  */
 class ExcludeRule : public Rule {
 	public:
-		ExcludeRule(const std::string& service, const std::string& asset);
+		ExcludeRule(const std::string& service, const std::string& asset, const rapidjson::Value& json,
+				RegexEngine engine = STANDARD_REGEX);
 		ExcludeRule(const std::string& service);
 		~ExcludeRule();
 		void		execute(Reading *reading, std::vector<Reading *>& out);
@@ -74,34 +175,66 @@ class ExcludeRule : public Rule {
 /**
  * The rename rule. Any matching rule is rename. Regular expressions can be
  * used to rename multiple assets in a single rule.
+ *
+ * The rule is executed by a kernel for either a literal or a regular
+ * expression rename, chosen when the rule is constructed.
  */
 class RenameRule : public Rule {
 	public:
-		RenameRule(const std::string& service, const std::string& asset, const rapidjson::Value& json);
+		RenameRule(const std::string& service, const std::string& asset, const rapidjson::Value& json,
+				RegexEngine engine = STANDARD_REGEX);
 		~RenameRule();
 		void		execute(Reading *reading, std::vector<Reading *>& out);
+		bool		fixedNewName(std::string& name);
+		const std::string&
+				getNewName() { return m_newName; };
+		const Regex	*getRenameRegex() { return m_isRegex ? m_asset_re : NULL; };
+	private:
+		template<bool isRegex>
+		void		rename(Reading *reading);
 	private:
 		std::string	m_newName;
 		bool		m_isRegex;
 		std::regex	*m_newRegex;
+		void		(RenameRule::*m_kernel)(Reading *reading);
 };
 
 /**
  * The remove rule. Remove one or more datapoints from a matching reading.
+ *
+ * The datapoints may be chosen by name, regular expression, list of
+ * names or type. The datapoint choice of the rule provides a kernel
+ * specialised for the way the datapoints are chosen, so the datapoints
+ * are tested without checking how the rule was configured.
+ *
+ * The rule may also be executed with a column plan, in which case
+ * the datapoints to remove are only chosen when the schema of the
+ * readings changes.
+ *
+ * The removal of the datapoints may be deferred. The datapoints are
+ * then moved to a list of removed datapoints and left as NULL entries
+ * in the reading, to be compacted once the reading has passed through
+ * the rules and deleted in a single pass.
  */
 class RemoveRule : public Rule {
 	public:
-		RemoveRule(const std::string& service, const std::string& asset, const rapidjson::Value& json);
+		RemoveRule(const std::string& service, const std::string& asset, const rapidjson::Value& json,
+				RegexEngine engine = STANDARD_REGEX);
 		~RemoveRule();
 		void		execute(Reading *reading, std::vector<Reading *>& out);
+		void		execute(Reading *reading, std::vector<Reading *>& out,
+						ColumnPlan *plan,
+						std::vector<Datapoint *> *removed);
+		bool		removesDatapoint(Datapoint *dp)
+				{
+					return m_choice.chooses(dp);
+				};
+		const DatapointChoice&
+				getChoice() { return m_choice; };
 	private:
 		bool		validateType(const std::string& type);
 	private:
-		std::string	m_datapoint;
-		std::regex	*m_regex;
-		std::string	m_type;
-		std::vector<std::string>
-				m_datapoints;
+		DatapointChoice	m_choice;
 };
 
 /**
@@ -112,7 +245,8 @@ class RemoveRule : public Rule {
  */
 class FlattenRule : public Rule {
 	public:
-		FlattenRule(const std::string& service, const std::string& asset);
+		FlattenRule(const std::string& service, const std::string& asset, const rapidjson::Value& json,
+				RegexEngine engine = STANDARD_REGEX);
 		FlattenRule(const std::string& service);
 		~FlattenRule();
 		void		execute(Reading *reading, std::vector<Reading *>& out);
@@ -122,15 +256,21 @@ class FlattenRule : public Rule {
 
 /**
  * Datapoint map rule. Map the names of datapoints in matching readings.
+ * The NULL entries left by deferred removals are ignored.
  */
 class DatapointMapRule : public Rule {
 	public:
-		DatapointMapRule(const std::string& service, const std::string& asset, const rapidjson::Value& json);
+		DatapointMapRule(const std::string& service, const std::string& asset, const rapidjson::Value& json,
+				RegexEngine engine = STANDARD_REGEX);
 		~DatapointMapRule();
 		void         execute(Reading *reading, std::vector<Reading *>& out);
+		void		execute(Reading *reading, std::vector<Reading *>& out,
+						ColumnPlan *plan);
+		bool		mapName(const std::string& name, std::string& newName);
 	private:
-		std::map<std::string, std::string> m_dpMap;
-		std::map<std::regex *, std::string>  m_dpRegexMap;
+		std::map<std::string, std::string, NameLess> m_dpMap;
+		std::vector<std::pair<Regex *, std::string> >
+				m_dpRegexMap;
 };
 
 /**
@@ -138,7 +278,8 @@ class DatapointMapRule : public Rule {
  */
 class SplitRule : public Rule {
 	public:
-		SplitRule(const std::string& service, const std::string& asset, const rapidjson::Value& json);
+		SplitRule(const std::string& service, const std::string& asset, const rapidjson::Value& json,
+				RegexEngine engine = STANDARD_REGEX);
 		~SplitRule();
 		void         execute(Reading *reading, std::vector<Reading *>& out);
 	private:
@@ -147,20 +288,30 @@ class SplitRule : public Rule {
 
 /**
  * Select Rule. Select a set of datapoints to include in the reading.
+ *
+ * As with the remove rule the datapoint choice of the rule provides
+ * a kernel specialised for the way the datapoints are chosen, and the
+ * removal of the datapoints that are not selected may be deferred.
  */
 class SelectRule : public Rule {
 	public:
-		SelectRule(const std::string& service, const std::string& asset, const rapidjson::Value& json);
+		SelectRule(const std::string& service, const std::string& asset, const rapidjson::Value& json,
+				RegexEngine engine = STANDARD_REGEX);
 		~SelectRule();
 		void         execute(Reading *reading, std::vector<Reading *>& out);
+		void		execute(Reading *reading, std::vector<Reading *>& out,
+						ColumnPlan *plan,
+						std::vector<Datapoint *> *removed);
+		bool		selectsDatapoint(Datapoint *dp)
+				{
+					return m_choice.chooses(dp);
+				};
+		const DatapointChoice&
+				getChoice() { return m_choice; };
 	private:
 		bool	     validateType(const std::string& type);
 	private:
-		std::vector<std::string>
-				m_datapoints;
-		std::vector<std::regex>
-				m_regexes;
-		std::string	m_type;
+		DatapointChoice	m_choice;
 };
 
 /**
@@ -168,7 +319,8 @@ class SelectRule : public Rule {
  */
 class NestRule : public Rule {
 	public:
-		NestRule(const std::string& service, const std::string& asset, const rapidjson::Value& json);
+		NestRule(const std::string& service, const std::string& asset, const rapidjson::Value& json,
+				RegexEngine engine = STANDARD_REGEX);
 		~NestRule();
 		void         execute(Reading *reading, std::vector<Reading *>& out);
 	private:
@@ -0,0 +1,82 @@
+#ifndef _WORKER_POOL_H
+#define _WORKER_POOL_H
+/*
+ * Fledge "asset" filter plugin worker pool.
+ *
+ * Copyright (c) 2025 Dianomic Systems
+ *
+ * Released under the Apache 2.0 Licence
+ *
+ * Author: Mark Riddoch
+ */
+#include <atomic>
+#include <cstdint>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/**
+ * The maximum number of threads that may be used to process a set
+ * of readings
+ */
+#define MAX_WORKER_THREADS	64
+
+/**
+ * A pool of threads that share the tasks of a job.
+ *
+ * The tasks of a job are numbered from zero and each is run exactly
+ * once, by one of the threads of the pool or by the thread that runs
+ * the job, which takes part as worker zero. The job returns when all
+ * of its tasks are complete. Only one job may be run at a time.
+ *
+ * The tasks are shared between the workers by work stealing. Each
+ * worker starts with a queue of an equal share of the tasks, which it
+ * takes from the front. A worker that empties its queue steals tasks
+ * from the back of the queues of the other workers, so that a few
+ * expensive tasks do not leave the other workers idle. Each queue is
+ * the range of tasks it holds, packed in a single atomic word, so that
+ * taking or stealing a task is a compare and swap. Tasks are never
+ * added to a queue during a job, the ends of each range only move
+ * towards each other.
+ */
+class WorkerPool {
+	public:
+		WorkerPool(unsigned int threads);
+		~WorkerPool();
+		void		run(unsigned int tasks,
+					const std::function<void(unsigned int worker,
+						unsigned int task)>& task);
+		unsigned int	size() const { return m_queues.size(); };
+	private:
+		class Queue {
+			public:
+				Queue() : m_range(0) {};
+				std::atomic<uint64_t>
+						m_range;	// First task in the high word, end in the low word
+				char		m_pad[64 - sizeof(std::atomic<uint64_t>)];
+		};
+		WorkerPool(const WorkerPool&) = delete;
+		WorkerPool&	operator=(const WorkerPool&) = delete;
+		void		worker(unsigned int id);
+		void		execute(unsigned int worker);
+		bool		take(unsigned int worker, unsigned int& task);
+		bool		steal(unsigned int worker, unsigned int& task);
+	private:
+		std::vector<std::thread>
+				m_threads;
+		std::vector<Queue>
+				m_queues;
+		std::mutex	m_mutex;
+		std::condition_variable
+				m_startCV;
+		std::condition_variable
+				m_doneCV;
+		const std::function<void(unsigned int, unsigned int)>
+				*m_task;
+		unsigned int	m_active;	// Threads working on the current job
+		unsigned long	m_job;
+		bool		m_shutdown;
+};
+#endif
@@ -0,0 +1,130 @@
+/*
+ * Fledge "asset" filter plugin match cache.
+ *
+ * Copyright (c) 2025 Dianomic Systems
+ *
+ * Released under the Apache 2.0 Licence
+ *
+ * Author: Mark Riddoch
+ */
+#include <match_cache.h>
+#include <algorithm>
+
+using namespace std;
+
+/**
+ * Construct a match cache for a set of rules
+ *
+ * @param index	The index of the rules the cache serves
+ */
+MatchCache::MatchCache(const RuleIndex& index) : m_index(index), m_built(0)
+{
+}
+
+/**
+ * Destructor for the match cache
+ */
+MatchCache::~MatchCache()
+{
+}
+
+/**
+ * Discard all the cached match plans. This must be called
+ * whenever the rules are changed.
+ */
+void MatchCache::clear()
+{
+	m_plans.clear();
+}
+
+/**
+ * Return the position of the first rule, at or after the
+ * given rule position, that matches the asset name.
+ *
+ * No reference to the cached plan is retained by the caller,
+ * therefore the cache is free to discard plans at any time. If
+ * every rule is unconditional no plan is needed.
+ *
+ * @param asset	The asset name to match
+ * @param rule	The position of the first rule to consider
+ * @return unsigned int	The position of the matching rule or the
+ *			number of rules if no further rule matches
+ */
+unsigned int MatchCache::next(const string& asset, unsigned int rule)
+{
+	if (m_index.matchesAll(asset))
+		return min(rule, m_index.size());
+	const vector<unsigned int>& plan = lookup(asset);
+	auto it = lower_bound(plan.begin(), plan.end(), rule);
+	if (it == plan.end())
+		return m_index.size();
+	return *it;
+}
+
+/**
+ * Check if the cache holds a match plan for an asset name
+ *
+ * @param asset	The asset name
+ * @return bool	True if there is a plan for the asset name
+ */
+bool MatchCache::cached(const string& asset) const
+{
+	return m_plans.find(asset) != m_plans.end();
+}
+
+/**
+ * Lookup the match plan for an asset name, creating it if this
+ * is the first time we have seen the asset name. The reuse of a
+ * plan is only recorded the first time, so that finding a plan
+ * does not usually write to it.
+ *
+ * @param asset	The asset name
+ * @return vector	The ordered positions of the rules that match the asset
+ */
+const vector<unsigned int>& MatchCache::lookup(const string& asset)
+{
+	auto it = m_plans.find(asset);
+	if (it != m_plans.end())
+	{
+		if (!it->second.m_used)
+			it->second.m_used = true;
+		return it->second.m_rules;
+	}
+
+	if (m_plans.size() >= MAX_CACHED_PLANS)
+	{
+		evict();
+	}
+	Plan& plan = m_plans[asset];
+	plan.m_age = m_built++;
+	m_index.matches(asset, plan.m_rules);
+	return plan.m_rules;
+}
+
+/**
+ * Discard half of the plans. Plans that have not been used since
+ * they were built, or since the cache was last full, are discarded
+ * before those that have, and older plans before newer ones. The
+ * plans that are kept must be used again to survive the next time
+ * the cache is full.
+ */
+void MatchCache::evict()
+{
+	typedef unordered_map<string, Plan>::iterator PlanIterator;
+	vector<PlanIterator> plans;
+	plans.reserve(m_plans.size());
+	for (auto it = m_plans.begin(); it != m_plans.end(); ++it)
+		plans.push_back(it);
+	auto keep = plans.begin() + plans.size() / 2;
+	nth_element(plans.begin(), keep, plans.end(),
+			[](const PlanIterator& a, const PlanIterator& b) {
+				if (a->second.m_used != b->second.m_used)
+					return b->second.m_used;
+				return a->second.m_age < b->second.m_age;
+			});
+
+	for (auto it = plans.begin(); it != keep; ++it)
+		m_plans.erase(*it);
+	for (auto it = keep; it != plans.end(); ++it)
+		(*it)->second.m_used = false;
+}
@@ -19,8 +19,10 @@ using namespace rapidjson;
  * @param service The name of the service
  * @param asset	The asset name
  * @param json	JSON configuration element for rule
+ * @param engine	The regular expression engine to use
  */
-NestRule::NestRule(const string& service, const string& asset, const Value& json) : Rule(service, asset)
+NestRule::NestRule(const string& service, const string& asset, const Value& json, RegexEngine engine) :
+	Rule(service, asset, json, engine)
 {
 	if (json.HasMember("nest"))
 	{
@@ -100,10 +102,7 @@ void NestRule::execute(Reading *reading, vector<Reading *>& out)
 			reading->addDatapoint(dp);
 		}
 	}
-	if (m_tracker)
-	{
-		m_tracker->addAssetTrackingTuple(m_service, reading->getAssetName(), string("Filter"));
-	}
+	track(reading->getAssetName());
 	out.emplace_back(reading);
 }
 
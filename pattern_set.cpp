@@ -0,0 +1,240 @@
+/*
+ * Fledge "asset" filter plugin pattern set.
+ *
+ * Copyright (c) 2025 Dianomic Systems
+ *
+ * Released under the Apache 2.0 Licence
+ *
+ * Author: Mark Riddoch
+ */
+#include <pattern_set.h>
+#include <algorithm>
+#include <map>
+
+using namespace std;
+
+/**
+ * Special values for the transitions of the DFA
+ */
+#define DFA_DEAD	-1	// No expression can match
+#define DFA_UNBUILT	-2	// The state was not built, simulate the NFA
+
+/**
+ * Construct an empty pattern set
+ */
+PatternSet::PatternSet() : m_start(-1), m_nClasses(0)
+{
+}
+
+/**
+ * Destructor for the pattern set
+ */
+PatternSet::~PatternSet()
+{
+}
+
+/**
+ * Add a regular expression to the set. Expressions using syntax
+ * that cannot be represented in the automaton are rejected and
+ * must be matched by other means.
+ *
+ * @param pattern	The regular expression
+ * @param id		The identifier returned when the expression matches
+ * @param ignoreCase	Ignore the case of ASCII letters when matching
+ * @return bool		True if the expression was added to the set
+ */
+bool PatternSet::add(const string& pattern, unsigned int id, bool ignoreCase)
+{
+	if (m_nfa.tooLarge())
+		return false;
+	RegexParser parser(pattern, ignoreCase);
+	RegexNode *tree = parser.parse();
+	if (!tree)
+		return false;
+	int start = m_nfa.compile(tree, id);
+	delete tree;
+	if (m_nfa.tooLarge())
+		return false;
+	m_starts.push_back(start);
+	return true;
+}
+
+/**
+ * Remove all the expressions from the set
+ */
+void PatternSet::clear()
+{
+	m_nfa = RegexNFA();
+	m_starts.clear();
+	m_dfa.clear();
+	m_start = -1;
+	m_nClasses = 0;
+}
+
+/**
+ * Compile the expressions that have been added into a DFA. The DFA
+ * is built breadth first from the start state until all states have
+ * been built or the limit on the number of states is reached.
+ */
+void PatternSet::compile()
+{
+	m_dfa.clear();
+	if (m_starts.empty())
+		return;
+
+	m_start = m_starts.back();
+	for (int i = m_starts.size() - 2; i >= 0; i--)
+		m_start = m_nfa.split(m_starts[i], m_start);
+
+	buildClasses();
+	vector<unsigned char> representative(m_nClasses);
+	for (int c = 255; c >= 0; c--)
+		representative[m_classes[c]] = c;
+
+	vector<char> marks(m_nfa.size(), 0);
+	map<vector<int>, int> index;
+
+	// The initial state is not placed in the index since it is the
+	// only state that is at the start of the string
+	DFAState initial;
+	initial.m_states.push_back(m_start);
+	m_nfa.closure(initial.m_states, marks, true, false);
+	sort(initial.m_states.begin(), initial.m_states.end());
+	initial.m_next.assign(m_nClasses, DFA_UNBUILT);
+	accepting(initial.m_states, true, marks, initial.m_accept);
+	m_dfa.push_back(initial);
+
+	vector<int> next;
+	for (unsigned int s = 0; s < m_dfa.size(); s++)
+	{
+		for (unsigned int c = 0; c < m_nClasses; c++)
+		{
+			m_nfa.step(m_dfa[s].m_states, representative[c], next);
+			if (next.empty())
+			{
+				m_dfa[s].m_next[c] = DFA_DEAD;
+				continue;
+			}
+			m_nfa.closure(next, marks, false, false);
+			sort(next.begin(), next.end());
+			auto it = index.find(next);
+			if (it != index.end())
+			{
+				m_dfa[s].m_next[c] = it->second;
+				continue;
+			}
+			if (m_dfa.size() >= MAX_DFA_STATES)
+				continue;
+			DFAState state;
+			state.m_states = next;
+			state.m_next.assign(m_nClasses, DFA_UNBUILT);
+			accepting(next, false, marks, state.m_accept);
+			index[next] = m_dfa.size();
+			m_dfa[s].m_next[c] = m_dfa.size();
+			m_dfa.push_back(state);
+		}
+	}
+}
+
+/**
+ * Partition the byte values into classes such that all the bytes in
+ * a class are accepted by exactly the same NFA states. The DFA only
+ * needs a transition per class rather than one per byte value.
+ */
+void PatternSet::buildClasses()
+{
+	for (int i = 0; i < 256; i++)
+		m_classes[i] = 0;
+	m_nClasses = 1;
+	for (auto& chars : m_nfa.charSets())
+	{
+		int remap[512];
+		for (int i = 0; i < 512; i++)
+			remap[i] = -1;
+		unsigned int count = 0;
+		for (int b = 0; b < 256; b++)
+		{
+			int key = m_classes[b] * 2 + (chars.test(b) ? 1 : 0);
+			if (remap[key] == -1)
+				remap[key] = count++;
+			m_classes[b] = remap[key];
+		}
+		m_nClasses = count;
+	}
+}
+
+/**
+ * Find the expressions that match if the string ends in a given set
+ * of states.
+ *
+ * @param states	The set of states
+ * @param atStart	True if no characters have been consumed
+ * @param marks		Scratch vector for the closure
+ * @param ids		The identifiers of the matching expressions
+ */
+void PatternSet::accepting(vector<int> states, bool atStart, vector<char>& marks, vector<unsigned int>& ids) const
+{
+	m_nfa.closure(states, marks, atStart, true);
+	for (int s : states)
+	{
+		if (m_nfa.state(s).m_type == RegexNFA::MATCH)
+			ids.push_back(m_nfa.state(s).m_arg);
+	}
+	sort(ids.begin(), ids.end());
+	ids.erase(unique(ids.begin(), ids.end()), ids.end());
+}
+
+/**
+ * Match a string against all the expressions in the set
+ *
+ * @param str	The string to match
+ * @param ids	Populated with the identifiers of the expressions
+ *		that match the whole string, in ascending order
+ */
+void PatternSet::match(const string& str, vector<unsigned int>& ids) const
+{
+	ids.clear();
+	if (m_dfa.empty())
+		return;
+	int state = 0;
+	for (size_t i = 0; i < str.length(); i++)
+	{
+		int next = m_dfa[state].m_next[m_classes[(unsigned char)str[i]]];
+		if (next == DFA_DEAD)
+		{
+			return;
+		}
+		if (next == DFA_UNBUILT)
+		{
+			simulate(m_dfa[state].m_states, str, i, ids);
+			return;
+		}
+		state = next;
+	}
+	ids = m_dfa[state].m_accept;
+}
+
+/**
+ * Continue a match by simulating the NFA. Used when the DFA
+ * reaches a state that was not built.
+ *
+ * @param states	The NFA states to start from
+ * @param str		The string being matched
+ * @param pos		The position in the string to continue from
+ * @param ids		Populated with the identifiers of the matching expressions
+ */
+void PatternSet::simulate(const vector<int>& states, const string& str, size_t pos, vector<unsigned int>& ids) const
+{
+	vector<char> marks(m_nfa.size(), 0);
+	vector<int> current(states);
+	vector<int> next;
+	for (size_t i = pos; i < str.length(); i++)
+	{
+		m_nfa.step(current, str[i], next);
+		if (next.empty())
+			return;
+		m_nfa.closure(next, marks, false, false);
+		current.swap(next);
+	}
+	accepting(current, str.empty(), marks, ids);
+}
@@ -0,0 +1,203 @@
+/*
+ * Fledge "asset" filter plugin rule pipeline.
+ *
+ * Copyright (c) 2025 Dianomic Systems
+ *
+ * Released under the Apache 2.0 Licence
+ *
+ * Author: Mark Riddoch
+ */
+#include <pipeline.h>
+#include <algorithm>
+
+using namespace std;
+
+/**
+ * Construct a pipeline. The ops the compiled rules dispatch are
+ * divided between the stages as equally as possible, there are no
+ * more stages than ops, and a thread is started for each stage.
+ *
+ * @param index		The index of the rules
+ * @param rules		The rules
+ * @param defaultRule	The rule for readings that match no rule, may be NULL
+ * @param stages	The number of stages
+ */
+Pipeline::Pipeline(const RuleIndex& index, const vector<Rule *>& rules,
+			Rule *defaultRule, unsigned int stages) :
+		m_defaultRule(defaultRule),
+		m_done(stages * PIPELINE_BATCHES_PER_STAGE)
+{
+	m_logger = Logger::getLogger();
+	unsigned int batches = stages * PIPELINE_BATCHES_PER_STAGE;
+	Stage *first = new Stage(index, batches);
+	first->m_program.compile(rules);
+	m_stages.push_back(first);
+
+	vector<unsigned int> ops;
+	first->m_program.dispatched(ops);
+	if (stages > ops.size())
+		stages = ops.size();
+	if (stages < 1)
+		stages = 1;
+	for (unsigned int i = 1; i < stages; i++)
+	{
+		Stage *stage = new Stage(index, batches);
+		stage->m_program.compile(rules);
+		m_stages.push_back(stage);
+	}
+	for (unsigned int i = 0; i < stages; i++)
+	{
+		m_stages[i]->m_from = i == 0 ? 0 : ops[ops.size() * i / stages];
+		m_stages[i]->m_to = i == stages - 1 ? first->m_program.size()
+					: ops[ops.size() * (i + 1) / stages];
+	}
+
+	batches = stages * PIPELINE_BATCHES_PER_STAGE;
+	for (unsigned int i = 0; i < batches; i++)
+	{
+		Batch *batch = new Batch();
+		m_batches.push_back(batch);
+		m_spare.push_back(batch);
+	}
+	m_lastReport = chrono::steady_clock::now();
+	for (unsigned int i = 0; i < stages; i++)
+		m_stages[i]->m_thread = thread(&Pipeline::run, this, i);
+}
+
+/**
+ * Destructor for the pipeline. No readings are in the pipeline
+ * between calls to ingest, so the threads are simply stopped.
+ */
+Pipeline::~Pipeline()
+{
+	m_stages[0]->m_queue.push(NULL);
+	for (auto& stage : m_stages)
+	{
+		stage->m_thread.join();
+		delete stage;
+	}
+	for (auto& batch : m_batches)
+		delete batch;
+}
+
+/**
+ * Process a set of readings through the pipeline. The set is divided
+ * into a chunk for each batch, or chunks of the fewest readings if the
+ * set is small, which are passed to the first stage as long as there
+ * is a free batch. The results of the chunks are collected in order
+ * as each completes and replace the readings in the set once they are
+ * all complete.
+ *
+ * @param input	The readings to process
+ */
+void Pipeline::ingest(READINGSET *input)
+{
+	const vector<Reading *>& readings = input->getAllReadings();
+	size_t chunk = (readings.size() + m_batches.size() - 1) / m_batches.size();
+	if (chunk < MIN_PIPELINE_CHUNK)
+		chunk = MIN_PIPELINE_CHUNK;
+
+	m_output.clear();
+	size_t next = 0;
+	unsigned int busy = 0;
+	while (next < readings.size() || busy > 0)
+	{
+		if (next < readings.size() && !m_spare.empty())
+		{
+			Batch *batch = m_spare.back();
+			m_spare.pop_back();
+			size_t end = min(next + chunk, readings.size());
+			batch->m_readings.assign(readings.begin() + next, readings.begin() + end);
+			next = end;
+			m_stages[0]->m_queue.push(batch);
+			busy++;
+			continue;
+		}
+
+		// The chunks complete in the order they were passed in
+		Batch *batch = m_done.pop();
+		busy--;
+		m_output.insert(m_output.end(), batch->m_output.begin(), batch->m_output.end());
+		m_spare.push_back(batch);
+	}
+
+	// The readings in the input reading set have either been
+	// deleted or reused by the rules
+	input->clear();
+	input->append(m_output);
+}
+
+/**
+ * The body of the thread of a stage. Take each batch from the queue
+ * of the stage, run the rules of the stage on it and pass it on.
+ * A NULL batch stops the stage and is passed on to stop the next.
+ *
+ * @param index	The number of the stage
+ */
+void Pipeline::run(unsigned int index)
+{
+	Stage *stage = m_stages[index];
+	bool last = index == m_stages.size() - 1;
+	while (true)
+	{
+		unsigned int queued = stage->m_queue.size();
+		Batch *batch = stage->m_queue.pop();
+		if (!batch)
+		{
+			if (!last)
+				m_stages[index + 1]->m_queue.push(NULL);
+			return;
+		}
+
+		auto start = chrono::steady_clock::now();
+		if (index == 0)
+			stage->m_program.start(batch->m_readings, batch->m_items);
+		stage->m_program.runStage(batch->m_items, stage->m_from, stage->m_to,
+				batch->m_next);
+		batch->m_items.swap(batch->m_next);
+		if (last)
+		{
+			batch->m_output.clear();
+			stage->m_program.finish(batch->m_items, m_defaultRule, batch->m_output);
+		}
+		auto end = chrono::steady_clock::now();
+		stage->m_busy += chrono::duration_cast<chrono::nanoseconds>(end - start).count();
+		stage->m_queued += queued;
+		stage->m_batches++;
+
+		if (!last)
+		{
+			m_stages[index + 1]->m_queue.push(batch);
+			continue;
+		}
+		m_done.push(batch);
+		if (end - m_lastReport >= chrono::seconds(PIPELINE_REPORT_INTERVAL))
+		{
+			report();
+			m_lastReport = end;
+		}
+	}
+}
+
+/**
+ * Report the occupancy of each stage since the last report. This is
+ * called by the thread of the last stage.
+ */
+void Pipeline::report()
+{
+	double elapsed = chrono::duration_cast<chrono::nanoseconds>(
+			chrono::steady_clock::now() - m_lastReport).count();
+	for (unsigned int i = 0; i < m_stages.size(); i++)
+	{
+		Stage *stage = m_stages[i];
+		uint64_t busy = stage->m_busy, batches = stage->m_batches, queued = stage->m_queued;
+		uint64_t count = batches - stage->m_reportedBatches;
+		m_logger->info("Pipeline stage %d, rules %d to %d: busy %.0f%%, average queue %.1f chunks of readings",
+				i + 1, stage->m_from + 1, stage->m_to,
+				elapsed > 0 ? 100.0 * (busy - stage->m_reportedBusy) / elapsed : 0.0,
+				count > 0 ? (double)(queued - stage->m_reportedQueued) / count : 0.0);
+		stage->m_reportedBusy = busy;
+		stage->m_reportedBatches = batches;
+		stage->m_reportedQueued = queued;
+	}
+}
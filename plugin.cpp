@@ -36,7 +36,34 @@
 			"\"config\" : {\"description\" : \"JSON document that defines the rules for asset names.\", " \
 				"\"type\" : \"JSON\", " \
 				"\"default\" : \"{" RULES "}\", " \
-				"\"order\" : \"1\", \"displayName\" : \"Asset rules\"} }"
+				"\"order\" : \"1\", \"displayName\" : \"Asset rules\"}, " \
+			"\"regexEngine\" : {\"description\" : \"The engine used to match and substitute regular expressions in the rules. " \
+					"The linear engine matches in a time proportional to the length of the name, " \
+					"expressions it does not support are matched by the standard engine.\", " \
+				"\"type\" : \"enumeration\", " \
+				"\"options\" : [ \"Standard\", \"Linear\" ], " \
+				"\"default\" : \"Standard\", " \
+				"\"order\" : \"2\", \"displayName\" : \"Regular Expression Engine\"}, " \
+			"\"waitForRules\" : {\"description\" : \"Wait for the new rules to be compiled when the filter is reconfigured. " \
+					"Otherwise the rules are compiled in the background and the previous rules are used until they are ready.\", " \
+				"\"type\" : \"boolean\", " \
+				"\"default\" : \"false\", " \
+				"\"order\" : \"3\", \"displayName\" : \"Wait For New Rules\"}, " \
+			"\"workerThreads\" : {\"description\" : \"The number of threads that process a large set of readings. " \
+					"With a single thread all readings are processed by the thread that delivers them to the filter.\", " \
+				"\"type\" : \"integer\", " \
+				"\"default\" : \"1\", \"minimum\" : \"1\", \"maximum\" : \"64\", " \
+				"\"order\" : \"4\", \"displayName\" : \"Worker Threads\"}, " \
+			"\"parallelBatchSize\" : {\"description\" : \"The smallest set of readings that is divided between the worker threads.\", " \
+				"\"type\" : \"integer\", " \
+				"\"default\" : \"1000\", \"minimum\" : \"2\", " \
+				"\"order\" : \"5\", \"displayName\" : \"Parallel Batch Size\"}, " \
+			"\"pipelineStages\" : {\"description\" : \"The number of stages, each run by a thread of its own, that the rules are divided into. " \
+					"Each set of readings is divided into chunks that pass from one stage to the next so that several chunks are processed at once. " \
+					"With a single stage all the rules are run by the thread that delivers the readings.\", " \
+				"\"type\" : \"integer\", " \
+				"\"default\" : \"1\", \"minimum\" : \"1\", \"maximum\" : \"16\", " \
+				"\"order\" : \"6\", \"displayName\" : \"Pipeline Stages\"} }"
 
 using namespace std;
 
@@ -100,18 +127,10 @@ void plugin_ingest(PLUGIN_HANDLE *handle,
 		   READINGSET *readingSet)
 {
 	AssetFilter *filter = (AssetFilter *)handle;
-	
-	if (!filter->isEnabled())
-	{
-		// Current filter is not active: just pass the readings set
-		filter->m_func(filter->m_data, readingSet);
-		return;
-	}
-
-	vector<Reading *> newReadings;
-	filter->ingest(readingSet, newReadings);
-	ReadingSet *newReadingSet = new ReadingSet(&newReadings);	
-	filter->m_func(filter->m_data, newReadingSet);
+
+	// The results are passed on by the filter, which passes the
+	// readings on unchanged if it is not enabled
+	filter->ingest(readingSet);
 }
 
 /**
@@ -0,0 +1,667 @@
+/*
+ * Fledge "asset" filter plugin regular expression automaton.
+ *
+ * Copyright (c) 2025 Dianomic Systems
+ *
+ * Released under the Apache 2.0 Licence
+ *
+ * Author: Mark Riddoch
+ */
+#include <regex_automaton.h>
+#include <cstdlib>
+
+using namespace std;
+
+/**
+ * The limits on the size of the expressions we will compile. Expressions
+ * that exceed these are left for std::regex to handle.
+ */
+#define MAX_REPEAT	1000
+#define MAX_NFA_STATES	20000
+
+/**
+ * Constructor for a node in the regular expression parse tree
+ *
+ * @param type	The type of the node
+ */
+RegexNode::RegexNode(NodeType type) : m_type(type), m_min(1), m_max(1),
+	m_greedy(true), m_group(0)
+{
+}
+
+/**
+ * Destructor for a parse tree node, deletes the subtree
+ */
+RegexNode::~RegexNode()
+{
+	for (auto& child : m_children)
+		delete child;
+}
+
+/**
+ * Check if the subtree can match the empty string
+ *
+ * @return bool	True if the subtree can match without consuming a character
+ */
+bool RegexNode::nullable() const
+{
+	switch (m_type)
+	{
+		case CHARS:
+			return false;
+		case CONCAT:
+			for (auto& child : m_children)
+				if (!child->nullable())
+					return false;
+			return true;
+		case ALTERNATE:
+			for (auto& child : m_children)
+				if (child->nullable())
+					return true;
+			return false;
+		case REPEAT:
+			return m_min == 0 || m_children[0]->nullable();
+		case GROUP:
+			return m_children[0]->nullable();
+		default:
+			return true;
+	}
+}
+
+/**
+ * Check if the subtree contains a repetition of an expression that can
+ * match the empty string, such as (a*)+ or (.*?)*. ECMAScript rejects an
+ * iteration that matches the empty string and resets the capture groups
+ * of the body on each iteration. The automaton does neither, so it may
+ * choose different capture groups and match extents for these
+ * expressions.
+ *
+ * @return bool	True if the subtree repeats a nullable expression
+ */
+bool RegexNode::repeatsEmpty() const
+{
+	if (m_type == REPEAT && m_children[0]->nullable())
+		return true;
+	for (auto& child : m_children)
+		if (child->repeatsEmpty())
+			return true;
+	return false;
+}
+
+/**
+ * Add the other case of every ASCII letter in a character set
+ *
+ * @param chars	The character set
+ */
+static void closeCase(CharSet& chars)
+{
+	for (int c = 'a'; c <= 'z'; c++)
+	{
+		if (chars.test(c) || chars.test(c - 'a' + 'A'))
+		{
+			chars.set(c);
+			chars.set(c - 'a' + 'A');
+		}
+	}
+}
+
+/**
+ * Constructor for the regular expression parser
+ *
+ * @param pattern	The regular expression to parse
+ * @param ignoreCase	Ignore the case of ASCII letters
+ */
+RegexParser::RegexParser(const string& pattern, bool ignoreCase) : m_pattern(pattern),
+	m_pos(0), m_groups(0), m_error(false), m_ignoreCase(ignoreCase)
+{
+}
+
+/**
+ * Destructor for the regular expression parser
+ */
+RegexParser::~RegexParser()
+{
+}
+
+/**
+ * Parse the regular expression
+ *
+ * @return RegexNode*	The parse tree, owned by the caller, or NULL
+ *			if the expression uses unsupported syntax
+ */
+RegexNode *RegexParser::parse()
+{
+	m_pos = 0;
+	m_groups = 0;
+	m_error = false;
+	RegexNode *node = parseAlternate();
+	if (m_error || !atEnd())
+	{
+		delete node;
+		return NULL;
+	}
+	return node;
+}
+
+/**
+ * Parse a set of alternatives separated by the | character
+ */
+RegexNode *RegexParser::parseAlternate()
+{
+	RegexNode *first = parseConcat();
+	if (m_error || atEnd() || peek() != '|')
+		return first;
+
+	RegexNode *node = new RegexNode(RegexNode::ALTERNATE);
+	node->m_children.push_back(first);
+	while (!m_error && !atEnd() && peek() == '|')
+	{
+		m_pos++;
+		node->m_children.push_back(parseConcat());
+	}
+	return node;
+}
+
+/**
+ * Parse a sequence of, possibly repeated, atoms
+ */
+RegexNode *RegexParser::parseConcat()
+{
+	RegexNode *node = new RegexNode(RegexNode::CONCAT);
+	while (!m_error && !atEnd() && peek() != '|' && peek() != ')')
+	{
+		RegexNode *atom = parseRepeat();
+		if (atom)
+			node->m_children.push_back(atom);
+	}
+	return node;
+}
+
+/**
+ * Parse an atom followed by an optional quantifier
+ */
+RegexNode *RegexParser::parseRepeat()
+{
+	RegexNode *atom = parseAtom();
+	if (m_error || atEnd())
+		return atom;
+
+	int min, max;
+	char c = peek();
+	if (c == '*')
+	{
+		min = 0; max = -1; m_pos++;
+	}
+	else if (c == '+')
+	{
+		min = 1; max = -1; m_pos++;
+	}
+	else if (c == '?')
+	{
+		min = 0; max = 1; m_pos++;
+	}
+	else if (c == '{')
+	{
+		if (!parseBounds(min, max))
+		{
+			m_error = true;
+			return atom;
+		}
+	}
+	else
+	{
+		return atom;
+	}
+	if (atom->m_type == RegexNode::LINE_START || atom->m_type == RegexNode::LINE_END)
+	{
+		m_error = true;
+		return atom;
+	}
+	RegexNode *node = new RegexNode(RegexNode::REPEAT);
+	node->m_children.push_back(atom);
+	node->m_min = min;
+	node->m_max = max;
+	if (!atEnd() && peek() == '?')
+	{
+		node->m_greedy = false;
+		m_pos++;
+	}
+	if (!atEnd() && (peek() == '*' || peek() == '+' || peek() == '?' || peek() == '{'))
+	{
+		m_error = true;
+	}
+	return node;
+}
+
+/**
+ * Parse the bounds of a {n}, {n,} or {n,m} quantifier
+ *
+ * @param min	The minimum number of repeats
+ * @param max	The maximum number of repeats, -1 if unbounded
+ * @return bool	True if the bounds are valid
+ */
+bool RegexParser::parseBounds(int& min, int& max)
+{
+	size_t end = m_pattern.find('}', m_pos);
+	if (end == string::npos)
+		return false;
+	string bounds = m_pattern.substr(m_pos + 1, end - m_pos - 1);
+	size_t comma = bounds.find(',');
+	string lower = bounds.substr(0, comma);
+	string upper = comma == string::npos ? lower : bounds.substr(comma + 1);
+	if (lower.empty() || lower.find_first_not_of("0123456789") != string::npos
+			|| upper.find_first_not_of("0123456789") != string::npos
+			|| lower.length() > 4 || upper.length() > 4)
+		return false;
+	min = atoi(lower.c_str());
+	max = upper.empty() ? -1 : atoi(upper.c_str());
+	if (max != -1 && max < min)
+		return false;
+	if (min > MAX_REPEAT || max > MAX_REPEAT)
+		return false;
+	m_pos = end + 1;
+	return true;
+}
+
+/**
+ * Parse a single atom; a literal, escape, class, group or anchor
+ */
+RegexNode *RegexParser::parseAtom()
+{
+	char c = peek();
+	RegexNode *node;
+	switch (c)
+	{
+		case '(':
+			m_pos++;
+			node = new RegexNode(RegexNode::GROUP);
+			if (!atEnd() && peek() == '?')
+			{
+				// Only the non-capturing group is supported
+				if (m_pos + 1 < m_pattern.length() && m_pattern[m_pos + 1] == ':')
+				{
+					m_pos += 2;
+				}
+				else
+				{
+					m_error = true;
+					return node;
+				}
+			}
+			else
+			{
+				node->m_group = ++m_groups;
+			}
+			node->m_children.push_back(parseAlternate());
+			if (m_error || atEnd() || peek() != ')')
+			{
+				m_error = true;
+				return node;
+			}
+			m_pos++;
+			return node;
+		case '[':
+			m_pos++;
+			node = new RegexNode(RegexNode::CHARS);
+			if (!parseClass(node->m_chars))
+				m_error = true;
+			return node;
+		case '.':
+			m_pos++;
+			node = new RegexNode(RegexNode::CHARS);
+			node->m_chars.set();
+			node->m_chars.reset('\n');
+			node->m_chars.reset('\r');
+			return node;
+		case '^':
+			m_pos++;
+			return new RegexNode(RegexNode::LINE_START);
+		case '$':
+			m_pos++;
+			return new RegexNode(RegexNode::LINE_END);
+		case '\\':
+		{
+			m_pos++;
+			node = new RegexNode(RegexNode::CHARS);
+			bool single;
+			if (!parseEscape(node->m_chars, single))
+				m_error = true;
+			if (m_ignoreCase)
+				closeCase(node->m_chars);
+			return node;
+		}
+		case '*':
+		case '+':
+		case '?':
+		case '{':
+		case '}':
+		case ']':
+		case ')':
+			m_error = true;
+			return NULL;
+		default:
+			m_pos++;
+			node = new RegexNode(RegexNode::CHARS);
+			node->m_chars.set((unsigned char)c);
+			if (m_ignoreCase)
+				closeCase(node->m_chars);
+			return node;
+	}
+}
+
+/**
+ * Parse a character class, the opening [ has already been consumed
+ *
+ * @param chars	The set of characters to populate
+ * @return bool	True if the class is supported
+ */
+bool RegexParser::parseClass(CharSet& chars)
+{
+	bool negate = false;
+	if (!atEnd() && peek() == '^')
+	{
+		negate = true;
+		m_pos++;
+	}
+	if (!atEnd() && peek() == ']')
+		return false;
+	while (!atEnd() && peek() != ']')
+	{
+		CharSet item;
+		bool single = true;
+		unsigned char low = peek();
+		if (low == '\\')
+		{
+			m_pos++;
+			if (!atEnd() && (peek() == 'b' || peek() == 'B'))
+				return false;
+			if (!parseEscape(item, single))
+				return false;
+			if (single)
+				for (low = 0; !item.test(low); low++);
+		}
+		else if (low == '[' && m_pos + 1 < m_pattern.length()
+				&& (m_pattern[m_pos + 1] == ':' || m_pattern[m_pos + 1] == '.' || m_pattern[m_pos + 1] == '='))
+		{
+			return false;
+		}
+		else
+		{
+			m_pos++;
+			item.set(low);
+		}
+		if (single && m_pos + 1 < m_pattern.length() && peek() == '-' && m_pattern[m_pos + 1] != ']')
+		{
+			m_pos++;
+			unsigned char high = peek();
+			if (high == '\\' || high == '[' || high >= 0x80 || low >= 0x80 || high < low)
+				return false;
+			m_pos++;
+			for (unsigned int i = low; i <= high; i++)
+				item.set(i);
+		}
+		chars |= item;
+	}
+	if (atEnd())
+		return false;
+	m_pos++;
+	if (m_ignoreCase)
+		closeCase(chars);
+	if (negate)
+		chars.flip();
+	return true;
+}
+
+/**
+ * Parse an escape sequence, the \ has already been consumed
+ *
+ * @param chars		The set of characters to populate
+ * @param single	Set true if the escape is a single character
+ * @return bool		True if the escape is supported
+ */
+bool RegexParser::parseEscape(CharSet& chars, bool& single)
+{
+	if (atEnd())
+		return false;
+	unsigned char c = peek();
+	m_pos++;
+	single = false;
+	switch (c)
+	{
+		case 'd':
+		case 'D':
+			for (unsigned int i = '0'; i <= '9'; i++)
+				chars.set(i);
+			break;
+		case 'w':
+		case 'W':
+			for (unsigned int i = 0; i < 256; i++)
+				if (isalnum(i) || i == '_')
+					chars.set(i);
+			break;
+		case 's':
+		case 'S':
+			chars.set(' '); chars.set('\t'); chars.set('\n');
+			chars.set('\v'); chars.set('\f'); chars.set('\r');
+			break;
+		case 't': chars.set('\t'); single = true; return true;
+		case 'n': chars.set('\n'); single = true; return true;
+		case 'r': chars.set('\r'); single = true; return true;
+		case 'f': chars.set('\f'); single = true; return true;
+		case 'v': chars.set('\v'); single = true; return true;
+		default:
+			// Back references, word boundaries, hex, unicode and
+			// control escapes are not supported
+			if (isalnum(c))
+				return false;
+			chars.set(c);
+			single = true;
+			return true;
+	}
+	if (isupper(c))
+		chars.flip();
+	return true;
+}
+
+/**
+ * Constructor for an empty NFA
+ */
+RegexNFA::RegexNFA() : m_tooLarge(false)
+{
+}
+
+/**
+ * Destructor for the NFA
+ */
+RegexNFA::~RegexNFA()
+{
+}
+
+/**
+ * Compile a regular expression parse tree into the NFA
+ *
+ * @param node	The parse tree of the expression
+ * @param id	The identifier reported when the expression matches
+ * @return int	The start state for the expression
+ */
+int RegexNFA::compile(RegexNode *node, int id)
+{
+	int match = add(MATCH, -1, -1, id);
+	return emit(node, match);
+}
+
+/**
+ * Add a split state that will try the first state before the second
+ *
+ * @param first		The preferred state
+ * @param second	The alternative state
+ * @return int		The split state
+ */
+int RegexNFA::split(int first, int second)
+{
+	return add(SPLIT, first, second, 0);
+}
+
+/**
+ * Add a new state to the NFA
+ */
+int RegexNFA::add(StateType type, int out, int out1, int arg)
+{
+	if (m_states.size() >= MAX_NFA_STATES)
+		m_tooLarge = true;
+	State state;
+	state.m_type = type;
+	state.m_out = out;
+	state.m_out1 = out1;
+	state.m_arg = arg;
+	m_states.push_back(state);
+	return m_states.size() - 1;
+}
+
+/**
+ * Emit the states for a parse tree node. The states are emitted
+ * back to front, each node is given the state that follows it.
+ *
+ * @param node	The parse tree node
+ * @param next	The state to move to once the node has matched
+ * @return int	The first state of the node
+ */
+int RegexNFA::emit(RegexNode *node, int next)
+{
+	if (m_tooLarge)
+		return next;
+	switch (node->m_type)
+	{
+		case RegexNode::EMPTY:
+			return next;
+		case RegexNode::CHARS:
+			m_charSets.push_back(node->m_chars);
+			return add(CHARS, next, -1, m_charSets.size() - 1);
+		case RegexNode::CONCAT:
+			for (auto it = node->m_children.rbegin(); it != node->m_children.rend(); ++it)
+				next = emit(*it, next);
+			return next;
+		case RegexNode::ALTERNATE:
+		{
+			vector<int> entries;
+			for (auto& child : node->m_children)
+				entries.push_back(emit(child, next));
+			int state = entries.back();
+			for (int i = entries.size() - 2; i >= 0; i--)
+				state = split(entries[i], state);
+			return state;
+		}
+		case RegexNode::GROUP:
+		{
+			if (node->m_group == 0)
+				return emit(node->m_children[0], next);
+			int close = add(SAVE, next, -1, 2 * node->m_group + 1);
+			int body = emit(node->m_children[0], close);
+			return add(SAVE, body, -1, 2 * node->m_group);
+		}
+		case RegexNode::REPEAT:
+		{
+			RegexNode *child = node->m_children[0];
+			int state = next;
+			if (node->m_max < 0)
+			{
+				int loop = add(SPLIT, -1, -1, 0);
+				int body = emit(child, loop);
+				m_states[loop].m_out = node->m_greedy ? body : next;
+				m_states[loop].m_out1 = node->m_greedy ? next : body;
+				state = loop;
+			}
+			else
+			{
+				for (int i = node->m_min; i < node->m_max && !m_tooLarge; i++)
+				{
+					int body = emit(child, state);
+					state = node->m_greedy ? split(body, next) : split(next, body);
+				}
+			}
+			for (int i = 0; i < node->m_min && !m_tooLarge; i++)
+				state = emit(child, state);
+			return state;
+		}
+		case RegexNode::LINE_START:
+			return add(LINE_START, next, -1, 0);
+		case RegexNode::LINE_END:
+			return add(LINE_END, next, -1, 0);
+	}
+	return next;
+}
+
+/**
+ * Compute the epsilon closure of a set of states. The states in the
+ * set on return are those that consume a character, the match states
+ * and any anchors that could not be passed. The states are returned
+ * in priority order.
+ *
+ * @param states	The set of states to expand, replaced by the closure
+ * @param marks		A scratch vector, one entry per state, all zero
+ * @param atStart	True if we are at the start of the string
+ * @param atEnd		True if we are at the end of the string
+ */
+void RegexNFA::closure(vector<int>& states, vector<char>& marks, bool atStart, bool atEnd) const
+{
+	vector<int> stack(states.rbegin(), states.rend());
+	vector<int> visited;
+	states.clear();
+	while (!stack.empty())
+	{
+		int s = stack.back();
+		stack.pop_back();
+		if (s < 0 || marks[s])
+			continue;
+		marks[s] = 1;
+		visited.push_back(s);
+		const State& state = m_states[s];
+		switch (state.m_type)
+		{
+			case SPLIT:
+				stack.push_back(state.m_out1);
+				stack.push_back(state.m_out);
+				break;
+			case JUMP:
+			case SAVE:
+				stack.push_back(state.m_out);
+				break;
+			case LINE_START:
+				if (atStart)
+					stack.push_back(state.m_out);
+				else
+					states.push_back(s);
+				break;
+			case LINE_END:
+				if (atEnd)
+					stack.push_back(state.m_out);
+				else
+					states.push_back(s);
+				break;
+			default:
+				states.push_back(s);
+				break;
+		}
+	}
+	for (int s : visited)
+		marks[s] = 0;
+}
+
+/**
+ * Advance a set of states over a single character. The result
+ * is not closed.
+ *
+ * @param states	The current set of states
+ * @param c		The character to consume
+ * @param next		The states reached after consuming the character
+ */
+void RegexNFA::step(const vector<int>& states, unsigned char c, vector<int>& next) const
+{
+	next.clear();
+	for (int s : states)
+	{
+		const State& state = m_states[s];
+		if (state.m_type == CHARS && m_charSets[state.m_arg].test(c))
+			next.push_back(state.m_out);
+	}
+}
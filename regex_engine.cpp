@@ -0,0 +1,370 @@
+/*
+ * Fledge "asset" filter plugin regular expressions.
+ *
+ * Copyright (c) 2025 Dianomic Systems
+ *
+ * Released under the Apache 2.0 Licence
+ *
+ * Author: Mark Riddoch
+ */
+#include <regex_engine.h>
+#include <logger.h>
+#include <case_fold.h>
+#include <cctype>
+
+using namespace std;
+
+/**
+ * Construct a regular expression
+ *
+ * @param pattern	The regular expression
+ * @param engine	The engine to use to match the expression
+ * @param ignoreCase	Ignore the case of ASCII letters
+ * @throws regex_error	The expression is not valid
+ */
+Regex::Regex(const string& pattern, RegexEngine engine, bool ignoreCase) : m_regex(NULL),
+	m_start(-1), m_groups(0), m_folded(false)
+{
+	if (engine == LINEAR_REGEX)
+	{
+		// The standard library is the arbiter of what is a valid
+		// expression, this will throw if the expression is invalid
+		regex check(pattern, regex::ECMAScript);
+
+		RegexParser parser(pattern, ignoreCase);
+		RegexNode *tree = parser.parse();
+		if (tree && tree->repeatsEmpty())
+		{
+			// The standard library decides the capture groups of
+			// repeated empty matches differently from the automaton
+			delete tree;
+			tree = NULL;
+		}
+		if (tree)
+		{
+			m_groups = parser.groups();
+			m_start = m_nfa.compile(tree, 0);
+			delete tree;
+			if (!m_nfa.tooLarge() && m_set.add(pattern, 0, ignoreCase))
+			{
+				m_set.compile();
+				return;
+			}
+		}
+		Logger::getLogger()->debug("The regular expression '%s' is not supported by the linear engine, the standard engine will be used",
+				pattern.c_str());
+	}
+	if (ignoreCase && canFoldPattern(pattern))
+	{
+		// Match the folded expression against folded strings rather
+		// than using icase, which compares every character through
+		// the locale
+		m_regex = new regex(foldPattern(pattern), regex::ECMAScript);
+		m_groups = m_regex->mark_count();
+		m_folded = true;
+	}
+	else if (ignoreCase)
+	{
+		m_regex = new regex(pattern, regex::ECMAScript | regex::icase);
+	}
+	else
+	{
+		m_regex = new regex(pattern, regex::ECMAScript);
+	}
+}
+
+/**
+ * Destructor for the regular expression
+ */
+Regex::~Regex()
+{
+	if (m_regex)
+		delete m_regex;
+}
+
+/**
+ * Match the whole of a string against the regular expression
+ *
+ * @param str	The string to match
+ * @return bool	True if the expression matches the string
+ */
+bool Regex::match(const string& str) const
+{
+	if (m_folded)
+	{
+		string folded;
+		foldCase(str, folded);
+		return regex_match(folded, *m_regex);
+	}
+	if (m_regex)
+		return regex_match(str, *m_regex);
+	vector<unsigned int> ids;
+	m_set.match(str, ids);
+	return !ids.empty();
+}
+
+/**
+ * Replace every match of the expression within a string with the
+ * expansion of a format string. This has the same behaviour as
+ * std::regex_replace, including the handling of empty matches and
+ * the $n, $&, $`, $' and $$ escapes in the format.
+ *
+ * @param str		The string to search for matches
+ * @param format	The format used to replace each match
+ * @return string	The string with the matches replaced
+ */
+string Regex::replace(const string& str, const string& format) const
+{
+	if (m_folded)
+		return replaceFolded(str, format);
+	if (m_regex)
+		return regex_replace(str, *m_regex, format);
+
+	string result;
+	vector<int> captures;
+	size_t last = 0, pos = 0;
+	bool notNull = false;
+	while (pos <= str.length())
+	{
+		if (!search(str, pos, notNull, captures))
+		{
+			if (!notNull)
+				break;
+			// No non-empty match follows an empty match, move on
+			// by a character and search again
+			notNull = false;
+			pos++;
+			continue;
+		}
+		result.append(str, last, captures[0] - last);
+		this->format(result, format, str, last, captures);
+		last = captures[1];
+		pos = captures[1];
+		if (captures[0] == captures[1])
+		{
+			if (pos == str.length())
+				break;
+			notNull = true;
+		}
+		else
+		{
+			notNull = false;
+		}
+	}
+	result.append(str, last, string::npos);
+	return result;
+}
+
+/**
+ * Replace the matches of a folded standard library expression. The
+ * matches are found in the folded string, which has the same length
+ * as the original, and the original string is used to expand the
+ * format so that the case of the text that is kept is preserved.
+ *
+ * @param str		The string to search for matches
+ * @param format	The format used to replace each match
+ * @return string	The string with the matches replaced
+ */
+string Regex::replaceFolded(const string& str, const string& format) const
+{
+	string folded;
+	foldCase(str, folded);
+	string result;
+	vector<int> captures(2 * (m_groups + 1));
+	size_t last = 0;
+	for (sregex_iterator it(folded.begin(), folded.end(), *m_regex), end; it != end; ++it)
+	{
+		const smatch& match = *it;
+		for (int group = 0; group <= m_groups; group++)
+		{
+			bool matched = match[group].matched;
+			captures[2 * group] = matched ? match.position(group) : -1;
+			captures[2 * group + 1] = matched ? match.position(group) + match.length(group) : -1;
+		}
+		result.append(str, last, captures[0] - last);
+		this->format(result, format, str, last, captures);
+		last = captures[1];
+	}
+	result.append(str, last, string::npos);
+	return result;
+}
+
+/**
+ * Search for the first match of the expression in a string using a
+ * Pike VM. The threads are held in priority order, once a thread has
+ * matched all the lower priority threads are discarded. This gives the
+ * same match and capture groups as a backtracking search.
+ *
+ * @param str		The string to search
+ * @param from		The position to start the search
+ * @param notNull	Only accept a non-empty match starting at from
+ * @param captures	Populated with the capture group positions
+ * @return bool		True if a match was found
+ */
+bool Regex::search(const string& str, size_t from, bool notNull, vector<int>& captures) const
+{
+	vector<int> current, next;
+	vector<vector<int> > currentCaps, nextCaps;
+	vector<unsigned int> marks(m_nfa.size(), 0);
+	unsigned int generation = 1;
+	vector<int> initial(2 * (m_groups + 1), -1);
+	bool matched = false;
+
+	for (size_t pos = from; pos <= str.length(); pos++)
+	{
+		if (!matched && (pos == from || !notNull))
+		{
+			// Start a new, lowest priority, thread at this position
+			initial[0] = pos;
+			addThread(current, currentCaps, marks, generation, m_start, initial, str, pos);
+		}
+		generation++;
+		for (unsigned int i = 0; i < current.size(); i++)
+		{
+			const RegexNFA::State& state = m_nfa.state(current[i]);
+			if (state.m_type == RegexNFA::MATCH)
+			{
+				if (notNull && currentCaps[i][0] == (int)pos)
+					continue;
+				captures = currentCaps[i];
+				captures[1] = pos;
+				matched = true;
+				break;
+			}
+			if (pos < str.length() && m_nfa.chars(current[i]).test((unsigned char)str[pos]))
+			{
+				addThread(next, nextCaps, marks, generation, state.m_out,
+						currentCaps[i], str, pos + 1);
+			}
+		}
+		current.swap(next);
+		currentCaps.swap(nextCaps);
+		next.clear();
+		nextCaps.clear();
+		if (current.empty() && (matched || notNull))
+			break;
+	}
+	return matched;
+}
+
+/**
+ * Add a thread to a thread list, following all the transitions that
+ * do not consume a character. The threads are added in priority order.
+ *
+ * @param threads	The states of the threads in the list
+ * @param captures	The capture groups of the threads in the list
+ * @param marks		The generation in which each state was last added
+ * @param generation	The generation of the thread list
+ * @param state		The state of the new thread
+ * @param caps		The capture groups of the new thread
+ * @param str		The string being searched
+ * @param pos		The position in the string of the thread list
+ */
+void Regex::addThread(vector<int>& threads, vector<vector<int> >& captures,
+		vector<unsigned int>& marks, unsigned int generation,
+		int state, const vector<int>& caps, const string& str, size_t pos) const
+{
+	vector<pair<int, vector<int> > > stack;
+	stack.push_back(make_pair(state, caps));
+	while (!stack.empty())
+	{
+		int s = stack.back().first;
+		vector<int> c;
+		c.swap(stack.back().second);
+		stack.pop_back();
+		if (s < 0 || marks[s] == generation)
+			continue;
+		marks[s] = generation;
+		const RegexNFA::State& st = m_nfa.state(s);
+		switch (st.m_type)
+		{
+			case RegexNFA::SPLIT:
+				stack.push_back(make_pair(st.m_out1, c));
+				stack.push_back(make_pair(st.m_out, c));
+				break;
+			case RegexNFA::JUMP:
+				stack.push_back(make_pair(st.m_out, c));
+				break;
+			case RegexNFA::SAVE:
+				c[st.m_arg] = pos;
+				stack.push_back(make_pair(st.m_out, c));
+				break;
+			case RegexNFA::LINE_START:
+				if (pos == 0)
+					stack.push_back(make_pair(st.m_out, c));
+				break;
+			case RegexNFA::LINE_END:
+				if (pos == str.length())
+					stack.push_back(make_pair(st.m_out, c));
+				break;
+			default:
+				threads.push_back(s);
+				captures.push_back(c);
+				break;
+		}
+	}
+}
+
+/**
+ * Append the expansion of a format string for a match to the result
+ *
+ * @param result	The string to append to
+ * @param format	The format string
+ * @param str		The string that was searched
+ * @param prefix	The start of the text between the previous match and this one
+ * @param captures	The capture groups of the match
+ */
+void Regex::format(string& result, const string& format, const string& str,
+		size_t prefix, const vector<int>& captures) const
+{
+	size_t i = 0;
+	while (i < format.length())
+	{
+		size_t dollar = format.find('$', i);
+		if (dollar == string::npos)
+			break;
+		result.append(format, i, dollar - i);
+		i = dollar + 1;
+		if (i == format.length())
+		{
+			result += '$';
+		}
+		else if (format[i] == '$')
+		{
+			result += '$';
+			i++;
+		}
+		else if (format[i] == '&')
+		{
+			result.append(str, captures[0], captures[1] - captures[0]);
+			i++;
+		}
+		else if (format[i] == '`')
+		{
+			result.append(str, prefix, captures[0] - prefix);
+			i++;
+		}
+		else if (format[i] == '\'')
+		{
+			result.append(str, captures[1], string::npos);
+			i++;
+		}
+		else if (isdigit(format[i]))
+		{
+			int group = format[i++] - '0';
+			if (i < format.length() && isdigit(format[i]))
+				group = group * 10 + (format[i++] - '0');
+			if (group <= m_groups && captures[2 * group] >= 0 && captures[2 * group + 1] >= 0)
+			{
+				result.append(str, captures[2 * group],
+						captures[2 * group + 1] - captures[2 * group]);
+			}
+		}
+		else
+		{
+			result += '$';
+		}
+	}
+	if (i < format.length())
+		result.append(format, i, string::npos);
+}
@@ -21,36 +21,50 @@ static const    set<string> validDpTypes{"FLOAT", "INTEGER", "STRING", "FLOAT_AR
  *
  * @param asset	The asset name
  * @param json	JSON object
+ * @param engine	The regular expression engine to use
  */
-RemoveRule::RemoveRule(const string& service, const string& asset, const rapidjson::Value& json) :
-	Rule(service, asset), m_regex(NULL)
+RemoveRule::RemoveRule(const string& service, const string& asset, const rapidjson::Value& json,
+		RegexEngine engine) :
+	Rule(service, asset, json, engine)
 {
+	m_choice.m_caseInsensitive = m_caseInsensitive;
 	if (json.HasMember("datapoint") && json["datapoint"].IsString())
 	{
 		string datapoint = json["datapoint"].GetString();
 		if (isRegexString(datapoint))
-			m_regex = new regex(datapoint);
-		else
-			m_datapoint = datapoint;
+		{
+			m_choice.m_regex = new Regex(datapoint, m_engine, m_caseInsensitive);
+			m_choice.m_mode = DatapointChoice::REGEX;
+		}
+		else if (!datapoint.empty())
+		{
+			m_choice.m_name = foldName(datapoint);
+			m_choice.m_mode = DatapointChoice::NAME;
+		}
 	}
 	else if (json.HasMember("type") && json["type"].IsString())
 	{
-		m_type = json["type"].GetString();
-		transform(m_type.begin(), m_type.end(), m_type.begin(), ::toupper);
-		if (m_type == "FLOATING")
-			m_type = "FLOAT";
-		if (m_type == "BUFFER")
-			m_type = "DATABUFFER";
-		if (m_type == "NESTED")
-			m_type = "DP_DICT";
-		if (m_type == "2D_ARRAY")
-			m_type = "2D_FLOAT_ARRAY";
-		if (m_type == "ARRAY")
-			m_type = "FLOAT_ARRAY";
+		string type = json["type"].GetString();
+		transform(type.begin(), type.end(), type.begin(), ::toupper);
+		if (type == "FLOATING")
+			type = "FLOAT";
+		if (type == "BUFFER")
+			type = "DATABUFFER";
+		if (type == "NESTED")
+			type = "DP_DICT";
+		if (type == "2D_ARRAY")
+			type = "2D_FLOAT_ARRAY";
+		if (type == "ARRAY")
+			type = "FLOAT_ARRAY";
 
-		if (!validateType(m_type))
+		if (!validateType(type))
 		{
-			m_logger->warn("Invalid Datapoint type %s given in rule for asset '%s'. The rule will have no impact.", m_type.c_str(), m_asset.c_str());
+			m_logger->warn("Invalid Datapoint type %s given in rule for asset '%s'. The rule will have no impact.", type.c_str(), m_asset.c_str());
+		}
+		if (!type.empty())
+		{
+			m_choice.m_name = type;
+			m_choice.m_mode = DatapointChoice::typeMode(type);
 		}
 	}
 	else if (json.HasMember("datapoints") && json["datapoints"].IsArray())
@@ -59,7 +73,13 @@ RemoveRule::RemoveRule(const string& service, const string& asset, const rapidjs
 		for (auto& dp : dps.GetArray())
 		{
 			if (dp.IsString())
-				m_datapoints.push_back(dp.GetString());
+			{
+				string name = dp.GetString();
+				if (isRegexString(name))
+					m_choice.m_regexes.push_back(new Regex(name, m_engine, m_caseInsensitive));
+				else
+					m_choice.m_names.push_back(foldName(name));
+			}
 			else
 				m_logger->error("The datapoints in the array of names for the asset '%s' must all be strings.", m_asset.c_str());
 		}
@@ -69,6 +89,9 @@ RemoveRule::RemoveRule(const string& service, const string& asset, const rapidjs
 		m_logger->error("Badly defined remove rule for asset '%s'. A 'datapoint', 'type' or 'datapoints' property must be given. The 'datapoint' and 'type' properties must be strings and 'datapopints' is expected to be an array of strings.", m_asset.c_str());
 
 	}
+
+	if (!m_choice.m_names.empty() || !m_choice.m_regexes.empty())
+		m_choice.m_mode = DatapointChoice::NAMES;
 }
 
 /**
@@ -76,8 +99,9 @@ RemoveRule::RemoveRule(const string& service, const string& asset, const rapidjs
  */
 RemoveRule::~RemoveRule()
 {
-	if (m_regex)
-		delete m_regex;
+	delete m_choice.m_regex;
+	for (auto& re : m_choice.m_regexes)
+		delete re;
 }
 
 /**
@@ -88,116 +112,44 @@ RemoveRule::~RemoveRule()
  */
 void RemoveRule::execute(Reading *reading, vector<Reading *>& out)
 {
-	vector<Datapoint *>& dps = reading->getReadingData();
-	for (auto it = dps.begin(); it != dps.end(); )
+	m_choice.remove<false>(reading, NULL);
+	track(reading->getAssetName());
+	out.emplace_back(reading);
+}
+
+/**
+ * Execute the remove rule with a column plan, if given, and
+ * optionally defer the removal of the datapoints. With a column
+ * plan the datapoints to remove are only chosen when the schema
+ * changes.
+ *
+ * @param reading	The reading to process
+ * @param out		The vector in which to place the result
+ * @param plan		The column plan for the rule or NULL
+ * @param removed	The list of removed datapoints or NULL to delete them
+ */
+void RemoveRule::execute(Reading *reading, vector<Reading *>& out, ColumnPlan *plan,
+		vector<Datapoint *> *removed)
+{
+	if (!plan)
 	{
-		Datapoint *dp = *it;
-		const DatapointValue dpv = dp->getData();
-		string dpvStr = dpv.getTypeStr();
-		if (!m_datapoint.empty())
-		{
-			if (m_datapoint.compare(dp->getName()) == 0)
-			{
-				it = dps.erase(it);
-				m_logger->debug("Removing datapoint with name %s", dp->getName().c_str());
-				delete dp;
-			}
-			else
-				++it;
-		}
-		else if (m_regex)
-		{
-			if (regex_match(dp->getName(), *m_regex))
-			{
-				it = dps.erase(it);
-				m_logger->debug("Removing datapoint with name %s", dp->getName().c_str());
-				delete dp;
-			}
-			else
-				++it;
-		}
-		else if (!m_type.empty())
-		{
-			const DatapointValue dpv = dp->getData();
-			string dpvStr = dpv.getTypeStr();
-			if (dpvStr == m_type)
-			{
-				it = dps.erase(it);
-				m_logger->debug("Removing datapoint with type %s", m_type.c_str());
-				delete dp;
-			}
-			else if (m_type == "NUMBER")
-			{
-				if (dpvStr == "FLOAT" || dpvStr == "INTEGER")
-				{
-					it = dps.erase(it);
-					delete dp;
-					m_logger->debug("Removing datapoint with type %s", dpvStr.c_str());
-				}
-				else 
-					++it;
-			}
-			else if (m_type == "NON-NUMERIC")
-			{
-				if (dpvStr != "FLOAT" && dpvStr != "INTEGER")
-				{
-					it = dps.erase(it);
-					m_logger->debug("Removing datapoint with type %s", dpvStr.c_str());
-					delete dp;
-				}
-				else
-					++it;
-			}
-			else if (m_type == "USER_ARRAY")
-			{
-				if (dpvStr == "FLOAT_ARRAY" || dpvStr == "2D_FLOAT_ARRAY" )
-				{
-					it = dps.erase(it);
-					m_logger->debug("Removing datapoint with type %s", dpvStr.c_str());
-					delete dp;
-				}
-				else
-					++it;
-			}
-			else
-				++it;
-		}
-		else if (!m_datapoints.empty())
+		m_choice.remove<false>(reading, removed);
+	}
+	else
+	{
+		vector<Datapoint *>& dps = reading->getReadingData();
+		if (!plan->sameSchema(dps))
 		{
-			bool removed = false;
-			for (auto& name : m_datapoints)
-			{
-				if (isRegexString(name))
-				{
-					regex regexPattern(name);
-					if (regex_match(dp->getName(), regexPattern))
-					{
-						it = dps.erase(it);
-						m_logger->debug("Removing datapoint with name %s", dp->getName().c_str());
-						delete dp;
-						removed = true;
-					}
-				}
-				else if (name.compare(dp->getName()) == 0)
-				{
-					it = dps.erase(it);
-					m_logger->debug("Removing datapoint with name %s", dp->getName().c_str());
-					delete dp;
-					removed = true;
-				}
-			}
-			if (!removed)
+			plan->reset(dps.size());
+			for (unsigned int i = 0; i < dps.size(); i++)
 			{
-				++it;
+				if (dps[i] && m_choice.chooses(dps[i]))
+					plan->remove(i);
 			}
 		}
-		else
-			++it;
-	}
-	if (m_tracker)
-	{
-		m_tracker->addAssetTrackingTuple(m_service, reading->getAssetName(), string("Filter"));
+		plan->apply(reading, removed);
 	}
+	track(reading->getAssetName());
 	out.emplace_back(reading);
 }
 
@@ -0,0 +1,180 @@
+/*
+ * Fledge "asset" filter plugin rule index.
+ *
+ * Copyright (c) 2025 Dianomic Systems
+ *
+ * Released under the Apache 2.0 Licence
+ *
+ * Author: Mark Riddoch
+ */
+#include <rule_index.h>
+#include <algorithm>
+
+using namespace std;
+
+/**
+ * Construct an empty rule index
+ */
+RuleIndex::RuleIndex() : m_anyName(true), m_ignoreCase(false)
+{
+}
+
+/**
+ * Destructor for the rule index. The index does not own the rules.
+ */
+RuleIndex::~RuleIndex()
+{
+}
+
+/**
+ * Build the index for a set of rules
+ *
+ * @param rules	The rules in the order they are executed
+ */
+void RuleIndex::build(const vector<Rule *>& rules)
+{
+	clear();
+	m_rules = rules;
+	for (unsigned int i = 0; i < rules.size(); i++)
+	{
+		const AssetMatcher *matcher = rules[i]->getMatcher();
+		bool ignoreCase = rules[i]->isCaseInsensitive();
+		if (ignoreCase)
+			m_ignoreCase = true;
+		auto& literals = ignoreCase ? m_foldedLiterals : m_literals;
+		if (rules[i]->isAssetSet())
+		{
+			for (auto& name : rules[i]->getAssetNames())
+				literals[name].push_back(i);
+		}
+		else if (rules[i]->isLiteral())
+		{
+			literals[rules[i]->getName()].push_back(i);
+		}
+		else if (rules[i]->isUnconditional())
+		{
+			m_unconditional.push_back(i);
+			if (!matcher->anyByte())
+				m_anyName = false;
+		}
+		else if (matcher && (matcher->kind() == AssetMatcher::LITERAL
+					|| matcher->kind() == AssetMatcher::SET))
+		{
+			// The expression matches a small set of names, index each
+			for (auto& name : matcher->literals())
+				literals[name].push_back(i);
+		}
+		else if (rules[i]->getGlob())
+		{
+			if (!m_patterns.add(rules[i]->getGlob()->toRegex(), i, ignoreCase))
+				m_fallback.push_back(i);
+		}
+		else if (!m_patterns.add(rules[i]->getName(), i, ignoreCase))
+		{
+			m_fallback.push_back(i);
+		}
+	}
+	m_patterns.compile();
+	if (!m_patterns.empty())
+	{
+		Logger::getLogger()->debug("%d asset name regular expressions compiled into an automaton of %d states, %d will be matched individually",
+				m_patterns.size(), m_patterns.dfaStates(), m_fallback.size());
+	}
+	if (!m_unconditional.empty())
+	{
+		Logger::getLogger()->debug("%d of %d rules apply to all assets",
+				m_unconditional.size(), m_rules.size());
+	}
+}
+
+/**
+ * Empty the index
+ */
+void RuleIndex::clear()
+{
+	m_rules.clear();
+	m_literals.clear();
+	m_foldedLiterals.clear();
+	m_patterns.clear();
+	m_fallback.clear();
+	m_unconditional.clear();
+	m_anyName = true;
+	m_ignoreCase = false;
+}
+
+/**
+ * Check if every rule matches an asset name without the need to
+ * match the name against the rules. This is the case when all the
+ * rules are unconditional.
+ *
+ * @param asset	The asset name
+ * @return bool	True if every rule matches the asset name
+ */
+bool RuleIndex::matchesAll(const string& asset) const
+{
+	if (m_rules.empty() || m_unconditional.size() != m_rules.size())
+		return false;
+	return m_anyName || asset.find_first_of("\n\r") == string::npos;
+}
+
+/**
+ * Find all of the rules that match an asset name. The rules
+ * with literal names are found with a single lookup, of the folded
+ * name for those rules that ignore case, the regular
+ * expression rules with a single pass of the automaton, the
+ * unconditional rules match all names and only the remaining
+ * rules are tried in turn. The lists are merged to
+ * give the positions of the matching rules in execution order.
+ *
+ * @param asset	The asset name to match
+ * @param rules	The vector to populate with the matching rule positions
+ */
+void RuleIndex::matches(const string& asset, vector<unsigned int>& rules) const
+{
+	static const vector<unsigned int> none;
+
+	auto it = m_literals.find(asset);
+	const vector<unsigned int> *literals = (it == m_literals.end()) ? &none : &it->second;
+
+	// The name is folded once for all the rules that ignore case
+	string folded;
+	if (m_ignoreCase)
+		foldCase(asset, folded);
+
+	vector<unsigned int> allLiterals;
+	if (!m_foldedLiterals.empty())
+	{
+		auto fit = m_foldedLiterals.find(folded);
+		if (fit != m_foldedLiterals.end())
+		{
+			merge(literals->begin(), literals->end(), fit->second.begin(), fit->second.end(),
+					back_inserter(allLiterals));
+			literals = &allLiterals;
+		}
+	}
+
+	if (m_patterns.empty() && m_fallback.empty() && m_unconditional.empty())
+	{
+		rules.insert(rules.end(), literals->begin(), literals->end());
+		return;
+	}
+
+	vector<unsigned int> patterns;
+	m_patterns.match(asset, patterns);
+	size_t matched = patterns.size();
+	for (unsigned int fallback : m_fallback)
+	{
+		if (m_rules[fallback]->match(asset, folded))
+			patterns.push_back(fallback);
+	}
+	inplace_merge(patterns.begin(), patterns.begin() + matched, patterns.end());
+	matched = patterns.size();
+	for (unsigned int all : m_unconditional)
+	{
+		if (m_anyName || m_rules[all]->match(asset, folded))
+			patterns.push_back(all);
+	}
+	inplace_merge(patterns.begin(), patterns.begin() + matched, patterns.end());
+	merge(literals->begin(), literals->end(), patterns.begin(), patterns.end(),
+			back_inserter(rules));
+}
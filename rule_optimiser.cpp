@@ -0,0 +1,329 @@
+/*
+ * Fledge "asset" filter plugin rule optimiser.
+ *
+ * Copyright (c) 2025 Dianomic Systems
+ *
+ * Released under the Apache 2.0 Licence
+ *
+ * Author: Mark Riddoch
+ */
+#include <rule_optimiser.h>
+#include <typeinfo>
+
+using namespace std;
+
+/**
+ * Construct the rule optimiser
+ */
+RuleOptimiser::RuleOptimiser()
+{
+	m_logger = Logger::getLogger();
+}
+
+/**
+ * Destructor for the rule optimiser
+ */
+RuleOptimiser::~RuleOptimiser()
+{
+}
+
+/**
+ * Optimise the rules of the filter. The exclude rules are moved
+ * ahead of the rules they short circuit and then the rules that
+ * can never be executed are removed and deleted. The optimised
+ * plan is reported if any change is made.
+ *
+ * @param rules	The rules in the order they are executed
+ */
+void RuleOptimiser::optimise(vector<Rule *>& rules)
+{
+	bool hoisted = hoistExcludes(rules);
+	bool removed = removeDeadRules(rules);
+	if (!hoisted && !removed)
+		return;
+	m_logger->info("The rules of the asset filter have been optimised and will be executed as:");
+	for (unsigned int i = 0; i < rules.size(); i++)
+	{
+		m_logger->info("    %d: %s '%s'", i + 1, actionName(rules[i]),
+				rules[i]->getName().c_str());
+	}
+}
+
+/**
+ * Move each exclude rule ahead of the rules that transform the
+ * readings it excludes, as far as no rule in between could change
+ * the asset name of a reading
+ *
+ * @param rules	The rules in the order they are executed
+ * @return bool	True if any exclude rule was moved
+ */
+bool RuleOptimiser::hoistExcludes(vector<Rule *>& rules)
+{
+	bool moved = false;
+	for (unsigned int i = 0; i < rules.size(); i++)
+	{
+		if (kind(rules[i]) != EXCLUDE)
+			continue;
+		Rule *exclude = rules[i];
+
+		// The earliest position at which the exclude sees the same names
+		unsigned int first = i;
+		while (first > 0 && canPass(exclude, rules[first - 1]))
+			first--;
+		while (first < i && disjoint(exclude, rules[first]))
+			first++;
+		if (first == i)
+			continue;
+
+		m_logger->info("The exclude rule for asset '%s' has been moved ahead of the %s rule for asset '%s'.",
+				exclude->getName().c_str(), actionName(rules[first]),
+				rules[first]->getName().c_str());
+		for (unsigned int j = i; j > first; j--)
+			rules[j] = rules[j - 1];
+		rules[first] = exclude;
+		moved = true;
+	}
+	return moved;
+}
+
+/**
+ * Check if an exclude rule may be moved ahead of another rule. The
+ * other rule must not change the name of a reading the exclude would
+ * match, nor give a reading such a name, nor create new readings.
+ *
+ * @param exclude	The exclude rule
+ * @param rule		The rule ahead of the exclude
+ * @return bool		True if the exclude may be moved ahead of the rule
+ */
+bool RuleOptimiser::canPass(Rule *exclude, Rule *rule)
+{
+	switch (kind(rule))
+	{
+		case INCLUDE:
+		case EXCLUDE:
+		case TRANSFORM:
+			return true;
+		case RENAME:
+			return disjoint(exclude, rule) && !mayProduce(rule, exclude);
+		default:
+			return false;
+	}
+}
+
+/**
+ * Remove and delete the rules that can never be executed because an
+ * earlier rule always removes the readings they match, or renames them
+ * to a name they do not match
+ *
+ * @param rules	The rules in the order they are executed
+ * @return bool	True if any rule was removed
+ */
+bool RuleOptimiser::removeDeadRules(vector<Rule *>& rules)
+{
+	bool removed = false;
+	unsigned int keep = 0;
+	for (unsigned int i = 0; i < rules.size(); i++)
+	{
+		Rule *rule = rules[i];
+		Rule *killer = NULL;
+		for (unsigned int j = keep; j > 0; j--)
+		{
+			if (kills(rules[j - 1], rule))
+			{
+				killer = rules[j - 1];
+				break;
+			}
+			if (mayProduce(rules[j - 1], rule))
+				break;
+		}
+		if (!killer)
+		{
+			rules[keep++] = rule;
+			continue;
+		}
+		m_logger->info("The %s rule for asset '%s' can never be executed because of the earlier %s rule for asset '%s' and has been removed.",
+				actionName(rule), rule->getName().c_str(),
+				actionName(killer), killer->getName().c_str());
+		delete rule;
+		removed = true;
+	}
+	rules.resize(keep);
+	return removed;
+}
+
+/**
+ * Classify a rule by its effect on the asset names of the readings.
+ * Only the exact class of the rule is considered, a class derived
+ * from one of the rules may behave differently.
+ *
+ * @param rule	The rule
+ * @return Kind	The kind of the rule
+ */
+RuleOptimiser::Kind RuleOptimiser::kind(Rule *rule)
+{
+	if (typeid(*rule) == typeid(IncludeRule))
+		return INCLUDE;
+	if (typeid(*rule) == typeid(ExcludeRule))
+		return EXCLUDE;
+	if (typeid(*rule) == typeid(RenameRule))
+		return RENAME;
+	if (typeid(*rule) == typeid(RemoveRule) || typeid(*rule) == typeid(SelectRule)
+			|| typeid(*rule) == typeid(DatapointMapRule)
+			|| typeid(*rule) == typeid(FlattenRule)
+			|| typeid(*rule) == typeid(NestRule))
+		return TRANSFORM;
+	if (typeid(*rule) == typeid(SplitRule))
+		return SPLIT;
+	return OTHER;
+}
+
+/**
+ * Return the action of a rule for reporting the plan
+ *
+ * @param rule	The rule
+ * @return const char*	The name of the action of the rule
+ */
+const char *RuleOptimiser::actionName(Rule *rule)
+{
+	if (typeid(*rule) == typeid(IncludeRule))
+		return "include";
+	if (typeid(*rule) == typeid(ExcludeRule))
+		return "exclude";
+	if (typeid(*rule) == typeid(RenameRule))
+		return "rename";
+	if (typeid(*rule) == typeid(RemoveRule))
+		return "remove";
+	if (typeid(*rule) == typeid(SelectRule))
+		return "select";
+	if (typeid(*rule) == typeid(DatapointMapRule))
+		return "datapointmap";
+	if (typeid(*rule) == typeid(FlattenRule))
+		return "flatten";
+	if (typeid(*rule) == typeid(NestRule))
+		return "nest";
+	if (typeid(*rule) == typeid(SplitRule))
+		return "split";
+	return "unknown";
+}
+
+/**
+ * Return the asset names matched by a rule that matches a literal
+ * name or a set of names
+ *
+ * @param rule	The rule
+ * @param names	Populated with the names, folded if the rule ignores case
+ * @return bool	False if the rule matches a pattern
+ */
+bool RuleOptimiser::names(Rule *rule, vector<string>& names)
+{
+	names.clear();
+	if (rule->isLiteral())
+		names.push_back(rule->getName());
+	else if (rule->isAssetSet())
+		names.assign(rule->getAssetNames().begin(), rule->getAssetNames().end());
+	else
+		return false;
+	return true;
+}
+
+/**
+ * Check if a rule matches every asset name that another rule matches
+ *
+ * @param rule	The rule
+ * @param other	The other rule
+ * @return bool	True if the rule is known to match all the names
+ */
+bool RuleOptimiser::covers(Rule *rule, Rule *other)
+{
+	if (rule->sameMatch(*other))
+		return true;
+	vector<string> otherNames;
+	if (!names(other, otherNames))
+		return false;
+	// A rule that ignores case matches names the other may not
+	if (other->isCaseInsensitive() && !rule->isCaseInsensitive())
+		return false;
+	for (auto& name : otherNames)
+	{
+		if (!rule->match(name))
+			return false;
+	}
+	return true;
+}
+
+/**
+ * Check if two rules are known to match no asset name in common. A
+ * rule that ignores case folds the names it is given, so matching the
+ * names of each rule against the other also finds the names that
+ * differ only in case.
+ *
+ * @param rule	The rule
+ * @param other	The other rule
+ * @return bool	True if no name can match both rules
+ */
+bool RuleOptimiser::disjoint(Rule *rule, Rule *other)
+{
+	vector<string> ruleNames, otherNames;
+	if (!names(rule, ruleNames) || !names(other, otherNames))
+		return false;
+	for (auto& name : ruleNames)
+	{
+		if (other->match(name))
+			return false;
+	}
+	for (auto& name : otherNames)
+	{
+		if (rule->match(name))
+			return false;
+	}
+	return true;
+}
+
+/**
+ * Check if a rule ensures that no reading it matches can later match
+ * another rule, either by excluding the reading or by renaming it to
+ * a name the other rule does not match
+ *
+ * @param rule	The earlier rule
+ * @param other	The later rule
+ * @return bool	True if the earlier rule leaves no reading for the later
+ */
+bool RuleOptimiser::kills(Rule *rule, Rule *other)
+{
+	Kind k = kind(rule);
+	if (k == EXCLUDE)
+		return covers(rule, other);
+	if (k != RENAME)
+		return false;
+	string newName;
+	if (!static_cast<RenameRule *>(rule)->fixedNewName(newName) || other->match(newName))
+		return false;
+	return covers(rule, other);
+}
+
+/**
+ * Check if a rule may give a reading an asset name that another rule
+ * matches, by renaming it or creating it
+ *
+ * @param rule	The earlier rule
+ * @param other	The later rule
+ * @return bool	True if the rule may produce a reading the later rule matches
+ */
+bool RuleOptimiser::mayProduce(Rule *rule, Rule *other)
+{
+	switch (kind(rule))
+	{
+		case RENAME:
+		{
+			string newName;
+			if (!static_cast<RenameRule *>(rule)->fixedNewName(newName))
+				return true;
+			return other->match(newName);
+		}
+		case SPLIT:
+		case OTHER:
+			return true;
+		default:
+			return false;
+	}
+}
@@ -0,0 +1,677 @@
+/*
+ * Fledge "asset" filter plugin rule program.
+ *
+ * Copyright (c) 2025 Dianomic Systems
+ *
+ * Released under the Apache 2.0 Licence
+ *
+ * Author: Mark Riddoch
+ */
+#include <rule_program.h>
+#include <typeinfo>
+
+using namespace std;
+
+/**
+ * Construct an empty rule program
+ *
+ * @param cache	The match cache for the rules of the program
+ */
+RuleProgram::RuleProgram(MatchCache& cache) : m_cache(cache), m_canGroup(true),
+	m_generation(0)
+{
+}
+
+/**
+ * Destructor for the rule program. The program does not own the rules,
+ * only the fused rules it creates.
+ */
+RuleProgram::~RuleProgram()
+{
+	clear();
+}
+
+/**
+ * Compile the rules into the program
+ *
+ * @param rules	The rules in the order they are executed
+ */
+void RuleProgram::compile(const vector<Rule *>& rules)
+{
+	clear();
+	m_ops.reserve(rules.size());
+	for (Rule *rule : rules)
+	{
+		m_ops.emplace_back(opCode(rule), rule);
+		pack(m_ops.back());
+		if (m_ops.back().m_code == Op::SPLIT || m_ops.back().m_code == Op::GENERIC)
+			m_canGroup = false;
+	}
+	fuse();
+	m_work.clear();
+	m_results.clear();
+	m_plans.resize(m_ops.size());
+}
+
+/**
+ * Fuse each run of consecutive remove, select and datapoint map rules
+ * that match the same asset names into the first op of the run.
+ */
+void RuleProgram::fuse()
+{
+	unsigned int i = 0;
+	while (i < m_ops.size())
+	{
+		unsigned int end = i + 1;
+		if (canFuse(m_ops[i]))
+		{
+			while (end < m_ops.size() && canFuse(m_ops[end])
+					&& m_ops[end].m_rule->sameMatch(*m_ops[i].m_rule))
+				end++;
+		}
+		if (end - i < 2)
+		{
+			i = end;
+			continue;
+		}
+
+		FusedRule *fused = new FusedRule();
+		for (unsigned int j = i; j < end; j++)
+		{
+			Rule *rule = m_ops[j].m_rule;
+			if (isRemove(m_ops[j].m_code))
+				fused->add(static_cast<RemoveRule *>(rule));
+			else if (isSelect(m_ops[j].m_code))
+				fused->add(static_cast<SelectRule *>(rule));
+			else
+				fused->add(static_cast<DatapointMapRule *>(rule));
+		}
+		Logger::getLogger()->info("Rules %d to %d for asset '%s' have been fused into a single pass over the datapoints.",
+				i + 1, end, m_ops[i].m_rule->getName().c_str());
+		m_ops[i].m_code = Op::FUSED;
+		m_ops[i].m_deferred = true;
+		m_ops[i].m_length = end - i;
+		m_ops[i].m_fused = fused;
+		i = end;
+	}
+}
+
+/**
+ * Find the ops that the program may dispatch. The ops within a fused
+ * run, other than the first, are never reached.
+ *
+ * @param ops	Populated with the positions of the ops in order
+ */
+void RuleProgram::dispatched(vector<unsigned int>& ops) const
+{
+	ops.clear();
+	for (unsigned int i = 0; i < m_ops.size(); i += m_ops[i].m_length)
+		ops.push_back(i);
+}
+
+/**
+ * Empty the program
+ */
+void RuleProgram::clear()
+{
+	for (Op& op : m_ops)
+		delete op.m_fused;
+	m_ops.clear();
+	m_plans.clear();
+	m_canGroup = true;
+}
+
+/**
+ * Run the program on a reading. Each matching rule is executed on
+ * the reading, or on each of the readings that result from the
+ * previous matching rule. The readings that pass through all the
+ * matching rules are added to the output.
+ *
+ * If no rule matches the reading it is left for the caller to
+ * apply the default rule and nothing is added to the output.
+ * If a rule produces no results then the execution of the rules
+ * ends at that point for that reading.
+ *
+ * @param reading	The reading to process
+ * @param out		The final output vector to add the results to
+ * @return int		The number of rules that have been executed
+ */
+int RuleProgram::run(Reading *reading, vector<Reading *>& out)
+{
+	unsigned int op = m_cache.next(reading->getAssetName(), 0);
+	if (op >= m_ops.size())
+		return 0;
+
+	int matches = 0;
+	m_work.emplace_back(reading, op, false);
+	while (!m_work.empty())
+	{
+		Work work = m_work.back();
+		m_work.pop_back();
+		reading = work.m_reading;
+		op = work.m_op;
+		// The op of the original reading is already known to match
+		if (matches > 0)
+			op = m_cache.next(reading->getAssetName(), op);
+		if (op >= m_ops.size())
+		{
+			if (work.m_dirty)
+				sweep(reading);
+			out.emplace_back(reading);
+			continue;
+		}
+
+		Op& current = m_ops[op];
+		if (work.m_dirty && !current.m_deferred)
+		{
+			sweep(reading);
+			work.m_dirty = false;
+		}
+		size_t removed = m_removed.size();
+		m_results.clear();
+		execute(current, reading, m_results, NULL);
+		matches++;
+		bool dirty = work.m_dirty || m_removed.size() != removed;
+
+		// Push the results in reverse so that the first is
+		// processed first
+		for (auto it = m_results.rbegin(); it != m_results.rend(); ++it)
+			m_work.emplace_back(*it, op + current.m_length, dirty);
+	}
+	release();
+	return matches;
+}
+
+/**
+ * Run the program on a set of readings grouped by asset name. The
+ * readings that match no rule have the default rule, if any, applied
+ * to them. The results are added to the output in the order of the
+ * readings they came from.
+ *
+ * The readings are placed in stages, one per op plus a final stage
+ * for the default rule. Since a reading only ever moves on to a later
+ * op the stages are run once each, in order.
+ *
+ * This must only be used if canGroup() is true.
+ *
+ * @param readings	The readings to process
+ * @param defaultRule	The rule for readings that match no rule, may be NULL
+ * @param out		The final output vector to add the results to
+ */
+void RuleProgram::runGrouped(const vector<Reading *>& readings, Rule *defaultRule,
+			vector<Reading *>& out)
+{
+	unsigned int end = m_ops.size();
+	m_stages.resize(end + 1);
+	m_slots.assign(readings.size(), NULL);
+
+	// Group the readings by asset name. The names are kept from
+	// previous runs, a group belongs to this run if it has the
+	// current generation.
+	if (m_groups.size() >= MAX_CACHED_PLANS)
+		m_groups.clear();
+	m_generation++;
+	m_groupNames.clear();
+	for (unsigned int i = 0; i < readings.size(); i++)
+	{
+		const string& asset = readings[i]->getAssetName();
+		auto group = m_groups.find(asset);
+		if (group == m_groups.end())
+			group = m_groups.emplace(asset, Group()).first;
+		if (group->second.m_generation != m_generation)
+		{
+			unsigned int index = m_groupNames.size();
+			group->second.m_generation = m_generation;
+			group->second.m_index = index;
+			m_groupNames.push_back(&group->first);
+			if (m_groupReadings.size() <= index)
+				m_groupReadings.emplace_back();
+			m_groupReadings[index].clear();
+		}
+		m_groupReadings[group->second.m_index].push_back(i);
+	}
+
+	// Find the first matching op once for each group
+	for (unsigned int g = 0; g < m_groupNames.size(); g++)
+	{
+		unsigned int op = m_cache.next(*m_groupNames[g], 0);
+		if (op >= end && !defaultRule)
+		{
+			for (unsigned int i : m_groupReadings[g])
+				m_slots[i] = readings[i];
+			continue;
+		}
+		for (unsigned int i : m_groupReadings[g])
+			m_stages[op].emplace_back(readings[i], i, false);
+	}
+
+	// Apply each op to all the readings that have reached it. The
+	// results of an op mostly share an asset name, so the next op is
+	// only looked up when the name changes.
+	for (unsigned int op = 0; op < end; op++)
+	{
+		Op& current = m_ops[op];
+		vector<Item>& stage = m_stages[op];
+		unsigned int next = end;
+		bool haveNext = false;
+		for (Item& item : stage)
+		{
+			if (item.m_dirty && !current.m_deferred)
+			{
+				sweep(item.m_reading);
+				item.m_dirty = false;
+			}
+			size_t removed = m_removed.size();
+			m_results.clear();
+			execute(current, item.m_reading, m_results, &m_plans[op]);
+			if (m_results.empty())
+				continue;
+			Reading *result = m_results[0];
+			bool dirty = item.m_dirty || m_removed.size() != removed;
+			if (!haveNext || result->getAssetName().compare(m_lastName) != 0)
+			{
+				m_lastName = result->getAssetName();
+				next = m_cache.next(m_lastName, op + current.m_length);
+				haveNext = true;
+			}
+			if (next >= end)
+			{
+				if (dirty)
+					sweep(result);
+				m_slots[item.m_origin] = result;
+			}
+			else
+			{
+				m_stages[next].emplace_back(result, item.m_origin, dirty);
+			}
+		}
+		stage.clear();
+	}
+
+	// The default rule for the readings that matched no rule
+	for (Item& item : m_stages[end])
+	{
+		m_results.clear();
+		defaultRule->execute(item.m_reading, m_results);
+		if (!m_results.empty())
+			m_slots[item.m_origin] = m_results[0];
+	}
+	m_stages[end].clear();
+
+	for (Reading *reading : m_slots)
+	{
+		if (reading)
+			out.emplace_back(reading);
+	}
+	release();
+}
+
+/**
+ * Begin a staged run of the program on a set of readings by finding
+ * the first op that matches each of the readings
+ *
+ * @param readings	The readings to process
+ * @param pending	Populated with an item for each reading
+ */
+void RuleProgram::start(const vector<Reading *>& readings, vector<Pending>& pending)
+{
+	pending.clear();
+	for (Reading *reading : readings)
+		pending.emplace_back(reading, m_cache.next(reading->getAssetName(), 0),
+				false, false);
+}
+
+/**
+ * Run one stage of the program. The items whose next op is in the
+ * range of the stage are run through the ops of the stage, those that
+ * produce results place them in the output in place of the item. The
+ * other items are copied to the output unchanged.
+ *
+ * @param in		The items from the previous stage
+ * @param from		The first op of the stage
+ * @param to		The op after the last op of the stage
+ * @param out		Populated with the items for the next stage
+ */
+void RuleProgram::runStage(const vector<Pending>& in, unsigned int from, unsigned int to,
+			vector<Pending>& out)
+{
+	out.clear();
+	for (const Pending& item : in)
+	{
+		if (item.m_op < from || item.m_op >= to)
+		{
+			out.push_back(item);
+			continue;
+		}
+		m_work.emplace_back(item.m_reading, item.m_op, item.m_dirty);
+		while (!m_work.empty())
+		{
+			Work work = m_work.back();
+			m_work.pop_back();
+			if (work.m_op >= to)
+			{
+				out.emplace_back(work.m_reading, work.m_op, work.m_dirty, true);
+				continue;
+			}
+
+			Op& current = m_ops[work.m_op];
+			if (work.m_dirty && !current.m_deferred)
+			{
+				sweep(work.m_reading);
+				work.m_dirty = false;
+			}
+			size_t removed = m_removed.size();
+			m_results.clear();
+			execute(current, work.m_reading, m_results, NULL);
+			bool dirty = work.m_dirty || m_removed.size() != removed;
+
+			// Push the results in reverse so that the first is
+			// processed first
+			unsigned int next = work.m_op + current.m_length;
+			for (auto it = m_results.rbegin(); it != m_results.rend(); ++it)
+				m_work.emplace_back(*it, m_cache.next((*it)->getAssetName(), next), dirty);
+		}
+	}
+	release();
+}
+
+/**
+ * Complete a staged run of the program. The readings that matched no
+ * op have the default rule, if any, applied to them.
+ *
+ * @param pending	The items from the last stage
+ * @param defaultRule	The rule for readings that match no rule, may be NULL
+ * @param out		The final output vector to add the results to
+ */
+void RuleProgram::finish(const vector<Pending>& pending, Rule *defaultRule,
+			vector<Reading *>& out)
+{
+	for (const Pending& item : pending)
+	{
+		if (!item.m_matched && defaultRule)
+		{
+			defaultRule->execute(item.m_reading, out);
+			continue;
+		}
+		if (item.m_dirty)
+			sweep(item.m_reading);
+		out.emplace_back(item.m_reading);
+	}
+}
+
+/**
+ * Compact the datapoints of a reading, dropping the NULL entries left
+ * by the rules that have removed datapoints. The removed datapoints
+ * have already been passed to the program and are not deleted here.
+ *
+ * @param reading	The reading to compact
+ */
+void RuleProgram::sweep(Reading *reading)
+{
+	vector<Datapoint *>& dps = reading->getReadingData();
+	auto keep = dps.begin();
+	for (auto it = dps.begin(); it != dps.end(); ++it)
+	{
+		if (*it)
+			*keep++ = *it;
+	}
+	dps.erase(keep, dps.end());
+}
+
+/**
+ * Delete the datapoints removed by the rules during a run
+ */
+void RuleProgram::release()
+{
+	for (Datapoint *dp : m_removed)
+		delete dp;
+	m_removed.clear();
+}
+
+/**
+ * Determine the op code for a rule from the class of the rule and, for
+ * the rules that have kernels for the ways they may be configured, the
+ * way the rule was configured. Only the exact class is considered, a
+ * class derived from one of the rules may override its execute method.
+ *
+ * @param rule	The rule
+ * @return OpCode	The op code that executes the rule
+ */
+RuleProgram::Op::OpCode RuleProgram::opCode(Rule *rule)
+{
+	if (typeid(*rule) == typeid(IncludeRule))
+		return Op::INCLUDE;
+	if (typeid(*rule) == typeid(ExcludeRule))
+		return Op::EXCLUDE;
+	if (typeid(*rule) == typeid(RenameRule))
+		return static_cast<RenameRule *>(rule)->getRenameRegex() ? Op::RENAME_REGEX : Op::RENAME;
+	if (typeid(*rule) == typeid(RemoveRule))
+		return (Op::OpCode)(Op::REMOVE_NONE + static_cast<RemoveRule *>(rule)->getChoice().m_mode);
+	if (typeid(*rule) == typeid(FlattenRule))
+		return Op::FLATTEN;
+	if (typeid(*rule) == typeid(DatapointMapRule))
+		return Op::DATAPOINTMAP;
+	if (typeid(*rule) == typeid(SplitRule))
+		return Op::SPLIT;
+	if (typeid(*rule) == typeid(SelectRule))
+		return (Op::OpCode)(Op::SELECT_NONE + static_cast<SelectRule *>(rule)->getChoice().m_mode);
+	if (typeid(*rule) == typeid(NestRule))
+		return Op::NEST;
+	return Op::GENERIC;
+}
+
+/**
+ * Pack the fields the rule of an op reads for each reading into the op
+ *
+ * @param op	The op, with its op code and rule
+ */
+void RuleProgram::pack(Op& op)
+{
+	if (op.m_code == Op::RENAME || op.m_code == Op::RENAME_REGEX)
+	{
+		RenameRule *rule = static_cast<RenameRule *>(op.m_rule);
+		op.m_name = rule->getNewName();
+		op.m_regex = rule->getRenameRegex();
+	}
+	else if (isRemove(op.m_code))
+	{
+		op.m_choice = static_cast<RemoveRule *>(op.m_rule)->getChoice();
+	}
+	else if (isSelect(op.m_code))
+	{
+		op.m_choice = static_cast<SelectRule *>(op.m_rule)->getChoice();
+	}
+}
+
+/**
+ * Pass an asset name to the rule of an op to be tracked, unless it
+ * is the name the op passed last. The rule remembers the names it has
+ * tracked, this saves looking the name up for each reading.
+ *
+ * @param op	The op
+ * @param asset	The asset name
+ * @return bool	True if the name was passed to the rule
+ */
+inline bool RuleProgram::track(Op& op, const string& asset)
+{
+	if (op.m_hasTracked && op.m_tracked.compare(asset) == 0)
+		return false;
+	op.m_rule->track(asset);
+	op.m_tracked = asset;
+	op.m_hasTracked = true;
+	return true;
+}
+
+/**
+ * Rename a reading, either to the new name of the op or by substituting
+ * the format of the op for the match of the asset expression. The new
+ * name is tracked whenever the original name is.
+ *
+ * @param op		The rename op
+ * @param reading	The reading to rename
+ * @param out		The vector in which to place the result
+ */
+template<bool isRegex>
+inline void RuleProgram::rename(Op& op, Reading *reading, vector<Reading *>& out)
+{
+	bool tracked = track(op, reading->getAssetName());
+	if (isRegex)
+		reading->setAssetName(op.m_regex->replace(reading->getAssetName(), op.m_name));
+	else
+		reading->setAssetName(op.m_name);
+	if (tracked)
+		op.m_rule->track(reading->getAssetName());
+	out.emplace_back(reading);
+}
+
+/**
+ * Remove the datapoints chosen by a remove op, or those not chosen by
+ * a select op, from a reading. The removal is deferred. With a column
+ * plan the datapoints are only tested when the schema changes. A select
+ * that leaves no datapoints drops the reading.
+ *
+ * @param op		The remove or select op
+ * @param reading	The reading to process
+ * @param out		The vector in which to place the result
+ * @param plan		The column plan of the op or NULL
+ */
+template<DatapointChoice::Mode mode, bool select>
+inline void RuleProgram::choose(Op& op, Reading *reading, vector<Reading *>& out,
+			ColumnPlan *plan)
+{
+	vector<Datapoint *>& dps = reading->getReadingData();
+	if (!plan)
+	{
+		op.m_choice.remove<mode, select>(reading, &m_removed);
+	}
+	else
+	{
+		if (!plan->sameSchema(dps))
+		{
+			plan->reset(dps.size());
+			for (unsigned int i = 0; i < dps.size(); i++)
+			{
+				if (dps[i] && op.m_choice.chooses<mode>(dps[i]) != select)
+					plan->remove(i);
+			}
+		}
+		plan->apply(reading, &m_removed);
+	}
+	track(op, reading->getAssetName());
+	if (!select)
+	{
+		out.emplace_back(reading);
+		return;
+	}
+	for (Datapoint *dp : dps)
+	{
+		if (dp)
+		{
+			out.emplace_back(reading);
+			return;
+		}
+	}
+	delete reading;
+}
+
+/**
+ * Execute an op on a reading. The include, exclude, rename, remove and
+ * select ops are executed by a kernel for the op code that reads only
+ * the op. The other rules have the execute method of the class of the
+ * rule called directly rather than as a virtual method. The rules that
+ * remove datapoints pass the datapoints they remove to the program,
+ * the rules that support column plans use the plan of the op if one is
+ * given.
+ *
+ * @param op		The op to execute
+ * @param reading	The reading to process
+ * @param out		The vector in which to place the result
+ * @param plan		The column plan of the op or NULL
+ */
+inline void RuleProgram::execute(Op& op, Reading *reading, vector<Reading *>& out,
+			ColumnPlan *plan)
+{
+	switch (op.m_code)
+	{
+		case Op::INCLUDE:
+			track(op, reading->getAssetName());
+			out.emplace_back(reading);
+			break;
+		case Op::EXCLUDE:
+			track(op, reading->getAssetName());
+			delete reading;
+			break;
+		case Op::RENAME:
+			rename<false>(op, reading, out);
+			break;
+		case Op::RENAME_REGEX:
+			rename<true>(op, reading, out);
+			break;
+		case Op::REMOVE_NONE:
+			choose<DatapointChoice::NONE, false>(op, reading, out, plan);
+			break;
+		case Op::REMOVE_NAME:
+			choose<DatapointChoice::NAME, false>(op, reading, out, plan);
+			break;
+		case Op::REMOVE_REGEX:
+			choose<DatapointChoice::REGEX, false>(op, reading, out, plan);
+			break;
+		case Op::REMOVE_NAMES:
+			choose<DatapointChoice::NAMES, false>(op, reading, out, plan);
+			break;
+		case Op::REMOVE_TYPE:
+			choose<DatapointChoice::TYPE, false>(op, reading, out, plan);
+			break;
+		case Op::REMOVE_NUMBER:
+			choose<DatapointChoice::NUMBER, false>(op, reading, out, plan);
+			break;
+		case Op::REMOVE_NON_NUMERIC:
+			choose<DatapointChoice::NON_NUMERIC, false>(op, reading, out, plan);
+			break;
+		case Op::REMOVE_USER_ARRAY:
+			choose<DatapointChoice::USER_ARRAY, false>(op, reading, out, plan);
+			break;
+		case Op::SELECT_NONE:
+			choose<DatapointChoice::NONE, true>(op, reading, out, plan);
+			break;
+		case Op::SELECT_NAME:
+			choose<DatapointChoice::NAME, true>(op, reading, out, plan);
+			break;
+		case Op::SELECT_REGEX:
+			choose<DatapointChoice::REGEX, true>(op, reading, out, plan);
+			break;
+		case Op::SELECT_NAMES:
+			choose<DatapointChoice::NAMES, true>(op, reading, out, plan);
+			break;
+		case Op::SELECT_TYPE:
+			choose<DatapointChoice::TYPE, true>(op, reading, out, plan);
+			break;
+		case Op::SELECT_NUMBER:
+			choose<DatapointChoice::NUMBER, true>(op, reading, out, plan);
+			break;
+		case Op::SELECT_NON_NUMERIC:
+			choose<DatapointChoice::NON_NUMERIC, true>(op, reading, out, plan);
+			break;
+		case Op::SELECT_USER_ARRAY:
+			choose<DatapointChoice::USER_ARRAY, true>(op, reading, out, plan);
+			break;
+		case Op::FLATTEN:
+			static_cast<FlattenRule *>(op.m_rule)->FlattenRule::execute(reading, out);
+			break;
+		case Op::DATAPOINTMAP:
+			static_cast<DatapointMapRule *>(op.m_rule)->execute(reading, out, plan);
+			break;
+		case Op::SPLIT:
+			static_cast<SplitRule *>(op.m_rule)->SplitRule::execute(reading, out);
+			break;
+		case Op::NEST:
+			static_cast<NestRule *>(op.m_rule)->NestRule::execute(reading, out);
+			break;
+		case Op::FUSED:
+			op.m_fused->execute(reading, out, plan, &m_removed);
+			break;
+		default:
+			op.m_rule->execute(reading, out);
+			break;
+	}
+}
@@ -0,0 +1,292 @@
+/*
+ * Fledge "asset" filter plugin rule set.
+ *
+ * Copyright (c) 2025 Dianomic Systems
+ *
+ * Released under the Apache 2.0 Licence
+ *
+ * Author: Mark Riddoch
+ */
+#include <rule_set.h>
+#include <rule_optimiser.h>
+#include <algorithm>
+
+using namespace std;
+
+/**
+ * The number of ranges of readings for each thread when a set of
+ * readings is divided between the threads
+ */
+#define RANGES_PER_THREAD	8
+
+/**
+ * The fewest readings in a range
+ */
+#define MIN_RANGE_READINGS	16
+
+/**
+ * Construct an empty rule set
+ *
+ * @param threads	The number of threads that process a large set of readings
+ * @param threshold	The number of readings in a set that makes it large
+ * @param stages	The number of pipeline stages to divide the rules into
+ */
+RuleSet::RuleSet(unsigned int threads, unsigned int threshold, unsigned int stages) :
+		m_defaultRule(NULL), m_pool(NULL), m_threshold(threshold),
+		m_pipeline(NULL), m_stages(stages), m_enabled(true)
+{
+	if (threads < 1)
+		threads = 1;
+	else if (threads > MAX_WORKER_THREADS)
+		threads = MAX_WORKER_THREADS;
+	for (unsigned int i = 0; i < threads; i++)
+		m_contexts.push_back(new Context(m_index));
+	if (threads > 1)
+		m_pool = new WorkerPool(threads);
+}
+
+/**
+ * Destructor for the rule set, deletes the rules
+ */
+RuleSet::~RuleSet()
+{
+	if (m_pipeline)
+		delete m_pipeline;
+	if (m_pool)
+		delete m_pool;
+	for (auto& c : m_contexts)
+		delete c;
+	for (auto& r : m_rules)
+		delete r;
+	if (m_defaultRule)
+		delete m_defaultRule;
+}
+
+/**
+ * Add a rule to the end of the rule set. The rule set takes
+ * ownership of the rule.
+ *
+ * @param rule	The rule to add
+ */
+void RuleSet::addRule(Rule *rule)
+{
+	m_rules.emplace_back(rule);
+}
+
+/**
+ * Set the rule that is run on readings that match no other rule.
+ * The rule set takes ownership of the rule.
+ *
+ * @param rule	The default rule
+ */
+void RuleSet::setDefaultRule(Rule *rule)
+{
+	if (m_defaultRule)
+		delete m_defaultRule;
+	m_defaultRule = rule;
+}
+
+/**
+ * Compile the rules once all of them have been added. The rule set
+ * must not be altered after it has been compiled.
+ *
+ * If pipeline stages were requested the pipeline is created, with no
+ * more stages than there are ops the compiled rules dispatch.
+ */
+void RuleSet::compile()
+{
+	RuleOptimiser optimiser;
+	optimiser.optimise(m_rules);
+	m_index.build(m_rules);
+	for (auto& c : m_contexts)
+		c->m_program.compile(m_rules);
+
+	unsigned int stages = m_stages;
+	if (stages > MAX_PIPELINE_STAGES)
+		stages = MAX_PIPELINE_STAGES;
+	vector<unsigned int> ops;
+	m_contexts[0]->m_program.dispatched(ops);
+	if (stages > ops.size())
+		stages = ops.size();
+	if (stages > 1)
+		m_pipeline = new Pipeline(m_index, m_rules, m_defaultRule, stages);
+}
+
+/**
+ * Process the readings and pass the results to the output function.
+ * If no reading matches a rule the set is passed on unchanged,
+ * otherwise the resultant readings replace the readings in the set.
+ *
+ * If the rules are divided into a pipeline a set of readings that is
+ * large enough to divide into chunks is processed by the pipeline. The
+ * results are passed on once the whole set has been processed.
+ *
+ * @param input	The readings to be processed
+ * @param func	The function to pass the results to
+ * @param data	The handle to pass to the function
+ */
+void RuleSet::ingest(READINGSET *input, OUTPUT_STREAM func, OUTPUT_HANDLE *data)
+{
+	if (!passthrough(input))
+	{
+		size_t count = input->getAllReadings().size();
+		if (m_pipeline && count > MIN_PIPELINE_CHUNK)
+			m_pipeline->ingest(input);
+		else if (m_pool && count >= m_threshold)
+			ingestParallel(input);
+		else
+			ingestInline(input);
+	}
+	(*func)(data, input);
+}
+
+/**
+ * Process the readings by executing all the rules in turn
+ * that match the asset name in each reading.
+ *
+ * NB Each input reading may result in zero or more output readings
+ *
+ * The resultant readings replace the readings in the input set.
+ *
+ * @param input	The readings to be processed
+ */
+void RuleSet::ingestInline(READINGSET *input)
+{
+	Context *context = m_contexts[0];
+	process(*context, input->getAllReadings(), context->m_output);
+
+	// The readings in the input reading set will either have
+	// been deleted or reused by the rules. Therefore we must clear
+	// the reading set, without deleting the readings, before the
+	// results are placed in it.
+	input->clear();
+	input->append(context->m_output);
+}
+
+/**
+ * Process a set of readings by dividing it into ranges that are
+ * shared between the threads of the pool. There are several ranges
+ * for each thread so that a thread that finishes early can take
+ * ranges from threads that have been given expensive readings. The
+ * results of each range are kept separately and appended to the
+ * reading set in the order of the ranges. The asset names the rules
+ * have not seen before are tracked once all the ranges are complete.
+ *
+ * @param input	The readings to be processed
+ */
+void RuleSet::ingestParallel(READINGSET *input)
+{
+	const vector<Reading *>& readings = input->getAllReadings();
+	size_t rangeSize = (readings.size() + m_contexts.size() * RANGES_PER_THREAD - 1)
+				/ (m_contexts.size() * RANGES_PER_THREAD);
+	if (rangeSize < MIN_RANGE_READINGS)
+		rangeSize = MIN_RANGE_READINGS;
+	unsigned int ranges = (readings.size() + rangeSize - 1) / rangeSize;
+	if (m_outputs.size() < ranges)
+		m_outputs.resize(ranges);
+
+	m_pool->run(ranges, [this, &readings, rangeSize](unsigned int worker, unsigned int range) {
+			Context *context = m_contexts[worker];
+			size_t from = range * rangeSize;
+			size_t to = min(from + rangeSize, readings.size());
+			context->m_input.assign(readings.begin() + from, readings.begin() + to);
+			Rule::deferTracking(&context->m_tracking);
+			process(*context, context->m_input, m_outputs[range]);
+			Rule::deferTracking(NULL);
+		});
+	for (auto& context : m_contexts)
+		context->m_tracking.apply();
+
+	input->clear();
+	for (unsigned int range = 0; range < ranges; range++)
+		input->append(m_outputs[range]);
+}
+
+/**
+ * Run the rules on a set of readings, using the working state of
+ * one context
+ *
+ * @param context	The working state to use
+ * @param readings	The readings to process
+ * @param out		Populated with the results
+ */
+void RuleSet::process(Context& context, const vector<Reading *>& readings,
+			vector<Reading *>& out)
+{
+	out.clear();
+
+	if (m_rules.size() > 0 && readings.size() > 1 && context.m_program.canGroup())
+	{
+		// Run each rule across all the readings of an asset at once
+		context.m_program.runGrouped(readings, m_defaultRule, out);
+	}
+	else
+	{
+		for (Reading *reading : readings)
+		{
+			if (m_rules.size() == 0)
+			{
+				// We have no rules, run the default rule if there
+				// is one otherwise copy the reading through
+				if (m_defaultRule)
+					m_defaultRule->execute(reading, out);
+				else
+					out.emplace_back(reading);
+			}
+			else
+			{
+				int matches = context.m_program.run(reading, out);
+				if (matches == 0 && m_defaultRule)
+				{
+					// No rules matched so run the default rule
+					m_defaultRule->execute(reading, out);
+				}
+				else if (matches == 0)
+				{
+					// No rules matched and we have no default rule
+					out.emplace_back(reading);
+				}
+			}
+		}
+	}
+}
+
+/**
+ * Check if a set of readings can be passed on unchanged. This is
+ * the case if no reading matches any of the rules and the default
+ * rule, if there is one, is an include rule. The match cache is used
+ * to check each asset name, so after the cache has warmed up this
+ * costs a hash lookup per reading.
+ *
+ * The assets are tracked as if the default rule had been executed
+ * on each of the readings.
+ *
+ * @param input	The readings to be processed
+ * @return bool	True if the readings should be passed on unchanged
+ */
+bool RuleSet::passthrough(READINGSET *input)
+{
+	IncludeRule *include = dynamic_cast<IncludeRule *>(m_defaultRule);
+	if (m_defaultRule && !include)
+		return false;
+
+	const vector<Reading *>& readings = input->getAllReadings();
+	for (Reading *reading : readings)
+	{
+		if (m_contexts[0]->m_cache.next(reading->getAssetName(), 0) < m_rules.size())
+			return false;
+	}
+
+	if (include)
+	{
+		// Consecutive readings usually share an asset name, only
+		// track the name when it changes
+		for (unsigned int i = 0; i < readings.size(); i++)
+		{
+			const string& asset = readings[i]->getAssetName();
+			if (i == 0 || asset.compare(readings[i - 1]->getAssetName()) != 0)
+				include->track(asset);
+		}
+	}
+	return true;
+}
@@ -13,44 +13,175 @@
 using namespace std;
 using namespace rapidjson;
 
+thread_local DeferredTracking *Rule::m_deferred = NULL;
+
 /**
  * Constructor for the base rule class
  *
  * @param service The service name
  * @param asset	The asset name for the rule
+ * @param engine	The regular expression engine to use
  */
-Rule::Rule(const string& service, const string& asset) : m_asset(asset),
-	m_assetIsRegex(false), m_asset_re(NULL), m_service(service)
+Rule::Rule(const string& service, const string& asset, RegexEngine engine) : m_asset(asset),
+	m_assetIsRegex(false), m_asset_re(NULL), m_matcher(NULL), m_assetIsSet(false),
+	m_glob(NULL), m_service(service), m_engine(engine), m_caseInsensitive(false)
 {
 	m_logger = Logger::getLogger();
-	if (isRegexString(asset))
+	compileAsset(asset);
+	m_tracker = AssetTracker::getAssetTracker();
+}
+
+/**
+ * Constructor for the base rule class from the JSON definition
+ * of the rule. If the rule has an asset_names array the rule
+ * matches any of the names in the array, otherwise it matches
+ * the asset name. The match property of the rule determines if
+ * the asset name is a literal name, a glob pattern or a regular
+ * expression, if not given the name itself is examined. If the
+ * rule sets case_insensitive the names are folded to lower case.
+ *
+ * @param service The service name
+ * @param asset	The asset name for the rule
+ * @param json	The JSON definition of the rule
+ * @param engine	The regular expression engine to use
+ */
+Rule::Rule(const string& service, const string& asset, const Value& json, RegexEngine engine) :
+	m_asset(asset), m_assetIsRegex(false), m_asset_re(NULL), m_matcher(NULL),
+	m_assetIsSet(false), m_glob(NULL), m_service(service), m_engine(engine),
+	m_caseInsensitive(false)
+{
+	m_logger = Logger::getLogger();
+	if (json.HasMember("case_insensitive"))
 	{
-		try {
-			m_asset_re = new regex(asset);
-			if (m_asset_re)
-			{
-				m_assetIsRegex = true;
-			}
+		if (json["case_insensitive"].IsBool())
+			m_caseInsensitive = json["case_insensitive"].GetBool();
+		else
+			m_logger->error("The case_insensitive property of the rule for asset '%s' must be a boolean.", m_asset.c_str());
+	}
+	if (json.HasMember("asset_names") && json["asset_names"].IsArray())
+	{
+		m_assetIsSet = true;
+		for (auto& name : json["asset_names"].GetArray())
+		{
+			if (name.IsString())
+				m_assetNames.insert(foldName(name.GetString()));
 			else
-			{
-				m_logger->error("Failed to parse regular expression for asset name '%s'.",
-					asset.c_str());
-			}
-		} catch (...) {
-			m_logger->error("Invalid regular expression for asset name '%s'.",
-					asset.c_str());
+				m_logger->error("The asset_names of the rule for assets '%s' must all be strings.", m_asset.c_str());
+		}
+	}
+	else if (json.HasMember("match") && json["match"].IsString())
+	{
+		string mode = json["match"].GetString();
+		if (mode.compare("glob") == 0)
+		{
+			compileGlob(asset);
 		}
+		else if (mode.compare("regex") == 0)
+		{
+			compileRegex(asset);
+		}
+		else if (mode.compare("literal") == 0)
+		{
+			m_asset = foldName(asset);
+		}
+		else
+		{
+			m_logger->error("The match mode '%s' of the rule for asset '%s' is not valid, it should be one of literal, glob or regex.",
+					mode.c_str(), asset.c_str());
+			compileAsset(asset);
+		}
+	}
+	else
+	{
+		compileAsset(asset);
 	}
 	m_tracker = AssetTracker::getAssetTracker();
 }
 
+/**
+ * Prepare the matching of the asset name of the rule. If the name
+ * contains any special characters it is treated as a regular expression.
+ *
+ * @param asset	The asset name for the rule
+ */
+void Rule::compileAsset(const string& asset)
+{
+	if (isRegexString(asset))
+		compileRegex(asset);
+	else
+		m_asset = foldName(asset);
+}
+
+/**
+ * Prepare the matching of an asset name that is a glob pattern. A
+ * pattern without wildcards is matched as a literal name.
+ *
+ * @param asset	The glob pattern for the rule
+ */
+void Rule::compileGlob(const string& asset)
+{
+	GlobMatcher *glob = new GlobMatcher(foldName(asset));
+	if (glob->isLiteral())
+	{
+		m_asset = glob->literal();
+		delete glob;
+	}
+	else
+	{
+		m_glob = glob;
+	}
+}
+
+/**
+ * Compile and analyse the regular expression used to match
+ * the asset name of the rule. If the case of the name is ignored
+ * the simpler tests are built from the folded expression and are
+ * applied to the folded asset name. An expression that cannot be
+ * folded, such as one with a range that only partly covers the
+ * letters, is not lowered to a simpler test and is always matched
+ * by the regular expression, which ignores case itself.
+ *
+ * @param asset	The regular expression for the rule
+ */
+void Rule::compileRegex(const string& asset)
+{
+	try {
+		m_asset_re = new Regex(asset, m_engine, m_caseInsensitive);
+		if (m_asset_re)
+		{
+			m_assetIsRegex = true;
+			if (!m_caseInsensitive)
+				m_matcher = new AssetMatcher(asset);
+			else if (canFoldPattern(asset))
+				m_matcher = new AssetMatcher(foldPattern(asset));
+			else
+				m_matcher = new AssetMatcher();
+			m_logger->debug("The asset name '%s' will be matched using a %s test.",
+					asset.c_str(), m_matcher->kindName());
+		}
+		else
+		{
+			m_logger->error("Failed to parse regular expression for asset name '%s'.",
+				asset.c_str());
+		}
+	} catch (...) {
+		m_logger->error("Invalid regular expression for asset name '%s'.",
+				asset.c_str());
+	}
+}
+
 /**
  * Destructor for the base rule class
  */
 Rule::~Rule()
 {
 	if (m_assetIsRegex)
+	{
 		delete m_asset_re;
+		delete m_matcher;
+	}
+	if (m_glob)
+		delete m_glob;
 }
 
 /**
@@ -62,10 +193,57 @@ Rule::~Rule()
  */
 bool Rule::match(Reading *reading)
 {
-	string assetName = reading->getAssetName();
+	return match(reading->getAssetName());
+}
+
+/**
+ * Check if the rule should be run against a given asset name.
+ *
+ * @param asset	The asset name to match
+ */
+bool Rule::match(const string& asset)
+{
+	if (m_caseInsensitive)
+	{
+		string folded;
+		foldCase(asset, folded);
+		return matchName(folded);
+	}
+	return matchName(asset);
+}
+
+/**
+ * Check if the rule should be run against a given asset name, using
+ * a copy of the name that the caller has folded to lower case. This
+ * allows the name to be folded once and shared by all of the rules.
+ *
+ * @param asset		The asset name to match
+ * @param folded	The asset name folded to lower case
+ */
+bool Rule::match(const string& asset, const string& folded)
+{
+	return matchName(m_caseInsensitive ? folded : asset);
+}
+
+/**
+ * Match an asset name, which has already been folded to lower
+ * case if the rule ignores case.
+ *
+ * @param asset	The asset name to match
+ */
+bool Rule::matchName(const string& asset)
+{
+	if (m_assetIsSet)
+		return m_assetNames.find(asset) != m_assetNames.end();
+	if (m_glob)
+		return m_glob->match(asset);
 	if (m_assetIsRegex)
-		return regex_match(assetName, *m_asset_re);
-	else if (assetName.compare(m_asset) == 0)
+	{
+		if (m_matcher->kind() != AssetMatcher::REGEX)
+			return m_matcher->match(asset);
+		return m_asset_re->match(asset);
+	}
+	else if (asset.compare(m_asset) == 0)
 		return true;
 	return false;
 }
@@ -90,13 +268,107 @@ bool Rule::isRegexString(const string& str)
 	return false;
 }
 
+/**
+ * Record that the rule has processed an asset. The asset tracker
+ * is only called the first time the rule sees each asset name,
+ * so tracking an asset the rule has already seen allocates no
+ * memory.
+ *
+ * The names the rule has seen are never altered by two threads at
+ * once. When a set of readings is shared between the threads of the
+ * worker pool, which may run the same rule at the same time, each
+ * thread defers the names the rule has not seen. The thread that
+ * delivers readings to the filter tracks them once the threads have
+ * finished. No lock is needed to check a name the rule has seen.
+ *
+ * @param asset	The asset name
+ */
+void Rule::track(const string& asset)
+{
+	if (!m_tracker)
+		return;
+	if (m_tracked.find(asset) != m_tracked.end())
+		return;
+	if (m_deferred)
+	{
+		m_deferred->add(this, asset);
+		return;
+	}
+	if (m_tracked.size() >= MAX_TRACKED_ASSETS)
+		m_tracked.clear();
+	m_tracked.insert(asset);
+	m_tracker->addAssetTrackingTuple(m_service, asset, string("Filter"));
+}
+
+/**
+ * Defer the tracking of assets the rules have not seen by the calling
+ * thread, or stop deferring it
+ *
+ * @param deferred	Where to hold the deferred names, NULL to track
+ *			names immediately
+ */
+void Rule::deferTracking(DeferredTracking *deferred)
+{
+	m_deferred = deferred;
+}
+
+/**
+ * Hold an asset name that a rule has not seen
+ *
+ * @param rule	The rule that processed the asset
+ * @param asset	The asset name
+ */
+void DeferredTracking::add(Rule *rule, const string& asset)
+{
+	unordered_set<string>& assets = m_assets[rule];
+	if (assets.find(asset) == assets.end())
+		assets.insert(asset);
+}
+
+/**
+ * Track the asset names that have been held, this must be called by
+ * the thread that delivers readings to the filter
+ */
+void DeferredTracking::apply()
+{
+	if (m_assets.empty())
+		return;
+	for (auto& rule : m_assets)
+		for (auto& asset : rule.second)
+			rule.first->track(asset);
+	m_assets.clear();
+}
+
+/**
+ * Check if another rule matches exactly the same asset names as this
+ * rule. The rules must use the same kind of match on the same name,
+ * pattern or set of names, and must agree on the case of letters.
+ *
+ * @param other	The other rule
+ * @return bool	True if the rules match the same asset names
+ */
+bool Rule::sameMatch(const Rule& other) const
+{
+	if (m_caseInsensitive != other.m_caseInsensitive
+			|| m_assetIsSet != other.m_assetIsSet
+			|| m_assetIsRegex != other.m_assetIsRegex
+			|| (m_glob == NULL) != (other.m_glob == NULL))
+		return false;
+	if (m_assetIsSet)
+		return m_assetNames == other.m_assetNames;
+	return m_asset.compare(other.m_asset) == 0;
+}
+
 /**
  * Constructor for the include rule
  *
  * @param service The service name
  * @param asset	The asset name
+ * @param json	The JSON definition of the rule
+ * @param engine	The regular expression engine to use
  */
-IncludeRule::IncludeRule(const string& service, const string& asset) : Rule(service, asset)
+IncludeRule::IncludeRule(const string& service, const string& asset, const Value& json, RegexEngine engine) :
+	Rule(service, asset, json, engine)
 {
 }
 
@@ -128,10 +400,7 @@ IncludeRule::~IncludeRule()
 void IncludeRule::execute(Reading *reading, vector<Reading *>& out)
 {
 	out.emplace_back(reading);
-	if (m_tracker)
-	{
-		m_tracker->addAssetTrackingTuple(m_service, reading->getAssetName(), string("Filter"));
-	}
+	track(reading->getAssetName());
 }
 
 /**
@@ -139,8 +408,11 @@ void IncludeRule::execute(Reading *reading, vector<Reading *>& out)
  *
  * @param service The service name
  * @param asset	The asset name
+ * @param json	The JSON definition of the rule
+ * @param engine	The regular expression engine to use
  */
-ExcludeRule::ExcludeRule(const string& service, const string& asset) : Rule(service, asset)
+ExcludeRule::ExcludeRule(const string& service, const string& asset, const Value& json, RegexEngine engine) :
+	Rule(service, asset, json, engine)
 {
 }
 
@@ -171,10 +443,7 @@ ExcludeRule::~ExcludeRule()
  */
 void ExcludeRule::execute(Reading *reading, vector<Reading *>& out)
 {
-	if (m_tracker)
-	{
-		m_tracker->addAssetTrackingTuple(m_service, reading->getAssetName(), string("Filter"));
-	}
+	track(reading->getAssetName());
 	delete reading;
 }
 
@@ -184,9 +453,10 @@ void ExcludeRule::execute(Reading *reading, vector<Reading *>& out)
  * @param service The service name
  * @param asset	The asset name
  * @param json	JSON iterator
+ * @param engine	The regular expression engine to use
  */
-RenameRule::RenameRule(const string& service, const string& asset, const Value& json) :
-	Rule(service, asset), m_isRegex(false)
+RenameRule::RenameRule(const string& service, const string& asset, const Value& json, RegexEngine engine) :
+	Rule(service, asset, json, engine), m_isRegex(false), m_newRegex(NULL)
 {
 	if (json.HasMember("new_asset_name") && json["new_asset_name"].IsString())
 	{
@@ -206,6 +476,10 @@ RenameRule::RenameRule(const string& service, const string& asset, const Value&
 	{
 		m_logger->error("Badly defined rename rule for asset '%s', a 'new_asset_name' property must be given and it must be a string.", m_asset.c_str());
 	}
+	if (m_isRegex)
+		m_kernel = &RenameRule::rename<true>;
+	else
+		m_kernel = &RenameRule::rename<false>;
 }
 
 /**
@@ -225,33 +499,56 @@ RenameRule::~RenameRule()
  */
 void RenameRule::execute(Reading *reading, vector<Reading *>& out)
 {
-	string origName = reading->getAssetName();
-	if (!m_isRegex)
-	{
-		reading->setAssetName(m_newName);
-	}
-	else if (m_asset_re)
-	{
-		string name = reading->getAssetName();
-		reading->setAssetName(regex_replace(name, *m_asset_re, m_newName));
-	}
-	if (m_tracker)
-	{
-		m_tracker->addAssetTrackingTuple(m_service, origName,  string("Filter"));
-		m_tracker->addAssetTrackingTuple(m_service, reading->getAssetName(), string("Filter"));
-	}
+	track(reading->getAssetName());
+	(this->*m_kernel)(reading);
+	track(reading->getAssetName());
 	out.emplace_back(reading);
 }
 
+/**
+ * Return the name the rule renames assets to, if the new name does
+ * not depend upon the original asset name
+ *
+ * @param name	Set to the new name
+ * @return bool	True if every asset is renamed to the same name
+ */
+bool RenameRule::fixedNewName(string& name)
+{
+	if (m_isRegex)
+		return false;
+	name = m_newName;
+	return true;
+}
+
+/**
+ * Rename a reading, either to the new name or by substituting
+ * the new name for the match of the regular expression.
+ *
+ * Reading::setAssetName takes the name by value and copies it into
+ * the reading, so a new name that is too long to be held within the
+ * string object itself is allocated twice for each reading renamed.
+ *
+ * @param reading	The reading to rename
+ */
+template<bool isRegex>
+void RenameRule::rename(Reading *reading)
+{
+	if (isRegex)
+		reading->setAssetName(m_asset_re->replace(reading->getAssetName(), m_newName));
+	else
+		reading->setAssetName(m_newName);
+}
+
 /**
  * Constructor for the datapoint map rule
  *
  * @param service The service name
  * @param asset	The asset name
  * @param json	JSON iterator
+ * @param engine	The regular expression engine to use
  */
-DatapointMapRule::DatapointMapRule(const string& service, const string& asset, const Value& json) :
-	Rule(service, asset)
+DatapointMapRule::DatapointMapRule(const string& service, const string& asset, const Value& json, RegexEngine engine) :
+	Rule(service, asset, json, engine), m_dpMap(NameLess(m_caseInsensitive))
 {
 	if (json.HasMember("map"))
 	{
@@ -264,11 +561,11 @@ DatapointMapRule::DatapointMapRule(const string& service, const string& asset, c
 				string newName = mapit.value.GetString();
 				if (isRegexString(origName))
 				{
-					m_dpRegexMap.insert(pair<regex *, string>(new regex(origName), newName));
+					m_dpRegexMap.push_back(pair<Regex *, string>(new Regex(origName, m_engine, m_caseInsensitive), newName));
 				}
 				else
 				{
-					m_dpMap.insert(pair<string, string>(origName, newName));
+					m_dpMap.insert(pair<string, string>(foldName(origName), newName));
 				}
 			}
 			else
@@ -302,31 +599,72 @@ void DatapointMapRule::execute(Reading *reading, vector<Reading *>& out)
 {
 
 	// Iterate over the datapoints and change the names
-	vector<Datapoint *> dps = reading->getReadingData();
+	vector<Datapoint *>& dps = reading->getReadingData();
 	for (auto it = dps.begin(); it != dps.end(); ++it)
 	{
 		Datapoint *dp = *it;
-		string name = dp->getName();
-		auto i = m_dpMap.find(name);
-		if (i != m_dpMap.end())
-		{
-			dp->setName(i->second);
-		}
-		else
+		string newName;
+		if (dp && mapName(dp->getName(), newName))
+			dp->setName(newName);
+	}
+	track(reading->getAssetName());
+	out.emplace_back(reading);
+}
+
+/**
+ * Execute the datapoint map rule with a column plan. The new names
+ * of the datapoints are only found when the schema changes.
+ *
+ * @param reading	The reading to process
+ * @param out		The vector in which to place the result
+ * @param plan		The column plan for the rule or NULL
+ */
+void DatapointMapRule::execute(Reading *reading, vector<Reading *>& out, ColumnPlan *plan)
+{
+	if (!plan)
+	{
+		execute(reading, out);
+		return;
+	}
+	vector<Datapoint *>& dps = reading->getReadingData();
+	if (!plan->sameSchema(dps))
+	{
+		plan->reset(dps.size());
+		for (unsigned int i = 0; i < dps.size(); i++)
 		{
-			for (auto& regexes : m_dpRegexMap)
-			{
-				if (regex_match(name, *regexes.first))
-				{
-					dp->setName(regex_replace(name, *regexes.first, regexes.second));
-					break;
-				}
-			}
+			string newName;
+			if (dps[i] && mapName(dps[i]->getName(), newName))
+				plan->rename(i, newName);
 		}
 	}
-	if (m_tracker)
+	plan->apply(reading, NULL);
+	track(reading->getAssetName());
+	out.emplace_back(reading);
+}
+
+/**
+ * Find the new name of a datapoint. The literal names are tried
+ * before the regular expressions.
+ *
+ * @param name		The name of the datapoint
+ * @param newName	Set to the new name of the datapoint
+ * @return bool		True if the datapoint is renamed
+ */
+bool DatapointMapRule::mapName(const string& name, string& newName)
+{
+	auto i = m_dpMap.find(name);
+	if (i != m_dpMap.end())
 	{
-		m_tracker->addAssetTrackingTuple(m_service, reading->getAssetName(), string("Filter"));
+		newName = i->second;
+		return true;
 	}
-	out.emplace_back(reading);
+	for (auto& regexes : m_dpRegexMap)
+	{
+		if (regexes.first->match(name))
+		{
+			newName = regexes.first->replace(name, regexes.second);
+			return true;
+		}
+	}
+	return false;
 }
@@ -22,27 +22,36 @@ static const    set<string> validDpTypes{"FLOAT", "INTEGER", "STRING", "FLOAT_AR
  * @param service The service name
  * @param asset	The asset name
  * @param json	JSON iterator
+ * @param engine	The regular expression engine to use
  */
-SelectRule::SelectRule(const string& service, const string& asset, const Value& json) : Rule(service, asset)
+SelectRule::SelectRule(const string& service, const string& asset, const Value& json, RegexEngine engine) :
+	Rule(service, asset, json, engine)
 {
+	m_choice.m_caseInsensitive = m_caseInsensitive;
+	m_choice.m_mode = DatapointChoice::NAMES;
 	if (json.HasMember("type") && json["type"].IsString())
 	{
-		m_type = json["type"].GetString();
-		transform(m_type.begin(), m_type.end(), m_type.begin(), ::toupper);
-		if (m_type == "FLOATING")
-			m_type = "FLOAT";
-		if (m_type == "BUFFER")
-			m_type = "DATABUFFER";
-		if (m_type == "NESTED")
-			m_type = "DP_DICT";
-		if (m_type == "2D_ARRAY")
-			m_type = "2D_FLOAT_ARRAY";
-		if (m_type == "ARRAY")
-			m_type = "FLOAT_ARRAY";
+		string type = json["type"].GetString();
+		transform(type.begin(), type.end(), type.begin(), ::toupper);
+		if (type == "FLOATING")
+			type = "FLOAT";
+		if (type == "BUFFER")
+			type = "DATABUFFER";
+		if (type == "NESTED")
+			type = "DP_DICT";
+		if (type == "2D_ARRAY")
+			type = "2D_FLOAT_ARRAY";
+		if (type == "ARRAY")
+			type = "FLOAT_ARRAY";
 
-		if (!validateType(m_type))
+		if (!validateType(type))
 		{
-			m_logger->warn("Invalid Datapoint type %s given in select rule for asset '%s'. The rule will have no impact.", m_type.c_str(), m_asset.c_str());
+			m_logger->warn("Invalid Datapoint type %s given in select rule for asset '%s'. The rule will have no impact.", type.c_str(), m_asset.c_str());
+		}
+		if (!type.empty())
+		{
+			m_choice.m_name = type;
+			m_choice.m_mode = DatapointChoice::typeMode(type);
 		}
 	}
 	else if (json.HasMember("datapoints") && json["datapoints"].IsArray())
@@ -52,18 +61,18 @@ SelectRule::SelectRule(const string& service, const string& asset, const Value&
 		{
 			string dpName = dp.GetString();
 			if (isRegexString(dpName))
-				m_regexes.push_back(regex(dpName));
+				m_choice.m_regexes.push_back(new Regex(dpName, m_engine, m_caseInsensitive));
 			else
-				m_datapoints.push_back(dpName);
+				m_choice.m_names.push_back(foldName(dpName));
 		}
 	}
 	else if (json.HasMember("datapoint") && json["datapoint"].IsString())
 	{
 		string dpName = json["datapoint"].GetString();
 		if (isRegexString(dpName))
-			m_regexes.push_back(regex(dpName));
+			m_choice.m_regexes.push_back(new Regex(dpName, m_engine, m_caseInsensitive));
 		else
-			m_datapoints.push_back(dpName);
+			m_choice.m_names.push_back(foldName(dpName));
 	}
 	else
 	{
@@ -76,106 +85,70 @@ SelectRule::SelectRule(const string& service, const string& asset, const Value&
  */
 SelectRule::~SelectRule()
 {
-	// Nothing to be done, the base class destructor 
-	// will do all the work
+	for (auto& re : m_choice.m_regexes)
+		delete re;
 }
 
 /**
  * Execute the map select rule.
  *
- * NB We first match against all the literal names and then,
- * if no match is found we try the regex names. This is faster
- * as regex is relatively slow. We always terminate on the first
- * match to improve performance.
- *
  * @param reading	The reading to process
  * @param out		The vector in which to place the result
  */
 void SelectRule::execute(Reading *reading, vector<Reading *>& out)
 {
-	// Iterate over the datapoints and remove unwanted
+	m_choice.remove<true>(reading, NULL);
+	track(reading->getAssetName());
+	if (reading->getDatapointCount() > 0)
+		out.push_back(reading);
+	else
+		delete reading;
+}
+
+/**
+ * Execute the select rule with a column plan, if given, and
+ * optionally defer the removal of the datapoints that are not
+ * selected. With a column plan the datapoints to select are only
+ * chosen when the schema changes.
+ *
+ * @param reading	The reading to process
+ * @param out		The vector in which to place the result
+ * @param plan		The column plan for the rule or NULL
+ * @param removed	The list of removed datapoints or NULL to delete them
+ */
+void SelectRule::execute(Reading *reading, vector<Reading *>& out, ColumnPlan *plan,
+		vector<Datapoint *> *removed)
+{
 	vector<Datapoint *>& dps = reading->getReadingData();
-	vector<string> rmList;
-	for (auto& dp : dps)
+	if (!plan)
 	{
-		string name = dp->getName();
-		bool found = false;
-		if (!m_type.empty())
-		{
-			const DatapointValue dpv = dp->getData();
-			string dpvStr = dpv.getTypeStr();
-			transform(dpvStr.begin(), dpvStr.end(), dpvStr.begin(), ::toupper);
-			if (dpvStr == m_type)
-			{
-				found = true;
-			}
-			else if (m_type == "NUMBER")
-			{
-				if (dpvStr == "FLOAT" || dpvStr == "INTEGER")
-				{
-					found = true;
-				}
-			}
-			else if (m_type == "NON-NUMERIC")
-			{
-				if (dpvStr != "FLOAT" && dpvStr != "INTEGER")
-				{
-					found = true;
-				}
-			}
-			else if (m_type == "USER_ARRAY")
-			{
-				if (dpvStr == "FLOAT_ARRAY" || dpvStr == "2D_FLOAT_ARRAY" )
-				{
-					found = true;
-				}
-			}
-			if (!found)
-			{
-				rmList.push_back(name);
-			}
-		}
-		else
+		m_choice.remove<true>(reading, removed);
+	}
+	else
+	{
+		if (!plan->sameSchema(dps))
 		{
-			for (auto& datapoint : m_datapoints)
-			{
-				if (datapoint.compare(name) == 0)
-				{
-					found = true;
-					break;
-				}
-			}
-			if (!found)
+			plan->reset(dps.size());
+			for (unsigned int i = 0; i < dps.size(); i++)
 			{
-				// No literal matches found, now try the regex maatches
-				for (auto& re : m_regexes)
-				{
-					if (regex_match(name, re))
-					{
-						found = true;
-						break;
-					}
-				}
-			}
-			if (!found)
-			{
-				rmList.push_back(name);
+				if (dps[i] && !m_choice.chooses(dps[i]))
+					plan->remove(i);
 			}
 		}
+		plan->apply(reading, removed);
 	}
-	for (auto name : rmList)
-	{
-		Datapoint *r =  reading->removeDatapoint(name);
-		delete r;
-	}
-	if (m_tracker)
+	track(reading->getAssetName());
+
+	// Removed datapoints may have been left as NULL entries
+	for (Datapoint *dp : dps)
 	{
-		m_tracker->addAssetTrackingTuple(m_service, reading->getAssetName(), "Filter");
+		if (dp)
+		{
+			out.push_back(reading);
+			return;
+		}
 	}
-	if (reading->getDatapointCount() > 0)
-		out.push_back(reading);
-	else
-		delete reading;
+	delete reading;
 }
 
 /**
@@ -19,8 +19,10 @@ using namespace rapidjson;
  * @param service	The name of the service
  * @param asset	The asset name
  * @param json	JSON iterator
+ * @param engine	The regular expression engine to use
  */
-SplitRule::SplitRule(const string& service, const string& asset, const Value& json) : Rule(service, asset)
+SplitRule::SplitRule(const string& service, const string& asset, const Value& json, RegexEngine engine) :
+	Rule(service, asset, json, engine)
 {
 	string newAssetName = {};
 
@@ -79,7 +81,6 @@ SplitRule::~SplitRule()
  */
 void SplitRule::execute(Reading *reading, vector<Reading *>& out)
 {
-	AssetTracker *tracker = AssetTracker::getAssetTracker();
 	vector<Datapoint *> dps = reading->getReadingData();
 
 	// split key exists
@@ -90,7 +91,7 @@ void SplitRule::execute(Reading *reading, vector<Reading *>& out)
 		{
 			string newAssetName = pair.first;
 			if (m_assetIsRegex)
-				newAssetName = regex_replace(reading->getAssetName(), *m_asset_re, pair.first);
+				newAssetName = m_asset_re->replace(reading->getAssetName(), pair.first);
 			vector<string> splitAssetDPs = pair.second;
 			vector<Datapoint *> newDatapoints;
 			bool isDatapoint = false;
@@ -112,10 +113,7 @@ void SplitRule::execute(Reading *reading, vector<Reading *>& out)
 			{
 				// Add new asset to reading set and asset tracker
 				out.emplace_back(new Reading(newAssetName, newDatapoints));
-				if (tracker)
-				{
-					tracker->addAssetTrackingTuple(m_service, newAssetName, string("Filter"));
-				}
+				track(newAssetName);
 			}
 		}
 	}
@@ -130,10 +128,7 @@ void SplitRule::execute(Reading *reading, vector<Reading *>& out)
 
 			// Add new asset to reading set and asset tracker
 			out.emplace_back(new Reading(newAssetName, dp));
-			if (tracker)
-			{
-				tracker->addAssetTrackingTuple(m_service, newAssetName, string("Filter"));
-			}
+			track(newAssetName);
 		}
 	}
 	delete reading;
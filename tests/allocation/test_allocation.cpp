@@ -0,0 +1,185 @@
+/*
+ * Fledge "asset" filter plugin allocation tests.
+ *
+ * Copyright (c) 2025 Dianomic Systems
+ *
+ * Released under the Apache 2.0 Licence
+ *
+ * Author: Mark Riddoch
+ */
+#include <gtest/gtest.h>
+#include <plugin_api.h>
+#include <config_category.h>
+#include <filter_plugin.h>
+#include <filter.h>
+#include <reading.h>
+#include <reading_set.h>
+#include <stdlib.h>
+#include <new>
+#include <string>
+#include <vector>
+#include "../test_helpers.h"
+
+using namespace std;
+
+/**
+ * Allocations are only counted while the filter is ingesting readings
+ */
+static bool counting = false;
+static unsigned long allocations = 0;
+
+/**
+ * Allocate memory for every form of operator new, counting the
+ * allocation if required
+ */
+static void *allocate(size_t size)
+{
+	if (counting)
+		allocations++;
+	void *p = malloc(size ? size : 1);
+	if (!p)
+		throw bad_alloc();
+	return p;
+}
+
+/**
+ * Release memory for every form of operator delete
+ */
+static void release(void *p)
+{
+	free(p);
+}
+
+void *operator new(size_t size)
+{
+	return allocate(size);
+}
+
+void *operator new[](size_t size)
+{
+	return allocate(size);
+}
+
+void operator delete(void *p) noexcept
+{
+	release(p);
+}
+
+void operator delete[](void *p) noexcept
+{
+	release(p);
+}
+
+void operator delete(void *p, size_t) noexcept
+{
+	release(p);
+}
+
+void operator delete[](void *p, size_t) noexcept
+{
+	release(p);
+}
+
+/**
+ * The output of the filter, the set is kept until the test has
+ * finished counting
+ */
+static void Keep(void *handle, READINGSET *readings)
+{
+	*(ReadingSet **)handle = (ReadingSet *)readings;
+}
+
+/**
+ * Ingest a number of sets of readings into a filter configured with
+ * the rules and return the number of allocations made by the filter
+ * once it has warmed up
+ */
+static unsigned long allocationsPerSet(const char *rules, const vector<string>& assets)
+{
+	PLUGIN_INFORMATION *info = plugin_info();
+	ConfigCategory config("asset", info->config);
+	config.setItemsValueFromDefault();
+	config.setValue("config", rules);
+	config.setValue("enable", "true");
+	ReadingSet *out = NULL;
+	void *handle = plugin_init(&config, (OUTPUT_HANDLE *)&out, Keep);
+
+	unsigned long total = 0;
+	for (int i = 0; i < 10; i++)
+	{
+		ReadingSet *readings = makeReadings(assets);
+		allocations = 0;
+		counting = true;
+		plugin_ingest(handle, (READINGSET *)readings);
+		counting = false;
+		// The first sets warm up the caches and buffers of the filter
+		if (i >= 2)
+			total += allocations;
+		delete out;
+	}
+	plugin_shutdown(handle);
+	return total;
+}
+
+static const char *includeRules = QUOTE({ "rules" : [
+				{ "asset_name" : "pump.*", "action" : "include" }
+			], "defaultAction" : "exclude" });
+
+static const char *excludeRules = QUOTE({ "rules" : [
+				{ "asset_name" : "fan", "action" : "exclude" }
+			] });
+
+static const char *renameRules = QUOTE({ "rules" : [
+				{ "asset_name" : "pump1", "action" : "rename", "new_asset_name" : "motor1" },
+				{ "asset_name" : "fan", "action" : "rename", "new_asset_name" : "blower" }
+			] });
+
+static const char *longRenameRules = QUOTE({ "rules" : [
+				{ "asset_name" : "pump1", "action" : "rename", "new_asset_name" : "Plant1_Slurry_Pump_1" },
+				{ "asset_name" : "fan", "action" : "rename", "new_asset_name" : "Plant1_Extraction_Fan" }
+			] });
+
+static const char *splitRules = QUOTE({ "rules" : [
+				{ "asset_name" : "pump1", "action" : "split" }
+			] });
+
+// A rule that creates readings must be seen to allocate
+TEST(ASSET_ALLOCATION, Counted)
+{
+	ASSERT_GT(allocationsPerSet(splitRules, { "pump1", "fan" }), 0U);
+}
+
+TEST(ASSET_ALLOCATION, Include)
+{
+	ASSERT_EQ(allocationsPerSet(includeRules, { "pump1", "pump2", "fan", "pump1" }), 0U);
+	ASSERT_EQ(allocationsPerSet(includeRules, { "pump1" }), 0U);
+}
+
+TEST(ASSET_ALLOCATION, Exclude)
+{
+	ASSERT_EQ(allocationsPerSet(excludeRules, { "pump1", "fan", "fan", "pump2" }), 0U);
+	ASSERT_EQ(allocationsPerSet(excludeRules, { "fan" }), 0U);
+}
+
+TEST(ASSET_ALLOCATION, Rename)
+{
+	ASSERT_EQ(allocationsPerSet(renameRules, { "pump1", "fan", "pump2", "pump1" }), 0U);
+	ASSERT_EQ(allocationsPerSet(renameRules, { "pump1" }), 0U);
+}
+
+// Reading::setAssetName takes the new name by value and copies it, a
+// name too long to be held within the string object is allocated for
+// the argument and again for the reading. The filter itself allocates
+// nothing more for each reading renamed.
+TEST(ASSET_ALLOCATION, RenameLongNames)
+{
+	ASSERT_EQ(allocationsPerSet(longRenameRules, { "pump1", "fan", "pump2", "pump1" }), 8U * 3 * 2);
+	ASSERT_EQ(allocationsPerSet(longRenameRules, { "pump1" }), 8U * 2);
+	ASSERT_EQ(allocationsPerSet(longRenameRules, { "pump2", "valve" }), 0U);
+}
+
+int main(int argc, char **argv)
+{
+	testing::InitGoogleTest(&argc, argv);
+	return RUN_ALL_TESTS();
+}
@@ -0,0 +1,58 @@
+#include <gtest/gtest.h>
+#include <asset_matcher.h>
+#include <regex>
+#include <string>
+
+using namespace std;
+
+/**
+ * Simple expressions are lowered to the cheapest test
+ */
+TEST(ASSET_MATCHER, Kinds)
+{
+	ASSERT_EQ(AssetMatcher("sensor_.*").kind(), AssetMatcher::PREFIX);
+	ASSERT_EQ(AssetMatcher("^sensor_.*$").kind(), AssetMatcher::PREFIX);
+	ASSERT_EQ(AssetMatcher(".*_temp").kind(), AssetMatcher::SUFFIX);
+	ASSERT_EQ(AssetMatcher(".*pump.*").kind(), AssetMatcher::CONTAINS);
+	ASSERT_EQ(AssetMatcher("(pump|fan)1").kind(), AssetMatcher::SET);
+	ASSERT_EQ(AssetMatcher("pump\\.1").kind(), AssetMatcher::LITERAL);
+	ASSERT_EQ(AssetMatcher("plant\\d").kind(), AssetMatcher::CHARCLASS);
+	ASSERT_EQ(AssetMatcher("plant\\d+").kind(), AssetMatcher::REGEX);
+	ASSERT_EQ(AssetMatcher("a.*b").kind(), AssetMatcher::REGEX);
+	ASSERT_EQ(AssetMatcher("(a)\\1").kind(), AssetMatcher::REGEX);
+	ASSERT_EQ(AssetMatcher(".*").kind(), AssetMatcher::ALL);
+	ASSERT_EQ(AssetMatcher("^(.*)$").kind(), AssetMatcher::ALL);
+	ASSERT_FALSE(AssetMatcher(".*").anyByte());
+	ASSERT_TRUE(AssetMatcher("[\\s\\S]*").anyByte());
+
+	AssetMatcher set("(pump|fan)[12]");
+	ASSERT_EQ(set.kind(), AssetMatcher::SET);
+	ASSERT_EQ(set.literals().size(), 4);
+}
+
+/**
+ * The lowered tests give the same result as the regular expression
+ */
+TEST(ASSET_MATCHER, AgreesWithRegex)
+{
+	const char *patterns[] = {
+		"sensor_.*", ".*_temp", ".*pump.*", "(pump|fan)1", "pump\\.1",
+		"plant\\d", "[\\s\\S]*_temp", "(sensor)?_x{2}", "^$", "[a-c][0-9]{2}", ".*", "[\\s\\S]*"
+	};
+	const char *subjects[] = {
+		"", "sensor_", "sensor_1", "sensor", "sensor_\n", "a_temp", "_temp",
+		"a\n_temp", "pump", "my pump 1", "pump1", "fan1", "fan2", "pump.1",
+		"pumpx1", "plant7", "plantA", "plant77", "_xx", "sensor_xx", "b42", "d42"
+	};
+	for (auto pattern : patterns)
+	{
+		AssetMatcher matcher(pattern);
+		ASSERT_NE(matcher.kind(), AssetMatcher::REGEX) << pattern;
+		regex re(pattern);
+		for (auto subject : subjects)
+		{
+			ASSERT_EQ(matcher.match(subject), regex_match(subject, re))
+				<< pattern << " " << subject;
+		}
+	}
+}
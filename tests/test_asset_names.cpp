@@ -0,0 +1,71 @@
+#include <gtest/gtest.h>
+#include <plugin_api.h>
+#include <config_category.h>
+#include <filter_plugin.h>
+#include <filter.h>
+#include <string.h>
+#include <string>
+#include <rapidjson/document.h>
+#include <reading.h>
+#include <reading_set.h>
+#include "test_helpers.h"
+
+using namespace std;
+using namespace rapidjson;
+
+static const char *namesExclude = QUOTE({ "rules" : [
+				{ "asset_names" : [ "pump1", "site.area.pump", "fan(2)" ], "action" : "exclude" },
+				{ "asset_names" : [ "fan1" ], "action" : "rename", "new_asset_name" : "Fan" },
+				{ "asset_name" : "fan.*", "action" : "datapointmap", "map" : { "speed" : "rpm" } }
+			] });
+
+static const char *namesAndName = QUOTE({ "rules" : [
+				{ "asset_name" : "pump1", "asset_names" : [ "pump2" ], "action" : "exclude" }
+			] });
+
+// The names in asset_names are matched literally and in configuration order
+TEST(ASSET_NAMES, Exclude)
+{
+	PLUGIN_INFORMATION *info = plugin_info();
+	ConfigCategory *config = new ConfigCategory("asset", info->config);
+	ASSERT_NE(config, (ConfigCategory *)NULL);
+	config->setItemsValueFromDefault();
+	config->setValue("config", namesExclude);
+	config->setValue("enable", "true");
+	ReadingSet *outReadings;
+	void *handle = plugin_init(config, &outReadings, Handler);
+
+	plugin_ingest(handle, (READINGSET *)makeReadings({ "pump1", "site.area.pump", "siteXarea.pump", "fan(2)", "fan2", "fan1" }));
+	vector<Reading *> results = outReadings->getAllReadings();
+	ASSERT_EQ(results.size(), 3);
+	ASSERT_STREQ(results[0]->getAssetName().c_str(), "siteXarea.pump");
+	ASSERT_STREQ(results[1]->getAssetName().c_str(), "fan2");
+	ASSERT_STREQ(results[1]->getReadingData()[0]->getName().c_str(), "rpm");
+	ASSERT_STREQ(results[2]->getAssetName().c_str(), "Fan");
+	ASSERT_STREQ(results[2]->getReadingData()[0]->getName().c_str(), "speed");
+	delete outReadings;
+
+	plugin_shutdown(handle);
+	delete config;
+}
+
+// A rule with both asset_name and asset_names is ignored
+TEST(ASSET_NAMES, BothProperties)
+{
+	PLUGIN_INFORMATION *info = plugin_info();
+	ConfigCategory *config = new ConfigCategory("asset", info->config);
+	ASSERT_NE(config, (ConfigCategory *)NULL);
+	config->setItemsValueFromDefault();
+	config->setValue("config", namesAndName);
+	config->setValue("enable", "true");
+	ReadingSet *outReadings;
+	void *handle = plugin_init(config, &outReadings, Handler);
+
+	plugin_ingest(handle, (READINGSET *)makeReadings({ "pump1", "pump2" }));
+	vector<Reading *> results = outReadings->getAllReadings();
+	ASSERT_EQ(results.size(), 2);
+	delete outReadings;
+
+	plugin_shutdown(handle);
+	delete config;
+}
@@ -0,0 +1,267 @@
+#include <gtest/gtest.h>
+#include <plugin_api.h>
+#include <config_category.h>
+#include <filter_plugin.h>
+#include <filter.h>
+#include <string.h>
+#include <string>
+#include <rapidjson/document.h>
+#include <reading.h>
+#include <reading_set.h>
+#include <rules.h>
+#include <rule_index.h>
+#include <match_cache.h>
+#include "test_helpers.h"
+
+using namespace std;
+using namespace rapidjson;
+
+static const char *cacheRename = QUOTE({ "rules" : [
+				{ "asset_name" : "pump1", "action" : "rename", "new_asset_name" : "Pump" },
+				{ "asset_name" : "fan.*", "action" : "exclude" },
+				{ "asset_name" : "Pump", "action" : "datapointmap", "map" : { "speed" : "rpm" } }
+			] });
+
+static const char *cacheExclude = QUOTE({ "rules" : [
+				{ "asset_name" : "pump1", "action" : "exclude" }
+			] });
+
+static const char *cacheInterleaved = QUOTE({ "rules" : [
+				{ "asset_name" : "pump1", "action" : "datapointmap", "map" : { "speed" : "a" } },
+				{ "asset_name" : "pump.*", "action" : "datapointmap", "map" : { "a" : "b" } },
+				{ "asset_name" : "pump1", "action" : "datapointmap", "map" : { "b" : "c" } },
+				{ "asset_name" : "pump\\d", "action" : "datapointmap", "map" : { "c" : "d" } }
+			] });
+
+static const char *cacheUnconditional = QUOTE({ "rules" : [
+				{ "asset_name" : ".*", "action" : "datapointmap", "map" : { "speed" : "a" } },
+				{ "asset_name" : "^.*$", "action" : "datapointmap", "map" : { "a" : "b" } }
+			], "defaultAction" : "exclude" });
+
+// Repeated batches of the same assets are served by the cached match plans
+TEST(ASSET_CACHE, RepeatedBatches)
+{
+	PLUGIN_INFORMATION *info = plugin_info();
+	ConfigCategory *config = new ConfigCategory("asset", info->config);
+	ASSERT_NE(config, (ConfigCategory *)NULL);
+	config->setItemsValueFromDefault();
+	config->setValue("config", cacheRename);
+	config->setValue("enable", "true");
+	ReadingSet *outReadings;
+	void *handle = plugin_init(config, &outReadings, Handler);
+
+	for (int batch = 0; batch < 3; batch++)
+	{
+		plugin_ingest(handle, (READINGSET *)makeReadings({ "pump1", "fan1", "pump2", "pump1", "fan22" }));
+
+		vector<Reading *> results = outReadings->getAllReadings();
+		ASSERT_EQ(results.size(), 3);
+		ASSERT_STREQ(results[0]->getAssetName().c_str(), "Pump");
+		ASSERT_STREQ(results[0]->getReadingData()[0]->getName().c_str(), "rpm");
+		ASSERT_STREQ(results[1]->getAssetName().c_str(), "pump2");
+		ASSERT_STREQ(results[1]->getReadingData()[0]->getName().c_str(), "speed");
+		ASSERT_STREQ(results[2]->getAssetName().c_str(), "Pump");
+		ASSERT_EQ(results[2]->getReadingData()[0]->getData().toInt(), 3);
+		delete outReadings;
+	}
+
+	plugin_shutdown(handle);
+	delete config;
+}
+
+// A reconfiguration must discard the match plans of the previous rules
+TEST(ASSET_CACHE, ReconfigureInvalidates)
+{
+	PLUGIN_INFORMATION *info = plugin_info();
+	ConfigCategory *config = new ConfigCategory("asset", info->config);
+	ASSERT_NE(config, (ConfigCategory *)NULL);
+	config->setItemsValueFromDefault();
+	config->setValue("config", cacheRename);
+	config->setValue("enable", "true");
+	ReadingSet *outReadings;
+	void *handle = plugin_init(config, &outReadings, Handler);
+
+	plugin_ingest(handle, (READINGSET *)makeReadings({ "pump1", "pump2" }));
+	vector<Reading *> results = outReadings->getAllReadings();
+	ASSERT_EQ(results.size(), 2);
+	ASSERT_STREQ(results[0]->getAssetName().c_str(), "Pump");
+	delete outReadings;
+
+	config->setValue("config", cacheExclude);
+	config->setValue("waitForRules", "true");
+	plugin_reconfigure(handle, config->itemsToJSON());
+
+	plugin_ingest(handle, (READINGSET *)makeReadings({ "pump1", "pump2" }));
+	results = outReadings->getAllReadings();
+	ASSERT_EQ(results.size(), 1);
+	ASSERT_STREQ(results[0]->getAssetName().c_str(), "pump2");
+	delete outReadings;
+
+	plugin_shutdown(handle);
+	delete config;
+}
+
+// Literal and regular expression rules must run in configuration order
+TEST(ASSET_CACHE, InterleavedOrder)
+{
+	PLUGIN_INFORMATION *info = plugin_info();
+	ConfigCategory *config = new ConfigCategory("asset", info->config);
+	ASSERT_NE(config, (ConfigCategory *)NULL);
+	config->setItemsValueFromDefault();
+	config->setValue("config", cacheInterleaved);
+	config->setValue("enable", "true");
+	ReadingSet *outReadings;
+	void *handle = plugin_init(config, &outReadings, Handler);
+
+	plugin_ingest(handle, (READINGSET *)makeReadings({ "pump1", "pump2", "pumpX" }));
+	vector<Reading *> results = outReadings->getAllReadings();
+	ASSERT_EQ(results.size(), 3);
+	ASSERT_STREQ(results[0]->getReadingData()[0]->getName().c_str(), "d");
+	ASSERT_STREQ(results[1]->getReadingData()[0]->getName().c_str(), "speed");
+	ASSERT_STREQ(results[2]->getReadingData()[0]->getName().c_str(), "speed");
+	delete outReadings;
+
+	plugin_shutdown(handle);
+	delete config;
+}
+
+// Rules for all assets are run without matching, "." still excludes line breaks
+TEST(ASSET_CACHE, Unconditional)
+{
+	PLUGIN_INFORMATION *info = plugin_info();
+	ConfigCategory *config = new ConfigCategory("asset", info->config);
+	ASSERT_NE(config, (ConfigCategory *)NULL);
+	config->setItemsValueFromDefault();
+	config->setValue("config", cacheUnconditional);
+	config->setValue("enable", "true");
+	ReadingSet *outReadings;
+	void *handle = plugin_init(config, &outReadings, Handler);
+
+	plugin_ingest(handle, (READINGSET *)makeReadings({ "pump1", "fan1", "two\nlines" }));
+	vector<Reading *> results = outReadings->getAllReadings();
+	ASSERT_EQ(results.size(), 2);
+	ASSERT_STREQ(results[0]->getReadingData()[0]->getName().c_str(), "b");
+	ASSERT_STREQ(results[1]->getAssetName().c_str(), "fan1");
+	ASSERT_STREQ(results[1]->getReadingData()[0]->getName().c_str(), "b");
+	delete outReadings;
+
+	plugin_shutdown(handle);
+	delete config;
+}
+
+// A batch in which no reading matches a rule is passed on unchanged
+TEST(ASSET_CACHE, Passthrough)
+{
+	PLUGIN_INFORMATION *info = plugin_info();
+	ConfigCategory *config = new ConfigCategory("asset", info->config);
+	ASSERT_NE(config, (ConfigCategory *)NULL);
+	config->setItemsValueFromDefault();
+	config->setValue("config", cacheExclude);
+	config->setValue("enable", "true");
+	ReadingSet *outReadings;
+	void *handle = plugin_init(config, &outReadings, Handler);
+
+	ReadingSet *untouched = makeReadings({ "pump2", "fan1", "fan1", "pump3" });
+	plugin_ingest(handle, (READINGSET *)untouched);
+	ASSERT_EQ(outReadings, untouched);
+	ASSERT_EQ(outReadings->getAllReadings().size(), 4);
+	delete outReadings;
+
+	ReadingSet *touched = makeReadings({ "pump2", "pump1", "fan1" });
+	plugin_ingest(handle, (READINGSET *)touched);
+	vector<Reading *> results = outReadings->getAllReadings();
+	ASSERT_EQ(results.size(), 2);
+	ASSERT_STREQ(results[0]->getAssetName().c_str(), "pump2");
+	ASSERT_STREQ(results[1]->getAssetName().c_str(), "fan1");
+	delete outReadings;
+
+	plugin_shutdown(handle);
+	delete config;
+}
+
+// Plans are discarded once the cache is full, the results must not change
+TEST(ASSET_CACHE, Eviction)
+{
+	PLUGIN_INFORMATION *info = plugin_info();
+	ConfigCategory *config = new ConfigCategory("asset", info->config);
+	ASSERT_NE(config, (ConfigCategory *)NULL);
+	config->setItemsValueFromDefault();
+	config->setValue("config", cacheRename);
+	config->setValue("enable", "true");
+	ReadingSet *outReadings;
+	void *handle = plugin_init(config, &outReadings, Handler);
+
+	int unique = 0;
+	for (int batch = 0; batch < 25; batch++)
+	{
+		vector<string> assets;
+		for (int i = 0; i < 1000; i++)
+		{
+			string n = to_string(unique++);
+			assets.push_back(i % 2 ? "fan" + n : "pump" + n);
+			if (i % 100 == 0)
+				assets.push_back("pump1");
+		}
+		plugin_ingest(handle, (READINGSET *)makeReadings(assets));
+
+		vector<Reading *> results = outReadings->getAllReadings();
+		ASSERT_EQ(results.size(), 510);
+		for (auto& reading : results)
+		{
+			string asset = reading->getAssetName();
+			ASSERT_NE(asset.compare(0, 3, "fan"), 0);
+			if (asset.compare("Pump") == 0)
+			{
+				ASSERT_STREQ(reading->getReadingData()[0]->getName().c_str(), "rpm");
+			}
+		}
+		delete outReadings;
+	}
+
+	plugin_shutdown(handle);
+	delete config;
+}
+
+// A full cache discards half of its plans, those not reused and the oldest first
+TEST(ASSET_CACHE, EvictionOrder)
+{
+	Document doc;
+	doc.Parse(QUOTE({ "action" : "exclude" }));
+	vector<Rule *> rules;
+	rules.push_back(new ExcludeRule("test", "pump.*", doc));
+	RuleIndex index;
+	index.build(rules);
+	MatchCache cache(index);
+
+	// Every name is seen once, except for one old and one new name
+	for (int i = 0; i < MAX_CACHED_PLANS; i++)
+	{
+		ASSERT_EQ(cache.next("pump" + to_string(i), 0), 0);
+	}
+	ASSERT_EQ(cache.next("pump0", 0), 0);
+	ASSERT_EQ(cache.next("other" + to_string(MAX_CACHED_PLANS - 1), 0), 1);
+	ASSERT_EQ(cache.next("pump" + to_string(MAX_CACHED_PLANS - 1), 0), 0);
+	ASSERT_EQ(cache.size(), MAX_CACHED_PLANS / 2 + 1);
+	ASSERT_TRUE(cache.cached("pump0"));
+	ASSERT_FALSE(cache.cached("pump1"));
+	ASSERT_FALSE(cache.cached("pump" + to_string(MAX_CACHED_PLANS / 2 - 1)));
+	ASSERT_TRUE(cache.cached("pump" + to_string(MAX_CACHED_PLANS / 2 + 1)));
+	ASSERT_TRUE(cache.cached("pump" + to_string(MAX_CACHED_PLANS - 1)));
+
+	// The plans that were kept must be reused to survive the next time
+	for (int i = 0; i < MAX_CACHED_PLANS / 2 - 1; i++)
+	{
+		ASSERT_EQ(cache.next("valve" + to_string(i), 0), 1);
+	}
+	ASSERT_EQ(cache.next("pump" + to_string(MAX_CACHED_PLANS - 1), 0), 0);
+	ASSERT_EQ(cache.size(), MAX_CACHED_PLANS);
+	ASSERT_EQ(cache.next("last", 0), 1);
+	ASSERT_EQ(cache.size(), MAX_CACHED_PLANS / 2 + 1);
+	ASSERT_FALSE(cache.cached("pump0"));
+	ASSERT_TRUE(cache.cached("pump" + to_string(MAX_CACHED_PLANS - 1)));
+	ASSERT_TRUE(cache.cached("valve" + to_string(MAX_CACHED_PLANS / 2 - 2)));
+	ASSERT_TRUE(cache.cached("last"));
+
+	for (auto& rule : rules)
+		delete rule;
+}
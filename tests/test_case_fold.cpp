@@ -0,0 +1,169 @@
+#include <gtest/gtest.h>
+#include <plugin_api.h>
+#include <config_category.h>
+#include <filter_plugin.h>
+#include <filter.h>
+#include <string.h>
+#include <string>
+#include <rapidjson/document.h>
+#include <reading.h>
+#include <reading_set.h>
+#include <case_fold.h>
+#include <rules.h>
+#include <regex>
+#include "test_helpers.h"
+
+using namespace std;
+using namespace rapidjson;
+
+static const char *caseInsensitive = QUOTE({ "rules" : [
+				{ "asset_name" : "Site.Pump", "match" : "literal", "case_insensitive" : true, "action" : "rename", "new_asset_name" : "pump" },
+				{ "asset_names" : [ "FAN1", "Fan2" ], "case_insensitive" : true, "action" : "datapointmap", "map" : { "SPEED" : "rpm", "Temp(\\d)" : "t$1" } },
+				{ "asset_name" : "motor*", "match" : "glob", "case_insensitive" : true, "action" : "remove", "datapoints" : [ "Speed", "volt.*" ] },
+				{ "asset_name" : "valve\\d", "case_insensitive" : true, "action" : "select", "datapoint" : "POSITION" },
+				{ "asset_name" : "Exact", "action" : "exclude" }
+			] });
+
+/**
+ * The word at a time fold must agree with folding each character,
+ * for every byte value and for strings whose length is not a
+ * multiple of the word size
+ */
+TEST(ASSET_CASE_FOLD, Fold)
+{
+	string all;
+	for (int c = 1; c < 256; c++)
+		all += (char)c;
+	for (size_t len = 0; len <= all.length(); len++)
+	{
+		string str = all.substr(all.length() - len);
+		string expected = str;
+		for (auto& c : expected)
+		{
+			if (c >= 'A' && c <= 'Z')
+				c += 'a' - 'A';
+		}
+		ASSERT_EQ(foldCase(str), expected) << len;
+	}
+	ASSERT_EQ(foldCase("Site.PUMP_12/Ünit"), "site.pump_12/Ünit");
+	ASSERT_EQ(foldPattern("Pump\\D[A-Z]\\W"), "pump\\D[a-z]\\W");
+}
+
+// Names are compared with folded names without folding them first
+TEST(ASSET_CASE_FOLD, Compare)
+{
+	ASSERT_TRUE(equalsFolded("Site.PUMP_12/Ünit", "site.pump_12/Ünit"));
+	ASSERT_TRUE(equalsFolded("", ""));
+	ASSERT_FALSE(equalsFolded("Site.PUMP_12", "site.pump_13"));
+	ASSERT_FALSE(equalsFolded("Site.PUMP_12", "site.pump_1"));
+	ASSERT_FALSE(equalsFolded("site", "SITE"));
+	ASSERT_FALSE(equalsFolded("[", "{"));
+	ASSERT_EQ(compareFolded("Pump", "pUMP"), 0);
+	ASSERT_LT(compareFolded("pump", "PUMPS"), 0);
+	ASSERT_GT(compareFolded("Pumpz", "PUMPA"), 0);
+	ASSERT_LT(compareFolded("_", "a"), 0);
+	ASSERT_LT(compareFolded("_", "A"), 0);
+
+	ASSERT_TRUE(canFoldPattern("Pump[A-Z]+[a-f][0-9_]\\D"));
+	ASSERT_FALSE(canFoldPattern("pump[X-c]"));
+	ASSERT_FALSE(canFoldPattern("pump[0-Z]"));
+	ASSERT_FALSE(canFoldPattern("\\x50ump"));
+	ASSERT_TRUE(canFoldPattern("pump[-A][A-]\\[X-c\\]"));
+}
+
+// Asset and datapoint names match ignoring case only in rules that ask for it
+TEST(ASSET_CASE_FOLD, Rules)
+{
+	PLUGIN_INFORMATION *info = plugin_info();
+	ConfigCategory *config = new ConfigCategory("asset", info->config);
+	ASSERT_NE(config, (ConfigCategory *)NULL);
+	config->setItemsValueFromDefault();
+	config->setValue("config", caseInsensitive);
+	config->setValue("enable", "true");
+	ReadingSet *outReadings;
+	void *handle = plugin_init(config, &outReadings, Handler);
+
+	plugin_ingest(handle, (READINGSET *)makeReadings({ "SITE.pump", "fan1", "MotorA",
+				"VALVE7", "Exact", "EXACT" }, { "speed", "TEMP1", "Volts", "position" }));
+	vector<Reading *> results = outReadings->getAllReadings();
+	ASSERT_EQ(results.size(), 5);
+
+	ASSERT_STREQ(results[0]->getAssetName().c_str(), "pump");
+
+	ASSERT_STREQ(results[1]->getAssetName().c_str(), "fan1");
+	vector<Datapoint *>& fan = results[1]->getReadingData();
+	ASSERT_EQ(fan.size(), 4);
+	ASSERT_STREQ(fan[0]->getName().c_str(), "rpm");
+	ASSERT_STREQ(fan[1]->getName().c_str(), "t1");
+
+	ASSERT_STREQ(results[2]->getAssetName().c_str(), "MotorA");
+	vector<Datapoint *>& motor = results[2]->getReadingData();
+	ASSERT_EQ(motor.size(), 2);
+	ASSERT_STREQ(motor[0]->getName().c_str(), "TEMP1");
+	ASSERT_STREQ(motor[1]->getName().c_str(), "position");
+
+	ASSERT_STREQ(results[3]->getAssetName().c_str(), "VALVE7");
+	vector<Datapoint *>& valve = results[3]->getReadingData();
+	ASSERT_EQ(valve.size(), 1);
+	ASSERT_STREQ(valve[0]->getName().c_str(), "position");
+
+	ASSERT_STREQ(results[4]->getAssetName().c_str(), "EXACT");
+	delete outReadings;
+
+	plugin_shutdown(handle);
+	delete config;
+}
+
+// A range that only partly covers the letters ignores case in the same
+// way as the standard library, whichever engine is used and whether
+// the names are matched through the filter or by the rule itself
+TEST(ASSET_CASE_FOLD, PartialRange)
+{
+	const char *patterns[] = { "[A-c]x", "[Z-a]x" };
+	vector<string> assets = { "qx", "Qx", "_x", "ax", "Ax", "zx", "Zx", "bx",
+				"@x", "{x", "~x", "cX", "qy" };
+	for (const char *pattern : patterns)
+	{
+		regex expected(pattern, regex::ECMAScript | regex::icase);
+		for (const char *engine : { "Standard", "Linear" })
+		{
+			Document doc;
+			doc.Parse(QUOTE({ "case_insensitive" : true, "new_asset_name" : "hit" }));
+			RenameRule rule("test", pattern, doc,
+					strcmp(engine, "Linear") == 0 ? LINEAR_REGEX : STANDARD_REGEX);
+			for (auto& asset : assets)
+			{
+				ASSERT_EQ(rule.match(asset), regex_match(asset, expected))
+					<< pattern << " " << engine << " " << asset;
+			}
+
+			PLUGIN_INFORMATION *info = plugin_info();
+			ConfigCategory *config = new ConfigCategory("asset", info->config);
+			config->setItemsValueFromDefault();
+			config->setValue("config", string("{ \"rules\" : [ { \"asset_name\" : \"") + pattern
+					+ "\", \"case_insensitive\" : true, \"action\" : \"rename\", \"new_asset_name\" : \"hit\" } ] }");
+			config->setValue("regexEngine", engine);
+			config->setValue("enable", "true");
+			ReadingSet *outReadings;
+			void *handle = plugin_init(config, &outReadings, Handler);
+
+			// Twice, so that the second set is served by the match cache
+			for (int pass = 0; pass < 2; pass++)
+			{
+				plugin_ingest(handle, (READINGSET *)makeReadings(assets));
+				vector<Reading *> results = outReadings->getAllReadings();
+				ASSERT_EQ(results.size(), assets.size());
+				for (unsigned int i = 0; i < assets.size(); i++)
+				{
+					bool renamed = results[i]->getAssetName().compare("hit") == 0;
+					ASSERT_EQ(renamed, regex_match(assets[i], expected))
+						<< pattern << " " << engine << " " << assets[i];
+				}
+				delete outReadings;
+			}
+
+			plugin_shutdown(handle);
+			delete config;
+		}
+	}
+}
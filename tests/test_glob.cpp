@@ -0,0 +1,77 @@
+#include <gtest/gtest.h>
+#include <plugin_api.h>
+#include <config_category.h>
+#include <filter_plugin.h>
+#include <filter.h>
+#include <string.h>
+#include <string>
+#include <rapidjson/document.h>
+#include <reading.h>
+#include <reading_set.h>
+#include <glob_matcher.h>
+#include <regex>
+#include "test_helpers.h"
+
+using namespace std;
+using namespace rapidjson;
+
+static const char *matchModes = QUOTE({ "rules" : [
+				{ "asset_name" : "site.area.pump", "match" : "literal", "action" : "rename", "new_asset_name" : "pump" },
+				{ "asset_name" : "plant*/line?/temp", "match" : "glob", "action" : "exclude" },
+				{ "asset_name" : "fan\\w", "match" : "regex", "action" : "rename", "new_asset_name" : "Fan" }
+			] });
+
+/**
+ * Glob patterns and their equivalent regular expressions
+ */
+TEST(ASSET_GLOB, Matcher)
+{
+	const char *patterns[] = {
+		"plant*/line?/temp", "*", "a*b*c", "*.*", "\\*x?", "pump", "a*a*a*b", "?"
+	};
+	const char *subjects[] = {
+		"", "plant1/line2/temp", "plant/line2/temp", "plant1/line/temp", "abc",
+		"aXbYc", "acb", "site.area", "*xy", "axy", "pump", "aaaab", "aab", "a\n"
+	};
+	for (auto pattern : patterns)
+	{
+		GlobMatcher glob(pattern);
+		regex re(glob.toRegex());
+		for (auto subject : subjects)
+		{
+			ASSERT_EQ(glob.match(subject), regex_match(subject, re))
+				<< pattern << " " << subject;
+		}
+	}
+	ASSERT_TRUE(GlobMatcher("plant*/line?/temp").match("plantA/line1/temp"));
+	ASSERT_FALSE(GlobMatcher("plant*/line?/temp").match("plantA/line12/temp"));
+	ASSERT_TRUE(GlobMatcher("site.area").isLiteral());
+	ASSERT_FALSE(GlobMatcher("site.*").isLiteral());
+}
+
+// The match property overrides the check for special characters
+TEST(ASSET_GLOB, MatchModes)
+{
+	PLUGIN_INFORMATION *info = plugin_info();
+	ConfigCategory *config = new ConfigCategory("asset", info->config);
+	ASSERT_NE(config, (ConfigCategory *)NULL);
+	config->setItemsValueFromDefault();
+	config->setValue("config", matchModes);
+	config->setValue("enable", "true");
+	ReadingSet *outReadings;
+	void *handle = plugin_init(config, &outReadings, Handler);
+
+	plugin_ingest(handle, (READINGSET *)makeReadings({ "site.area.pump", "siteXareaXpump",
+				"plant4/line1/temp", "plant4/line1/speed", "fanA", "fan" }));
+	vector<Reading *> results = outReadings->getAllReadings();
+	ASSERT_EQ(results.size(), 5);
+	ASSERT_STREQ(results[0]->getAssetName().c_str(), "pump");
+	ASSERT_STREQ(results[1]->getAssetName().c_str(), "siteXareaXpump");
+	ASSERT_STREQ(results[2]->getAssetName().c_str(), "plant4/line1/speed");
+	ASSERT_STREQ(results[3]->getAssetName().c_str(), "Fan");
+	ASSERT_STREQ(results[4]->getAssetName().c_str(), "fan");
+	delete outReadings;
+
+	plugin_shutdown(handle);
+	delete config;
+}
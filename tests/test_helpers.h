@@ -0,0 +1,62 @@
+#ifndef _TEST_HELPERS_H
+#define _TEST_HELPERS_H
+/*
+ * Fledge "asset" filter plugin unit test helpers.
+ *
+ * Copyright (c) 2025 Dianomic Systems
+ *
+ * Released under the Apache 2.0 Licence
+ *
+ * Author: Mark Riddoch
+ */
+#include <plugin_api.h>
+#include <config_category.h>
+#include <filter_plugin.h>
+#include <filter.h>
+#include <reading.h>
+#include <reading_set.h>
+#include <string>
+#include <vector>
+
+extern "C"
+{
+	PLUGIN_INFORMATION *plugin_info();
+	void plugin_ingest(void *handle,
+					   READINGSET *readingSet);
+	PLUGIN_HANDLE plugin_init(ConfigCategory *config,
+							  OUTPUT_HANDLE *outHandle,
+							  OUTPUT_STREAM output);
+	void plugin_shutdown(PLUGIN_HANDLE handle);
+	void plugin_reconfigure(void *handle, const std::string& newConfig);
+
+	extern void Handler(void *handle, READINGSET *readings);
+};
+
+/**
+ * Create a set of readings, one for each of the asset names, each with
+ * the given datapoints. The datapoints hold integer values that are
+ * numbered in turn across the whole set.
+ *
+ * @param assets	The asset name of each reading
+ * @param datapoints	The names of the datapoints of each reading
+ * @param first		The value of the first datapoint
+ */
+static inline ReadingSet *makeReadings(const std::vector<std::string>& assets,
+		const std::vector<std::string>& datapoints = { "speed" },
+		long first = 0)
+{
+	std::vector<Reading *> readings;
+	long value = first;
+	for (auto& asset : assets)
+	{
+		std::vector<Datapoint *> dps;
+		for (auto& name : datapoints)
+		{
+			DatapointValue dpv(value++);
+			dps.push_back(new Datapoint(name, dpv));
+		}
+		readings.push_back(new Reading(asset, dps));
+	}
+	return new ReadingSet(&readings);
+}
+#endif
@@ -0,0 +1,105 @@
+#include <gtest/gtest.h>
+#include <plugin_api.h>
+#include <config_category.h>
+#include <filter_plugin.h>
+#include <filter.h>
+#include <string.h>
+#include <string>
+#include <rapidjson/document.h>
+#include <reading.h>
+#include <reading_set.h>
+#include "test_helpers.h"
+
+using namespace std;
+using namespace rapidjson;
+
+static const char *deadRules = QUOTE({ "rules" : [
+				{ "asset_name" : "pump", "action" : "rename", "new_asset_name" : "motor" },
+				{ "asset_name" : "pump", "action" : "remove", "datapoint" : "a" },
+				{ "asset_name" : "PUMP", "case_insensitive" : true, "action" : "remove", "datapoint" : "b" },
+				{ "asset_name" : "motor", "action" : "remove", "datapoint" : "c" }
+			] });
+
+static const char *hoistedExclude = QUOTE({ "rules" : [
+				{ "asset_name" : "pump1", "action" : "remove", "datapoint" : "a" },
+				{ "asset_name" : "pump.*", "action" : "datapointmap", "map" : { "a" : "x" } },
+				{ "asset_name" : "valve", "action" : "rename", "new_asset_name" : "pump2" },
+				{ "asset_name" : "pump2", "action" : "select", "datapoints" : [ "x", "b" ] },
+				{ "asset_name" : "fan", "action" : "flatten" },
+				{ "asset_name" : "pump2", "action" : "exclude" },
+				{ "asset_name" : "pump1", "action" : "exclude" }
+			] });
+
+static const char *renamedBack = QUOTE({ "rules" : [
+				{ "asset_name" : "pump", "action" : "rename", "new_asset_name" : "motor" },
+				{ "asset_name" : "motor(.*)", "action" : "rename", "new_asset_name" : "pump$1" },
+				{ "asset_name" : "pump", "action" : "remove", "datapoint" : "a" }
+			] });
+
+/**
+ * Ingest a reading with datapoints a, b and c for each asset and
+ * describe the results as the asset name followed by the names of
+ * the datapoints
+ */
+static vector<string> ingest(const char *rules, const vector<string>& assets)
+{
+	PLUGIN_INFORMATION *info = plugin_info();
+	ConfigCategory *config = new ConfigCategory("asset", info->config);
+	config->setItemsValueFromDefault();
+	config->setValue("config", rules);
+	config->setValue("enable", "true");
+	ReadingSet *outReadings;
+	void *handle = plugin_init(config, &outReadings, Handler);
+
+	vector<Reading *> readings;
+	for (auto& asset : assets)
+	{
+		long value = 0;
+		vector<Datapoint *> dps;
+		for (auto name : { "a", "b", "c" })
+		{
+			DatapointValue dpv(value++);
+			dps.push_back(new Datapoint(name, dpv));
+		}
+		readings.push_back(new Reading(asset, dps));
+	}
+	plugin_ingest(handle, (READINGSET *)new ReadingSet(&readings));
+
+	vector<string> results;
+	for (auto& reading : outReadings->getAllReadings())
+	{
+		string result = reading->getAssetName() + ":";
+		for (auto& dp : reading->getReadingData())
+			result += " " + dp->getName();
+		results.push_back(result);
+	}
+	delete outReadings;
+
+	plugin_shutdown(handle);
+	delete config;
+	return results;
+}
+
+// Rules for assets that an earlier rule always renames are never executed
+TEST(ASSET_OPTIMISER, DeadRules)
+{
+	vector<string> results = ingest(deadRules, { "pump", "PUMP", "motor" });
+	vector<string> expected = { "motor: a b", "PUMP: a c", "motor: a b" };
+	ASSERT_EQ(results, expected);
+}
+
+// Excludes are executed before the transforms of the readings they exclude
+TEST(ASSET_OPTIMISER, HoistedExclude)
+{
+	vector<string> results = ingest(hoistedExclude, { "pump1", "pump2", "pump3", "valve", "fan" });
+	vector<string> expected = { "pump3: x b c", "fan: a b c" };
+	ASSERT_EQ(results, expected);
+}
+
+// A rule is kept if a later rename may give a reading its asset name again
+TEST(ASSET_OPTIMISER, RenamedBack)
+{
+	vector<string> results = ingest(renamedBack, { "pump", "motor2" });
+	vector<string> expected = { "pump: b c", "pump2: a b c" };
+	ASSERT_EQ(results, expected);
+}
@@ -0,0 +1,181 @@
+#include <gtest/gtest.h>
+#include <plugin_api.h>
+#include <config_category.h>
+#include <filter_plugin.h>
+#include <filter.h>
+#include <string.h>
+#include <string>
+#include <rapidjson/document.h>
+#include <reading.h>
+#include <reading_set.h>
+#include <worker_pool.h>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include "test_helpers.h"
+
+using namespace std;
+using namespace rapidjson;
+
+static const char *parallelRules = QUOTE({ "rules" : [
+				{ "asset_name" : "pump(.*)", "action" : "rename", "new_asset_name" : "Pump$1" },
+				{ "asset_name" : "fan.*", "action" : "exclude" },
+				{ "asset_name" : "motor.*", "action" : "split" },
+				{ "asset_name" : "Pump.*", "action" : "datapointmap", "map" : { "speed" : "rpm" } },
+				{ "asset_name" : "valve.*", "action" : "remove", "datapoint" : "level" }
+			] });
+
+static const char *skewedRules = QUOTE({ "rules" : [
+				{ "asset_name" : "wide.*", "action" : "split" },
+				{ "asset_name" : "wide.*", "action" : "flatten" },
+				{ "asset_name" : "narrow", "action" : "include" }
+			], "defaultAction" : "exclude" });
+
+static const char *assets[] = { "pump1", "fan1", "motor1", "valve1", "pump2", "other", "motor2" };
+
+/**
+ * Create a set of readings of a mix of the assets
+ */
+static ReadingSet *makeMixedReadings(int count)
+{
+	vector<Reading *> readings;
+	for (int i = 0; i < count; i++)
+	{
+		vector<Datapoint *> dps;
+		DatapointValue speed((long)i);
+		dps.push_back(new Datapoint("speed", speed));
+		DatapointValue level((double)i);
+		dps.push_back(new Datapoint("level", level));
+		readings.push_back(new Reading(assets[(i * 7 + i / 3) % 7], dps));
+	}
+	return new ReadingSet(&readings);
+}
+
+/**
+ * Create a set of readings in which a few readings are wide and
+ * the remainder narrow
+ */
+static ReadingSet *makeSkewedReadings(int count)
+{
+	vector<Reading *> readings;
+	for (int i = 0; i < count; i++)
+	{
+		vector<Datapoint *> dps;
+		int width = i % 97 == 5 ? 500 : 2;
+		for (int j = 0; j < width; j++)
+		{
+			DatapointValue value((long)(i * 1000 + j));
+			dps.push_back(new Datapoint("dp" + to_string(j), value));
+		}
+		readings.push_back(new Reading(width > 2 ? "wide" + to_string(i) : "narrow", dps));
+	}
+	return new ReadingSet(&readings);
+}
+
+/**
+ * Describe the results of the filter, one line per reading
+ */
+static vector<string> describe(ReadingSet *readings)
+{
+	vector<string> result;
+	for (auto& reading : readings->getAllReadings())
+	{
+		string line = reading->getAssetName();
+		for (auto& dp : reading->getReadingData())
+			line += " " + dp->getName() + "=" + dp->getData().toString();
+		result.push_back(line);
+	}
+	return result;
+}
+
+/**
+ * Run a batch of readings through a filter with the given number of
+ * worker threads
+ */
+static vector<string> run(const char *threads, int count,
+				const char *rules = parallelRules,
+				ReadingSet *(*make)(int) = makeMixedReadings)
+{
+	PLUGIN_INFORMATION *info = plugin_info();
+	ConfigCategory *config = new ConfigCategory("asset", info->config);
+	config->setItemsValueFromDefault();
+	config->setValue("config", rules);
+	config->setValue("enable", "true");
+	config->setValue("workerThreads", threads);
+	config->setValue("parallelBatchSize", "100");
+	ReadingSet *outReadings;
+	void *handle = plugin_init(config, &outReadings, Handler);
+
+	vector<string> results;
+	for (int batch = 0; batch < 3; batch++)
+	{
+		plugin_ingest(handle, (READINGSET *)make(count));
+		vector<string> lines = describe(outReadings);
+		results.insert(results.end(), lines.begin(), lines.end());
+		delete outReadings;
+	}
+
+	plugin_shutdown(handle);
+	delete config;
+	return results;
+}
+
+// A large set of readings divided between worker threads gives the
+// same results, in the same order, as a single thread
+TEST(ASSET_PARALLEL, SameResults)
+{
+	vector<string> serial = run("1", 1003);
+	vector<string> parallel = run("4", 1003);
+	ASSERT_GT(serial.size(), 3000);
+	ASSERT_EQ(parallel.size(), serial.size());
+	for (size_t i = 0; i < serial.size(); i++)
+		ASSERT_EQ(parallel[i], serial[i]);
+}
+
+// Sets of readings smaller than the parallel batch size, and sets
+// with fewer readings than threads, are processed correctly
+TEST(ASSET_PARALLEL, SmallBatches)
+{
+	ASSERT_EQ(run("4", 50), run("1", 50));
+	ASSERT_EQ(run("8", 1), run("1", 1));
+	ASSERT_EQ(run("64", 101), run("1", 101));
+}
+
+// Readings that produce many results do not change the order of the
+// results when the ranges of readings are stolen between threads
+TEST(ASSET_PARALLEL, SkewedBatches)
+{
+	vector<string> serial = run("1", 1000, skewedRules, makeSkewedReadings);
+	vector<string> parallel = run("4", 1000, skewedRules, makeSkewedReadings);
+	ASSERT_GT(serial.size(), 3 * 5000);
+	ASSERT_EQ(parallel, serial);
+}
+
+// Every task of a job is run exactly once, even if a few of the
+// tasks take much longer than the others
+TEST(ASSET_PARALLEL, WorkStealing)
+{
+	WorkerPool pool(4);
+	ASSERT_EQ(pool.size(), 4);
+	for (int job = 0; job < 20; job++)
+	{
+		vector<atomic<int> > runs(100);
+		vector<unsigned int> workers(100);
+		pool.run(100, [&runs, &workers](unsigned int worker, unsigned int task) {
+				if (task < 3)
+					this_thread::sleep_for(chrono::milliseconds(5));
+				runs[task]++;
+				workers[task] = worker;
+			});
+		for (unsigned int task = 0; task < runs.size(); task++)
+			ASSERT_EQ(runs[task], 1);
+		// The first worker is held up by the slow tasks, the
+		// others take the remainder of its share
+		unsigned int stolen = 0;
+		for (unsigned int task = 3; task < 25; task++)
+			if (workers[task] != 0)
+				stolen++;
+		ASSERT_GT(stolen, 0);
+	}
+	pool.run(0, [](unsigned int, unsigned int) { });
+}
@@ -0,0 +1,67 @@
+#include <gtest/gtest.h>
+#include <pattern_set.h>
+#include <regex>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+static const char *patterns[] = {
+	"pump\\d",
+	"pump.*",
+	"fan[0-9]+_(speed|rpm)",
+	"^sensor[A-Fa-f]{2,3}$",
+	"(?:ab|cd)*e?",
+	"[^x]*x",
+	"a.c",
+	"\\w+\\.\\w+",
+	"(a|ab)(c|bcd)",
+	"x{0}y",
+	""
+};
+
+static const char *subjects[] = {
+	"", "pump", "pump1", "pump12", "pumpA", "fan1_speed", "fan12_rpm",
+	"fan_rpm", "sensorAB", "sensorabc", "sensorABCD", "abcde", "cdab",
+	"abe", "yyyx", "xx", "abc", "a\nc", "motor.temp", "abcd", "y", "x"
+};
+
+/**
+ * Every pattern in the set must report exactly the same result as
+ * matching it individually with std::regex
+ */
+TEST(PATTERN_SET, AgreesWithRegex)
+{
+	PatternSet set;
+	unsigned int n = sizeof(patterns) / sizeof(patterns[0]);
+	for (unsigned int i = 0; i < n; i++)
+		ASSERT_TRUE(set.add(patterns[i], i)) << patterns[i];
+	set.compile();
+	ASSERT_EQ(set.size(), n);
+
+	for (auto subject : subjects)
+	{
+		vector<unsigned int> expected;
+		for (unsigned int i = 0; i < n; i++)
+		{
+			if (regex_match(subject, regex(patterns[i])))
+				expected.push_back(i);
+		}
+		vector<unsigned int> ids;
+		set.match(subject, ids);
+		ASSERT_EQ(ids, expected) << subject;
+	}
+}
+
+/**
+ * Syntax the automaton cannot represent is rejected so the caller
+ * can match it by other means
+ */
+TEST(PATTERN_SET, RejectsUnsupported)
+{
+	PatternSet set;
+	ASSERT_FALSE(set.add("(a)\\1", 0));
+	ASSERT_FALSE(set.add("a(?=b)", 1));
+	ASSERT_FALSE(set.add("\\bpump", 2));
+	ASSERT_TRUE(set.empty());
+}
@@ -0,0 +1,239 @@
+#include <gtest/gtest.h>
+#include <plugin_api.h>
+#include <config_category.h>
+#include <filter_plugin.h>
+#include <filter.h>
+#include <string.h>
+#include <string>
+#include <rapidjson/document.h>
+#include <reading.h>
+#include <reading_set.h>
+#include <rules.h>
+#include <rule_index.h>
+#include <pipeline.h>
+#include <ring_buffer.h>
+#include <thread>
+#include "test_helpers.h"
+
+using namespace std;
+using namespace rapidjson;
+
+static const char *pipelineRules = QUOTE({ "rules" : [
+				{ "asset_name" : "pump(.*)", "action" : "rename", "new_asset_name" : "Pump$1" },
+				{ "asset_name" : "fan.*", "action" : "exclude" },
+				{ "asset_name" : "motor.*", "action" : "split" },
+				{ "asset_name" : "Pump.*", "action" : "datapointmap", "map" : { "speed" : "rpm" } },
+				{ "asset_name" : "valve.*", "action" : "remove", "datapoint" : "level" },
+				{ "asset_name" : "Pump1", "action" : "remove", "datapoint" : "level" },
+				{ "asset_name" : "motor1_speed", "action" : "rename", "new_asset_name" : "motor1" },
+				{ "asset_name" : "other", "action" : "flatten" }
+			], "defaultAction" : "include" });
+
+static const char *pipelineRenamed = QUOTE({ "rules" : [
+				{ "asset_name" : ".*", "action" : "rename", "new_asset_name" : "renamed" },
+				{ "asset_name" : "renamed", "action" : "remove", "datapoint" : "level" },
+				{ "asset_name" : "renamed", "action" : "datapointmap", "map" : { "speed" : "rpm" } }
+			] });
+
+static const char *assets[] = { "pump1", "fan1", "motor1", "valve1", "pump2", "other", "motor2", "unknown" };
+
+/**
+ * Create a set of readings of a mix of the assets
+ */
+static ReadingSet *makeMixedReadings(int count, int batch)
+{
+	vector<Reading *> readings;
+	for (int i = 0; i < count; i++)
+	{
+		vector<Datapoint *> dps;
+		DatapointValue speed((long)(batch * 1000 + i));
+		dps.push_back(new Datapoint("speed", speed));
+		DatapointValue level((double)i);
+		dps.push_back(new Datapoint("level", level));
+		readings.push_back(new Reading(assets[(i * 5 + i / 3) % 8], dps));
+	}
+	return new ReadingSet(&readings);
+}
+
+/**
+ * The output of the filter, describe each reading and discard the
+ * readings. The results of a pipeline are passed on before ingest
+ * returns, just as they are without a pipeline.
+ */
+static void Collect(void *handle, READINGSET *readings)
+{
+	vector<string> *results = (vector<string> *)handle;
+	for (auto& reading : ((ReadingSet *)readings)->getAllReadings())
+	{
+		string line = reading->getAssetName();
+		for (auto& dp : reading->getReadingData())
+			line += " " + dp->getName() + "=" + dp->getData().toString();
+		results->push_back(line);
+	}
+	delete (ReadingSet *)readings;
+}
+
+/**
+ * Run a number of sets of readings through a filter divided into the
+ * given number of stages, optionally reconfiguring the filter part way
+ */
+static vector<string> run(const char *stages, int batches, const char *reconfigure = NULL)
+{
+	PLUGIN_INFORMATION *info = plugin_info();
+	ConfigCategory *config = new ConfigCategory("asset", info->config);
+	config->setItemsValueFromDefault();
+	config->setValue("config", pipelineRules);
+	config->setValue("enable", "true");
+	config->setValue("pipelineStages", stages);
+	vector<string> results;
+	void *handle = plugin_init(config, &results, Collect);
+
+	for (int batch = 0; batch < batches; batch++)
+	{
+		if (reconfigure && batch == batches / 2)
+		{
+			config->setValue("config", reconfigure);
+			config->setValue("waitForRules", "true");
+			plugin_reconfigure(handle, config->itemsToJSON());
+		}
+		plugin_ingest(handle, (READINGSET *)makeMixedReadings(50, batch));
+	}
+
+	plugin_shutdown(handle);
+	delete config;
+	return results;
+}
+
+// Values pass through a ring buffer in order, however often the
+// producer or the consumer has to wait
+TEST(ASSET_PIPELINE, RingBuffer)
+{
+	RingBuffer<long> ring(5);
+	ASSERT_EQ(ring.capacity(), 8);
+	ASSERT_EQ(ring.size(), 0);
+	thread producer([&ring]() {
+		for (long i = 1; i <= 100000; i++)
+			ring.push(i);
+		ring.push(0);
+	});
+	long expected = 1, value;
+	while ((value = ring.pop()) != 0)
+	{
+		if (value != expected)
+			break;
+		expected++;
+	}
+	producer.join();
+	ASSERT_EQ(value, 0);
+	ASSERT_EQ(expected, 100001);
+}
+
+// The results of a pipeline are the same, and in the same order, as
+// the results of running all the rules at once
+TEST(ASSET_PIPELINE, SameResults)
+{
+	vector<string> serial = run("1", 40);
+	ASSERT_GT(serial.size(), 40 * 40);
+	ASSERT_EQ(run("2", 40), serial);
+	ASSERT_EQ(run("3", 40), serial);
+	ASSERT_EQ(run("16", 40), serial);
+}
+
+// The sets of readings in a pipeline are passed on before the sets
+// processed by the rules of a new configuration
+TEST(ASSET_PIPELINE, Reconfigure)
+{
+	vector<string> serial = run("1", 20, pipelineRenamed);
+	vector<string> pipelined = run("4", 20, pipelineRenamed);
+	ASSERT_EQ(pipelined, serial);
+	ASSERT_EQ(pipelined.back().compare(0, 7, "renamed"), 0);
+}
+
+// The results of each set of readings are passed on before ingest
+// returns, as they would be without a pipeline
+TEST(ASSET_PIPELINE, Synchronous)
+{
+	PLUGIN_INFORMATION *info = plugin_info();
+	ConfigCategory *config = new ConfigCategory("asset", info->config);
+	config->setItemsValueFromDefault();
+	config->setValue("config", pipelineRules);
+	config->setValue("enable", "true");
+	vector<string> serial;
+	void *serialHandle = plugin_init(config, &serial, Collect);
+	config->setValue("pipelineStages", "4");
+	vector<string> pipelined;
+	void *pipelinedHandle = plugin_init(config, &pipelined, Collect);
+
+	for (int batch = 0; batch < 20; batch++)
+	{
+		int count = batch * 7 + 1;
+		plugin_ingest(serialHandle, (READINGSET *)makeMixedReadings(count, batch));
+		plugin_ingest(pipelinedHandle, (READINGSET *)makeMixedReadings(count, batch));
+		ASSERT_EQ(pipelined, serial);
+	}
+	ASSERT_GT(serial.size(), 20 * 40);
+
+	plugin_shutdown(serialHandle);
+	plugin_shutdown(pipelinedHandle);
+	delete config;
+}
+
+static const char *fusedRules[] = {
+	QUOTE({ "action" : "remove", "datapoint" : "a" }),
+	QUOTE({ "action" : "datapointmap", "map" : { "b" : "x" } }),
+	QUOTE({ "action" : "select", "datapoints" : [ "x", "c" ] }),
+	QUOTE({ "action" : "rename", "new_asset_name" : "motor" })
+};
+
+// The stages are divided between the ops that are dispatched, the
+// rules fused into a single op count as one and no stage is empty
+TEST(ASSET_PIPELINE, FusedStages)
+{
+	vector<Rule *> rules;
+	for (int i = 0; i < 3; i++)
+	{
+		Document doc;
+		doc.Parse(fusedRules[i]);
+		if (i == 0)
+			rules.push_back(new RemoveRule("test", "pump", doc));
+		else if (i == 1)
+			rules.push_back(new DatapointMapRule("test", "pump", doc));
+		else
+			rules.push_back(new SelectRule("test", "pump", doc));
+	}
+	Document doc;
+	doc.Parse(fusedRules[3]);
+	rules.push_back(new RenameRule("test", "pump", doc));
+	RuleIndex index;
+	index.build(rules);
+
+	for (unsigned int stages = 2; stages <= 4; stages++)
+	{
+		Pipeline pipeline(index, rules, NULL, stages);
+		ASSERT_EQ(pipeline.stages(), 2);
+
+		vector<string> assets(40, "pump");
+		assets[7] = "fan";
+		ReadingSet *readings = makeReadings(assets, { "a", "b", "c", "d" });
+		pipeline.ingest((READINGSET *)readings);
+		const vector<Reading *>& results = readings->getAllReadings();
+		ASSERT_EQ(results.size(), 40);
+		for (unsigned int i = 0; i < results.size(); i++)
+		{
+			if (i == 7)
+			{
+				ASSERT_STREQ(results[i]->getAssetName().c_str(), "fan");
+				ASSERT_EQ(results[i]->getDatapointCount(), 4);
+				continue;
+			}
+			ASSERT_STREQ(results[i]->getAssetName().c_str(), "motor");
+			ASSERT_EQ(results[i]->getDatapointCount(), 2);
+			ASSERT_STREQ(results[i]->getReadingData()[0]->getName().c_str(), "x");
+			ASSERT_STREQ(results[i]->getReadingData()[1]->getName().c_str(), "c");
+		}
+		delete readings;
+	}
+
+	for (auto& rule : rules)
+		delete rule;
+}
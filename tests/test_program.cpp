@@ -0,0 +1,488 @@
+#include <gtest/gtest.h>
+#include <plugin_api.h>
+#include <config_category.h>
+#include <filter_plugin.h>
+#include <filter.h>
+#include <string.h>
+#include <string>
+#include <rapidjson/document.h>
+#include <reading.h>
+#include <reading_set.h>
+#include <rules.h>
+#include <rule_index.h>
+#include <match_cache.h>
+#include <rule_program.h>
+#include "test_helpers.h"
+
+using namespace std;
+using namespace rapidjson;
+
+static const char *programOrder = QUOTE({ "rules" : [
+				{ "asset_name" : "pump", "action" : "split" },
+				{ "asset_name" : "pump_b", "action" : "exclude" },
+				{ "asset_name" : "pump_.*", "action" : "datapointmap", "map" : { "a" : "x" } },
+				{ "asset_name" : "pump_a", "action" : "rename", "new_asset_name" : "first" }
+			] });
+
+// Each reading produced by a rule passes through the remaining rules before the next
+TEST(ASSET_PROGRAM, Order)
+{
+	PLUGIN_INFORMATION *info = plugin_info();
+	ConfigCategory *config = new ConfigCategory("asset", info->config);
+	ASSERT_NE(config, (ConfigCategory *)NULL);
+	config->setItemsValueFromDefault();
+	config->setValue("config", programOrder);
+	config->setValue("enable", "true");
+	ReadingSet *outReadings;
+	void *handle = plugin_init(config, &outReadings, Handler);
+
+	for (int batch = 0; batch < 2; batch++)
+	{
+		plugin_ingest(handle, (READINGSET *)makeReadings({ "pump", "other", "pump" }, { "a", "b", "c" }));
+		vector<Reading *> results = outReadings->getAllReadings();
+		ASSERT_EQ(results.size(), 5);
+		const char *expected[] = { "first", "pump_c", "other", "first", "pump_c" };
+		for (int i = 0; i < 5; i++)
+		{
+			ASSERT_STREQ(results[i]->getAssetName().c_str(), expected[i]);
+		}
+		ASSERT_STREQ(results[0]->getReadingData()[0]->getName().c_str(), "x");
+		ASSERT_STREQ(results[1]->getReadingData()[0]->getName().c_str(), "c");
+		ASSERT_EQ(results[2]->getDatapointCount(), 3);
+		delete outReadings;
+	}
+
+	plugin_shutdown(handle);
+	delete config;
+}
+
+static const char *programGrouped = QUOTE({ "rules" : [
+				{ "asset_name" : "pump1", "action" : "rename", "new_asset_name" : "fan9" },
+				{ "asset_name" : "pump2", "action" : "exclude" },
+				{ "asset_name" : "fan.*", "action" : "datapointmap", "map" : { "a" : "x" } },
+				{ "asset_name" : "fan9", "action" : "remove", "datapoint" : "b" },
+				{ "asset_name" : "motor", "action" : "select", "datapoint" : "z" }
+			], "defaultAction" : "flatten" });
+
+// Running a batch grouped by asset gives the same results as one reading at a time
+TEST(ASSET_PROGRAM, Grouped)
+{
+	PLUGIN_INFORMATION *info = plugin_info();
+	ConfigCategory *config = new ConfigCategory("asset", info->config);
+	ASSERT_NE(config, (ConfigCategory *)NULL);
+	config->setItemsValueFromDefault();
+	config->setValue("config", programGrouped);
+	config->setValue("enable", "true");
+	ReadingSet *outReadings;
+	void *handle = plugin_init(config, &outReadings, Handler);
+
+	vector<string> assets = { "pump1", "fan1", "pump2", "other", "pump1", "motor", "fan1", "pump2", "other" };
+	vector<string> expected;
+	for (unsigned int i = 0; i < assets.size(); i++)
+	{
+		plugin_ingest(handle, (READINGSET *)makeReadings({ assets[i] }, { "a", "b", "c" }, 3 * i));
+		for (auto& reading : outReadings->getAllReadings())
+			expected.push_back(reading->toJSON());
+		delete outReadings;
+	}
+	ASSERT_EQ(expected.size(), 6);
+
+	plugin_ingest(handle, (READINGSET *)makeReadings(assets, { "a", "b", "c" }));
+	vector<Reading *> results = outReadings->getAllReadings();
+	ASSERT_EQ(results.size(), expected.size());
+	for (unsigned int i = 0; i < results.size(); i++)
+	{
+		ASSERT_EQ(results[i]->toJSON(), expected[i]) << i;
+	}
+	ASSERT_STREQ(results[0]->getAssetName().c_str(), "fan9");
+	ASSERT_STREQ(results[1]->getAssetName().c_str(), "fan1");
+	ASSERT_STREQ(results[2]->getAssetName().c_str(), "other");
+	delete outReadings;
+
+	plugin_shutdown(handle);
+	delete config;
+}
+
+static const char *programColumns = QUOTE({ "rules" : [
+				{ "asset_name" : "pump.*", "action" : "remove", "type" : "string" },
+				{ "asset_name" : "pump1", "action" : "datapointmap", "map" : { "a" : "x", "c(.*)" : "y$1" } },
+				{ "asset_name" : "pump.*", "action" : "select", "datapoints" : [ "x", "b", "y.*" ] },
+				{ "asset_name" : "fan", "action" : "remove", "datapoints" : [ "a", "d" ] }
+			] });
+
+/**
+ * Create readings whose datapoints differ in name, type and order
+ */
+static ReadingSet *makeMixed(const vector<string>& assets, int first)
+{
+	vector<Reading *> readings;
+	for (int i = 0; i < (int)assets.size(); i++)
+	{
+		int n = first + i;
+		DatapointValue a((long)n), b((double)n), c(string("c")), d((long)n), s(string("b"));
+		vector<Datapoint *> dps;
+		if (n % 3 == 0)
+		{
+			dps.push_back(new Datapoint("a", a));
+			dps.push_back(new Datapoint("b", b));
+			dps.push_back(new Datapoint("c", c));
+		}
+		else if (n % 3 == 1)
+		{
+			dps.push_back(new Datapoint("b", s));
+			dps.push_back(new Datapoint("a", a));
+		}
+		else
+		{
+			dps.push_back(new Datapoint("a", a));
+			dps.push_back(new Datapoint("c1", b));
+			dps.push_back(new Datapoint("d", d));
+		}
+		readings.push_back(new Reading(assets[i], dps));
+	}
+	return new ReadingSet(&readings);
+}
+
+// Column plans give the same results as matching each datapoint when the schema changes
+TEST(ASSET_PROGRAM, Columns)
+{
+	PLUGIN_INFORMATION *info = plugin_info();
+	ConfigCategory *config = new ConfigCategory("asset", info->config);
+	ASSERT_NE(config, (ConfigCategory *)NULL);
+	config->setItemsValueFromDefault();
+	config->setValue("config", programColumns);
+	config->setValue("enable", "true");
+	ReadingSet *outReadings;
+	void *handle = plugin_init(config, &outReadings, Handler);
+
+	vector<string> assets = { "pump1", "pump1", "pump1", "fan", "pump1", "pump2",
+				"fan", "pump1", "pump1", "fan", "pump2", "pump1" };
+	vector<string> expected;
+	for (int i = 0; i < (int)assets.size(); i++)
+	{
+		plugin_ingest(handle, (READINGSET *)makeMixed({ assets[i] }, i));
+		for (auto& reading : outReadings->getAllReadings())
+			expected.push_back(reading->toJSON());
+		delete outReadings;
+	}
+
+	for (int batch = 0; batch < 2; batch++)
+	{
+		plugin_ingest(handle, (READINGSET *)makeMixed(assets, 0));
+		vector<Reading *> results = outReadings->getAllReadings();
+		ASSERT_EQ(results.size(), expected.size());
+		for (unsigned int i = 0; i < results.size(); i++)
+		{
+			ASSERT_EQ(results[i]->toJSON(), expected[i]) << i;
+		}
+		delete outReadings;
+	}
+
+	plugin_shutdown(handle);
+	delete config;
+}
+
+static const char *programDeferred = QUOTE({ "rules" : [
+				{ "asset_name" : "pump.*", "action" : "remove", "datapoint" : "a|d" },
+				{ "asset_name" : "pump.*", "action" : "rename", "new_asset_name" : "motor" },
+				{ "asset_name" : "motor", "action" : "select", "datapoints" : [ "b", "c.*" ] },
+				{ "asset_name" : "motor", "action" : "flatten" },
+				{ "asset_name" : "fan", "action" : "select", "datapoints" : [ "x" ] }
+			] });
+
+// Datapoints removed along the chain of rules are swept before a rule
+// that does not allow removed datapoints and before the output
+TEST(ASSET_PROGRAM, Deferred)
+{
+	PLUGIN_INFORMATION *info = plugin_info();
+	ConfigCategory *config = new ConfigCategory("asset", info->config);
+	ASSERT_NE(config, (ConfigCategory *)NULL);
+	config->setItemsValueFromDefault();
+	config->setValue("config", programDeferred);
+	config->setValue("enable", "true");
+	ReadingSet *outReadings;
+	void *handle = plugin_init(config, &outReadings, Handler);
+
+	vector<string> assets = { "pump1", "fan", "pump2", "pump1", "fan", "pump1" };
+	vector<string> expected;
+	for (int i = 0; i < (int)assets.size(); i++)
+	{
+		plugin_ingest(handle, (READINGSET *)makeMixed({ assets[i] }, i));
+		for (auto& reading : outReadings->getAllReadings())
+		{
+			ASSERT_STREQ(reading->getAssetName().c_str(), "motor");
+			for (auto& dp : reading->getReadingData())
+				ASSERT_NE(dp, (Datapoint *)NULL);
+			expected.push_back(reading->toJSON());
+		}
+		delete outReadings;
+	}
+	ASSERT_EQ(expected.size(), 4U);
+
+	plugin_ingest(handle, (READINGSET *)makeMixed(assets, 0));
+	vector<Reading *> results = outReadings->getAllReadings();
+	ASSERT_EQ(results.size(), expected.size());
+	for (unsigned int i = 0; i < results.size(); i++)
+	{
+		ASSERT_EQ(results[i]->toJSON(), expected[i]) << i;
+	}
+	delete outReadings;
+
+	plugin_shutdown(handle);
+	delete config;
+}
+
+static const char *programFused = QUOTE({ "rules" : [
+				{ "asset_name" : "pump.*", "action" : "remove", "datapoint" : "d" },
+				{ "asset_name" : "pump.*", "action" : "datapointmap", "map" : { "a" : "x", "c1" : "d" } },
+				{ "asset_name" : "pump.*", "action" : "remove", "type" : "string" },
+				{ "asset_name" : "pump.*", "action" : "select", "datapoints" : [ "x", "d", "b" ] },
+				{ "asset_name" : "fan", "action" : "select", "datapoints" : [ "a" ] },
+				{ "asset_name" : "fan", "action" : "remove", "datapoint" : "a" },
+				{ "asset_name" : "valve", "action" : "remove", "datapoint" : "a" },
+				{ "asset_name" : "valve", "action" : "select", "datapoints" : [ "a" ] }
+			] });
+
+// The same rules separated by include rules, which prevent the fusion
+static const char *programUnfused = QUOTE({ "rules" : [
+				{ "asset_name" : "pump.*", "action" : "remove", "datapoint" : "d" },
+				{ "asset_name" : "pump.*", "action" : "include" },
+				{ "asset_name" : "pump.*", "action" : "datapointmap", "map" : { "a" : "x", "c1" : "d" } },
+				{ "asset_name" : "pump.*", "action" : "include" },
+				{ "asset_name" : "pump.*", "action" : "remove", "type" : "string" },
+				{ "asset_name" : "pump.*", "action" : "include" },
+				{ "asset_name" : "pump.*", "action" : "select", "datapoints" : [ "x", "d", "b" ] },
+				{ "asset_name" : "fan", "action" : "select", "datapoints" : [ "a" ] },
+				{ "asset_name" : "fan", "action" : "include" },
+				{ "asset_name" : "fan", "action" : "remove", "datapoint" : "a" },
+				{ "asset_name" : "valve", "action" : "remove", "datapoint" : "a" },
+				{ "asset_name" : "valve", "action" : "include" },
+				{ "asset_name" : "valve", "action" : "select", "datapoints" : [ "a" ] }
+			] });
+
+/**
+ * Ingest readings one at a time and then as a single batch, returning
+ * the JSON of the results of each
+ */
+static void ingestAll(const char *rules, const vector<string>& assets,
+		vector<string>& single, vector<string>& batch)
+{
+	PLUGIN_INFORMATION *info = plugin_info();
+	ConfigCategory *config = new ConfigCategory("asset", info->config);
+	config->setItemsValueFromDefault();
+	config->setValue("config", rules);
+	config->setValue("enable", "true");
+	ReadingSet *outReadings;
+	void *handle = plugin_init(config, &outReadings, Handler);
+
+	for (int i = 0; i < (int)assets.size(); i++)
+	{
+		plugin_ingest(handle, (READINGSET *)makeMixed({ assets[i] }, i));
+		for (auto& reading : outReadings->getAllReadings())
+			single.push_back(reading->toJSON());
+		delete outReadings;
+	}
+	plugin_ingest(handle, (READINGSET *)makeMixed(assets, 0));
+	for (auto& reading : outReadings->getAllReadings())
+		batch.push_back(reading->toJSON());
+	delete outReadings;
+
+	plugin_shutdown(handle);
+	delete config;
+}
+
+// Fused rules give the same results as the rules executed one at a time
+TEST(ASSET_PROGRAM, Fused)
+{
+	vector<string> assets = { "pump1", "fan", "valve", "pump2", "pump1", "fan",
+				"pump1", "valve", "pump2", "pump1" };
+	vector<string> fusedSingle, fusedBatch, single, batch;
+	ingestAll(programFused, assets, fusedSingle, fusedBatch);
+	ingestAll(programUnfused, assets, single, batch);
+
+	// The valve readings are dropped by the select rule
+	ASSERT_EQ(single.size(), 8U);
+	ASSERT_EQ(fusedSingle, single);
+	ASSERT_EQ(fusedBatch, single);
+	ASSERT_EQ(batch, single);
+}
+
+/**
+ * A rule of a class the program does not know, which the program
+ * must execute through the Rule interface
+ */
+class AppendRule : public Rule {
+	public:
+		AppendRule(const string& asset) : Rule("test", asset) {};
+		void	execute(Reading *reading, vector<Reading *>& out)
+			{
+				DatapointValue value(99L);
+				reading->addDatapoint(new Datapoint("appended", value));
+				out.emplace_back(reading);
+			};
+};
+
+/**
+ * Create a rule from its JSON definition, for the asset "pump" unless
+ * the definition gives an asset name
+ */
+static Rule *makeRule(const char *json)
+{
+	Document doc;
+	doc.Parse(json);
+	string action = doc["action"].GetString();
+	string asset = doc.HasMember("asset_name") ? doc["asset_name"].GetString() : "pump";
+	if (action.compare("include") == 0)
+		return new IncludeRule("test", asset, doc);
+	if (action.compare("exclude") == 0)
+		return new ExcludeRule("test", asset, doc);
+	if (action.compare("rename") == 0)
+		return new RenameRule("test", asset, doc);
+	if (action.compare("remove") == 0)
+		return new RemoveRule("test", asset, doc);
+	if (action.compare("flatten") == 0)
+		return new FlattenRule("test", asset, doc);
+	if (action.compare("datapointmap") == 0)
+		return new DatapointMapRule("test", asset, doc);
+	if (action.compare("split") == 0)
+		return new SplitRule("test", asset, doc);
+	if (action.compare("select") == 0)
+		return new SelectRule("test", asset, doc);
+	if (action.compare("nest") == 0)
+		return new NestRule("test", asset, doc);
+	return new AppendRule("pump");
+}
+
+/**
+ * Run a list of rules on a reading through a compiled program, and by
+ * calling the execute method of each rule in turn, and return the JSON
+ * of the results of each. If the program may be run grouped the reading
+ * is also run grouped, twice so that the second run uses the column
+ * plans built by the first, and the results of each run are returned.
+ */
+static void runBoth(const vector<const char *>& definitions, vector<string>& program,
+		vector<string>& direct, vector<string>& grouped)
+{
+	vector<Rule *> rules;
+	for (auto definition : definitions)
+		rules.push_back(makeRule(definition));
+	RuleIndex index;
+	index.build(rules);
+	MatchCache cache(index);
+	RuleProgram compiled(cache);
+	compiled.compile(rules);
+
+	ReadingSet *readings = makeReadings({ "pump" }, { "a", "b", "c" });
+	vector<Reading *> out;
+	compiled.run(readings->getAllReadings()[0], out);
+	readings->clear();
+	for (auto& reading : out)
+	{
+		program.push_back(reading->toJSON());
+		delete reading;
+	}
+
+	delete readings;
+	for (int i = 0; i < 2 && compiled.canGroup(); i++)
+	{
+		readings = makeReadings({ "pump" }, { "a", "b", "c" });
+		out.clear();
+		compiled.runGrouped(readings->getAllReadings(), NULL, out);
+		readings->clear();
+		for (auto& reading : out)
+		{
+			grouped.push_back(reading->toJSON());
+			delete reading;
+		}
+		delete readings;
+	}
+
+	readings = makeReadings({ "pump" }, { "a", "b", "c" });
+	vector<Reading *> current = readings->getAllReadings();
+	readings->clear();
+	for (auto& rule : rules)
+	{
+		vector<Reading *> next;
+		for (auto& reading : current)
+			rule->execute(reading, next);
+		current = next;
+	}
+	for (auto& reading : current)
+	{
+		direct.push_back(reading->toJSON());
+		delete reading;
+	}
+	delete readings;
+
+	for (auto& rule : rules)
+		delete rule;
+}
+
+// Every op code of the program executes its rule as the rule's own
+// execute method does
+TEST(ASSET_PROGRAM, EveryOpCode)
+{
+	vector<vector<const char *> > programs = {
+		{ QUOTE({ "action" : "include" }) },
+		{ QUOTE({ "action" : "exclude" }) },
+		{ QUOTE({ "action" : "rename", "new_asset_name" : "Pump" }) },
+		{ QUOTE({ "action" : "remove", "datapoint" : "b" }) },
+		{ QUOTE({ "action" : "nest", "nest" : { "n" : [ "a", "c" ] } }),
+			QUOTE({ "action" : "flatten" }) },
+		{ QUOTE({ "action" : "datapointmap", "map" : { "a" : "x" } }) },
+		{ QUOTE({ "action" : "split" }) },
+		{ QUOTE({ "action" : "select", "datapoints" : [ "a", "c" ] }) },
+		{ QUOTE({ "action" : "nest", "nest" : { "n" : [ "a", "b" ] } }) },
+		{ QUOTE({ "action" : "append" }) },
+		// Consecutive datapoint rules for the same asset are fused
+		{ QUOTE({ "action" : "remove", "datapoint" : "b" }),
+			QUOTE({ "action" : "datapointmap", "map" : { "a" : "x" } }),
+			QUOTE({ "action" : "select", "datapoints" : [ "x" ] }) }
+	};
+	for (unsigned int i = 0; i < programs.size(); i++)
+	{
+		vector<string> program, direct, grouped;
+		runBoth(programs[i], program, direct, grouped);
+		// Only the exclude rule drops the reading
+		ASSERT_EQ(direct.empty(), i == 1) << i;
+		ASSERT_EQ(program, direct) << i;
+	}
+}
+
+// Every kernel of the rename, remove and select ops executes its rule
+// as the rule's own execute method does, a reading at a time and
+// grouped with column plans
+TEST(ASSET_PROGRAM, EveryKernel)
+{
+	vector<const char *> kernels = {
+		QUOTE({ "action" : "rename", "new_asset_name" : "Pump" }),
+		QUOTE({ "asset_name" : "p(u)mp", "action" : "rename", "new_asset_name" : "P$1MP" }),
+		QUOTE({ "action" : "remove", "datapoint" : "" }),
+		QUOTE({ "action" : "remove", "datapoint" : "b" }),
+		QUOTE({ "action" : "remove", "datapoint" : "[ab]" }),
+		QUOTE({ "action" : "remove", "datapoints" : [ "a", "c.*" ] }),
+		QUOTE({ "action" : "remove", "type" : "integer" }),
+		QUOTE({ "action" : "remove", "type" : "string" }),
+		QUOTE({ "action" : "remove", "type" : "number" }),
+		QUOTE({ "action" : "remove", "type" : "non-numeric" }),
+		QUOTE({ "action" : "remove", "type" : "user_array" }),
+		QUOTE({ "action" : "select", "datapoint" : "c" }),
+		QUOTE({ "action" : "select", "datapoint" : "[bc]" }),
+		QUOTE({ "action" : "select", "datapoints" : [ "a", "b.*" ] }),
+		QUOTE({ "action" : "select", "datapoints" : [ "x" ] }),
+		QUOTE({ "action" : "select", "type" : "integer" }),
+		QUOTE({ "action" : "select", "type" : "string" }),
+		QUOTE({ "action" : "select", "type" : "number" }),
+		QUOTE({ "action" : "select", "type" : "non-numeric" }),
+		QUOTE({ "action" : "select", "type" : "user_array" })
+	};
+	for (unsigned int i = 0; i < kernels.size(); i++)
+	{
+		vector<string> program, direct, grouped;
+		runBoth({ kernels[i] }, program, direct, grouped);
+		ASSERT_EQ(program, direct) << kernels[i];
+		vector<string> twice = direct;
+		twice.insert(twice.end(), direct.begin(), direct.end());
+		ASSERT_EQ(grouped, twice) << kernels[i];
+	}
+}
@@ -0,0 +1,235 @@
+#include <gtest/gtest.h>
+#include <plugin_api.h>
+#include <config_category.h>
+#include <filter_plugin.h>
+#include <filter.h>
+#include <string.h>
+#include <string>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <rapidjson/document.h>
+#include <reading.h>
+#include <reading_set.h>
+#include "test_helpers.h"
+
+using namespace std;
+using namespace rapidjson;
+
+static const char *reconfigureFirst = QUOTE({ "rules" : [
+				{ "asset_name" : "pump.*", "action" : "rename", "new_asset_name" : "first" },
+				{ "asset_name" : "first", "action" : "datapointmap", "map" : { "speed" : "rpm" } }
+			], "defaultAction" : "exclude" });
+
+static const char *reconfigureSecond = QUOTE({ "rules" : [
+				{ "asset_name" : "pump.*", "action" : "rename", "new_asset_name" : "second" },
+				{ "asset_name" : "second", "action" : "remove", "datapoint" : "speed" }
+			], "defaultAction" : "include" });
+
+/**
+ * Check that a set of results was produced by just one of the
+ * configurations
+ */
+static bool consistent(const vector<Reading *>& results)
+{
+	if (results.size() == 3)
+	{
+		for (auto& reading : results)
+		{
+			if (reading->getAssetName().compare("first") != 0
+					|| reading->getDatapoint("rpm") == NULL)
+				return false;
+		}
+		return true;
+	}
+	if (results.size() == 4)
+	{
+		for (auto& reading : results)
+		{
+			if (reading->getAssetName().compare("fan1") == 0)
+				continue;
+			if (reading->getAssetName().compare("second") != 0
+					|| reading->getDatapointCount() != 1)
+				return false;
+		}
+		return true;
+	}
+	return false;
+}
+
+// Each set of readings uses the configuration that was current when
+// it arrived, the default rule is replaced along with the rules
+TEST(ASSET_RECONFIGURE, NextBatch)
+{
+	PLUGIN_INFORMATION *info = plugin_info();
+	ConfigCategory *config = new ConfigCategory("asset", info->config);
+	ASSERT_NE(config, (ConfigCategory *)NULL);
+	config->setItemsValueFromDefault();
+	config->setValue("config", reconfigureFirst);
+	config->setValue("enable", "true");
+	ReadingSet *outReadings;
+	void *handle = plugin_init(config, &outReadings, Handler);
+
+	plugin_ingest(handle, (READINGSET *)makeReadings({ "pump1", "fan1" }, { "speed", "level" }));
+	vector<Reading *> results = outReadings->getAllReadings();
+	ASSERT_EQ(results.size(), 1);
+	ASSERT_STREQ(results[0]->getAssetName().c_str(), "first");
+	ASSERT_EQ(results[0]->getDatapoint("rpm") != NULL, true);
+	delete outReadings;
+
+	config->setValue("config", reconfigureSecond);
+	config->setValue("waitForRules", "true");
+	plugin_reconfigure(handle, config->itemsToJSON());
+
+	plugin_ingest(handle, (READINGSET *)makeReadings({ "pump1", "fan1" }, { "speed", "level" }));
+	results = outReadings->getAllReadings();
+	ASSERT_EQ(results.size(), 2);
+	ASSERT_STREQ(results[0]->getAssetName().c_str(), "second");
+	ASSERT_EQ(results[0]->getDatapointCount(), 1);
+	ASSERT_STREQ(results[1]->getAssetName().c_str(), "fan1");
+	delete outReadings;
+
+	plugin_shutdown(handle);
+	delete config;
+}
+
+// Reconfiguring the filter while readings are being processed never
+// mixes the two configurations within a set of readings
+TEST(ASSET_RECONFIGURE, Concurrent)
+{
+	PLUGIN_INFORMATION *info = plugin_info();
+	ConfigCategory *config = new ConfigCategory("asset", info->config);
+	ASSERT_NE(config, (ConfigCategory *)NULL);
+	config->setItemsValueFromDefault();
+	config->setValue("config", reconfigureFirst);
+	config->setValue("enable", "true");
+	ReadingSet *outReadings;
+	void *handle = plugin_init(config, &outReadings, Handler);
+
+	ConfigCategory first(*config);
+	ConfigCategory second(*config);
+	second.setValue("config", reconfigureSecond);
+	string configs[2] = { first.itemsToJSON(), second.itemsToJSON() };
+
+	atomic<bool> stop(false);
+	thread reconfigure([&]() {
+		for (int i = 0; !stop; i++)
+			plugin_reconfigure(handle, configs[i % 2]);
+	});
+
+	int mixed = 0;
+	for (int batch = 0; batch < 200; batch++)
+	{
+		plugin_ingest(handle, (READINGSET *)makeReadings({ "pump1", "fan1", "pump2", "pump3" }, { "speed", "level" }));
+		if (!consistent(outReadings->getAllReadings()))
+			mixed++;
+		delete outReadings;
+	}
+	stop = true;
+	reconfigure.join();
+	ASSERT_EQ(mixed, 0);
+
+	plugin_shutdown(handle);
+	delete config;
+}
+
+/**
+ * Check that a set of results was passed on unchanged by a filter
+ * that is not enabled
+ */
+static bool unchanged(const vector<Reading *>& results)
+{
+	const char *assets[] = { "pump1", "fan1", "pump2", "pump3" };
+	if (results.size() != 4)
+		return false;
+	for (int i = 0; i < 4; i++)
+	{
+		if (results[i]->getAssetName().compare(assets[i]) != 0
+				|| results[i]->getDatapointCount() != 2)
+			return false;
+	}
+	return true;
+}
+
+// Enabling and disabling the filter takes effect along with the rules,
+// a set of readings is either processed by the rules or passed on
+// unchanged, whatever the reconfigurations made while it is processed
+TEST(ASSET_RECONFIGURE, Enable)
+{
+	PLUGIN_INFORMATION *info = plugin_info();
+	ConfigCategory *config = new ConfigCategory("asset", info->config);
+	ASSERT_NE(config, (ConfigCategory *)NULL);
+	config->setItemsValueFromDefault();
+	config->setValue("config", reconfigureFirst);
+	config->setValue("enable", "true");
+	ReadingSet *outReadings;
+	void *handle = plugin_init(config, &outReadings, Handler);
+
+	ConfigCategory enabled(*config);
+	ConfigCategory disabled(*config);
+	disabled.setValue("enable", "false");
+	disabled.setValue("waitForRules", "true");
+	plugin_reconfigure(handle, disabled.itemsToJSON());
+	plugin_ingest(handle, (READINGSET *)makeReadings({ "pump1", "fan1", "pump2", "pump3" }, { "speed", "level" }));
+	ASSERT_TRUE(unchanged(outReadings->getAllReadings()));
+	delete outReadings;
+
+	string configs[2] = { enabled.itemsToJSON(), disabled.itemsToJSON() };
+	atomic<bool> stop(false);
+	thread reconfigure([&]() {
+		for (int i = 0; !stop; i++)
+			plugin_reconfigure(handle, configs[i % 2]);
+	});
+
+	int mixed = 0;
+	for (int batch = 0; batch < 200; batch++)
+	{
+		plugin_ingest(handle, (READINGSET *)makeReadings({ "pump1", "fan1", "pump2", "pump3" }, { "speed", "level" }));
+		vector<Reading *> results = outReadings->getAllReadings();
+		if (!consistent(results) && !unchanged(results))
+			mixed++;
+		delete outReadings;
+	}
+	stop = true;
+	reconfigure.join();
+	ASSERT_EQ(mixed, 0);
+
+	plugin_shutdown(handle);
+	delete config;
+}
+
+// The new rules are built in the background, the previous rules are
+// used until they are ready
+TEST(ASSET_RECONFIGURE, Background)
+{
+	PLUGIN_INFORMATION *info = plugin_info();
+	ConfigCategory *config = new ConfigCategory("asset", info->config);
+	ASSERT_NE(config, (ConfigCategory *)NULL);
+	config->setItemsValueFromDefault();
+	config->setValue("config", reconfigureFirst);
+	config->setValue("enable", "true");
+	ReadingSet *outReadings;
+	void *handle = plugin_init(config, &outReadings, Handler);
+
+	config->setValue("config", reconfigureSecond);
+	plugin_reconfigure(handle, config->itemsToJSON());
+
+	int mixed = 0;
+	bool replaced = false;
+	for (int batch = 0; batch < 5000 && !replaced; batch++)
+	{
+		plugin_ingest(handle, (READINGSET *)makeReadings({ "pump1", "fan1", "pump2", "pump3" }, { "speed", "level" }));
+		vector<Reading *> results = outReadings->getAllReadings();
+		if (!consistent(results))
+			mixed++;
+		replaced = results.size() == 4;
+		delete outReadings;
+		if (!replaced)
+			this_thread::sleep_for(chrono::milliseconds(1));
+	}
+	ASSERT_EQ(mixed, 0);
+	ASSERT_EQ(replaced, true);
+
+	plugin_shutdown(handle);
+	delete config;
+}
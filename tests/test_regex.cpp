@@ -8,6 +8,8 @@
 #include <rapidjson/document.h>
 #include <reading.h>
 #include <reading_set.h>
+#include <regex_engine.h>
+#include <regex>
 
 using namespace std;
 using namespace rapidjson;
@@ -31,6 +33,7 @@ static const char *renameTest = "{ \"rules\" : [ { \"asset_name\" : \"^Tank.*\",
 static const char *dpmapTest = "{ \"rules\" : [ { \"asset_name\" : \".*Camera$\", \"action\" : \"datapointmap\", \"map\" : { \"ISO\" : \"Light Sensitivity\" } } ] }";
 static const char *removeTest = "{ \"rules\" : [ { \"asset_name\" : \".*\", \"action\" : \"remove\", \"datapoint\" : \"value\" } ] }";
 static const char *removeTest2 = "{ \"rules\" : [ { \"asset_name\" : \".*\", \"action\" : \"remove\", \"datapoint\" : \".*scale\" } ] }";
+static const char *captureTest = "{ \"rules\" : [ { \"asset_name\" : \"pump(\\\\d+)\", \"action\" : \"rename\", \"new_asset_name\" : \"Pump_$1\" }, { \"asset_name\" : \"Pump_.*\", \"action\" : \"datapointmap\", \"map\" : { \"(.*)_raw\" : \"$1\" } } ] }";
 static const char *nonregexrenameTest = "{ \"rules\" : [ { \"asset_name\" : \"Pressure\", \"action\" : \"rename\", \"new_asset_name\" : \"aa?Ov*r[u1,4]\" } ] }";
 
 // Regular expression checked for
@@ -432,3 +435,88 @@ TEST(ASSET_REGEX, nonregexrename)
 	plugin_shutdown(handle);
 	delete config;
 }
+
+// The linear regular expression engine gives the same substitutions
+// as the standard engine
+TEST(ASSET_REGEX, linearEngine)
+{
+	PLUGIN_INFORMATION *info = plugin_info();
+	ConfigCategory *config = new ConfigCategory("asset", info->config);
+	ASSERT_NE(config, (ConfigCategory *)NULL);
+	config->setItemsValueFromDefault();
+	ASSERT_EQ(config->itemExists("regexEngine"), true);
+	config->setValue("config", captureTest);
+	config->setValue("regexEngine", "Linear");
+	config->setValue("enable", "true");
+	ReadingSet *outReadings;
+	void *handle = plugin_init(config, &outReadings, Handler);
+	vector<Reading *> *readings = new vector<Reading *>;
+
+	long testValue = 1000;
+	DatapointValue dpv(testValue);
+	Datapoint *value = new Datapoint("speed_raw", dpv);
+	readings->push_back(new Reading("pump42", value));
+
+	testValue = 1001;
+	DatapointValue dpv1(testValue);
+	Datapoint *value1 = new Datapoint("speed_raw", dpv1);
+	readings->push_back(new Reading("pumpA", value1));
+
+	ReadingSet *readingSet = new ReadingSet(readings);
+	delete readings;
+	plugin_ingest(handle, (READINGSET *)readingSet);
+
+	vector<Reading *> results = outReadings->getAllReadings();
+	ASSERT_EQ(results.size(), 2);
+	Reading *out = results[0];
+	ASSERT_STREQ(out->getAssetName().c_str(), "Pump_42");
+	vector<Datapoint *> points = out->getReadingData();
+	ASSERT_EQ(points.size(), 1);
+	ASSERT_STREQ(points[0]->getName().c_str(), "speed");
+
+	out = results[1];
+	ASSERT_STREQ(out->getAssetName().c_str(), "pumpA");
+	points = out->getReadingData();
+	ASSERT_EQ(points.size(), 1);
+	ASSERT_STREQ(points[0]->getName().c_str(), "speed_raw");
+
+	delete outReadings;
+	plugin_shutdown(handle);
+	delete config;
+}
+
+// Repetitions of expressions that can match the empty string are left
+// to the standard engine, which decides their captures differently
+TEST(ASSET_REGEX, linearEmptyLoops)
+{
+	const char *patterns[] = {
+		"(.*?a*?)+",
+		"\\d+(?:^...)*?(.*?)*",
+		"(?:.*?)+",
+		"([ac]?\?)*",
+		"([ac]{1,}|.{0,2})+",
+		"(a*)?"
+	};
+	const char *subjects[] = { "", "cA.", "12ab.", "x", "aAc.1", "a" };
+	for (auto pattern : patterns)
+	{
+		for (bool icase : { false, true })
+		{
+			Regex linear(pattern, LINEAR_REGEX, icase);
+			ASSERT_EQ(linear.isLinear(), false);
+			regex standard(pattern, icase ? regex::ECMAScript | regex::icase : regex::ECMAScript);
+			for (auto subject : subjects)
+			{
+				ASSERT_EQ(linear.replace(subject, "<$&|$1>"),
+						regex_replace(string(subject), standard, string("<$&|$1>")));
+				ASSERT_EQ(linear.match(subject), regex_match(string(subject), standard));
+			}
+		}
+	}
+
+	// Repetitions that always consume a character still use the
+	// linear engine
+	Regex linear("(a+?c)*(\\d*)", LINEAR_REGEX);
+	ASSERT_EQ(linear.isLinear(), true);
+	ASSERT_EQ(linear.replace("acaac12", "<$1|$2>"), "<aac|12><|>");
+}
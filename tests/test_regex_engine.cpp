@@ -0,0 +1,125 @@
+#include <gtest/gtest.h>
+#include <regex_engine.h>
+#include <regex>
+#include <string>
+
+using namespace std;
+
+static const char *patterns[] = {
+	"pump(\\d+)",
+	"(\\w+)_(\\w+)",
+	"(a|ab)(c|bcd)(d*)",
+	"a*?",
+	"x*",
+	"(.*)\\.(.*)",
+	"(.*?)\\.(.*)",
+	"^(fan)",
+	"(speed)$",
+	"[A-Z]",
+	"(?:ab)+",
+	"()"
+};
+
+static const char *subjects[] = {
+	"", "pump12", "motor_speed", "abcd", "abcdd", "xaxx",
+	"a.b.c", "fan1_speed", "Pump2", "ababx", "speed"
+};
+
+static const char *formats[] = {
+	"$1", "[$&]", "$2-$1", "$$x", "<$`|$'>", "$9$", "$0$12", "z$"
+};
+
+/**
+ * The linear engine must match and substitute exactly as the
+ * standard library does
+ */
+TEST(REGEX_ENGINE, AgreesWithStandard)
+{
+	for (auto pattern : patterns)
+	{
+		Regex linear(pattern, LINEAR_REGEX);
+		ASSERT_TRUE(linear.isLinear()) << pattern;
+		regex standard(pattern);
+		for (auto subject : subjects)
+		{
+			ASSERT_EQ(linear.match(subject), regex_match(subject, standard))
+				<< pattern << " " << subject;
+			for (auto format : formats)
+			{
+				ASSERT_EQ(linear.replace(subject, format),
+						regex_replace(subject, standard, format))
+					<< pattern << " " << subject << " " << format;
+			}
+		}
+	}
+}
+
+/**
+ * Unsupported expressions fall back to the standard library
+ * and invalid expressions are still rejected
+ */
+TEST(REGEX_ENGINE, Fallback)
+{
+	Regex backref("(a)\\1", LINEAR_REGEX);
+	ASSERT_FALSE(backref.isLinear());
+	ASSERT_TRUE(backref.match("aa"));
+	ASSERT_EQ(backref.replace("xaay", "-"), "x-y");
+
+	Regex standard("pump.*");
+	ASSERT_FALSE(standard.isLinear());
+
+	ASSERT_THROW(Regex("(pump", LINEAR_REGEX), regex_error);
+}
+
+/**
+ * Ignoring case within the automaton, or by folding the expression
+ * for the standard library, must agree with the icase flag of the
+ * standard library, including negated classes
+ */
+TEST(REGEX_ENGINE, IgnoreCase)
+{
+	const char *icasePatterns[] = {
+		"pump(\\d+)", "PUMP\\d", "[a-z]+", "[^p]ump\\d+", "[^A-Z_]+_(\\w+)",
+		"(Fan|motor)_SPEED", "\\W", "[\\D]+"
+	};
+	const char *icaseSubjects[] = {
+		"", "pump12", "PUMP12", "Pump2", "motor_speed", "MOTOR_Speed",
+		"fan_SPEED", "xUMP3", "_", "ABC"
+	};
+	for (auto pattern : icasePatterns)
+	{
+		Regex linear(pattern, LINEAR_REGEX, true);
+		ASSERT_TRUE(linear.isLinear()) << pattern;
+		Regex fallback(pattern, STANDARD_REGEX, true);
+		regex standard(pattern, regex::ECMAScript | regex::icase);
+		for (auto subject : icaseSubjects)
+		{
+			ASSERT_EQ(linear.match(subject), regex_match(subject, standard))
+				<< pattern << " " << subject;
+			ASSERT_EQ(fallback.match(subject), regex_match(subject, standard))
+				<< pattern << " " << subject;
+			ASSERT_EQ(linear.replace(subject, "$1<$&>"),
+					regex_replace(subject, standard, "$1<$&>"))
+				<< pattern << " " << subject;
+			ASSERT_EQ(fallback.replace(subject, "$1<$&>$'"),
+					regex_replace(subject, standard, "$1<$&>$'"))
+				<< pattern << " " << subject;
+		}
+	}
+
+	// Expressions that cannot be folded use the icase flag
+	const char *unfolded[] = { "[X-c]+", "\\x50ump\\d+", "[0-Z]+" };
+	for (auto pattern : unfolded)
+	{
+		Regex fallback(pattern, STANDARD_REGEX, true);
+		regex standard(pattern, regex::ECMAScript | regex::icase);
+		for (auto subject : icaseSubjects)
+		{
+			ASSERT_EQ(fallback.match(subject), regex_match(subject, standard))
+				<< pattern << " " << subject;
+			ASSERT_EQ(fallback.replace(subject, "<$&>"),
+					regex_replace(subject, standard, "<$&>"))
+				<< pattern << " " << subject;
+		}
+	}
+}
@@ -0,0 +1,175 @@
+/*
+ * Fledge "asset" filter plugin worker pool.
+ *
+ * Copyright (c) 2025 Dianomic Systems
+ *
+ * Released under the Apache 2.0 Licence
+ *
+ * Author: Mark Riddoch
+ */
+#include <worker_pool.h>
+
+using namespace std;
+
+/**
+ * Pack the range of tasks held by a queue into a single word
+ */
+static inline uint64_t packRange(unsigned int first, unsigned int end)
+{
+	return ((uint64_t)first << 32) | end;
+}
+
+/**
+ * Construct a worker pool. The thread that runs a job takes part
+ * in it, so one fewer threads than requested are created.
+ *
+ * @param threads	The number of threads that run each job
+ */
+WorkerPool::WorkerPool(unsigned int threads) : m_queues(threads < 1 ? 1 : threads),
+		m_task(NULL), m_active(0), m_job(0), m_shutdown(false)
+{
+	for (unsigned int i = 1; i < m_queues.size(); i++)
+		m_threads.emplace_back(&WorkerPool::worker, this, i);
+}
+
+/**
+ * Destructor for the worker pool, stops the threads
+ */
+WorkerPool::~WorkerPool()
+{
+	{
+		lock_guard<mutex> guard(m_mutex);
+		m_shutdown = true;
+		m_startCV.notify_all();
+	}
+	for (auto& thread : m_threads)
+		thread.join();
+}
+
+/**
+ * Run a job. The task function is called once with each task
+ * number, in any order and on any of the workers of the pool,
+ * together with the number of the worker that runs it.
+ *
+ * @param tasks	The number of tasks in the job
+ * @param task	The function that runs a task
+ */
+void WorkerPool::run(unsigned int tasks,
+		const function<void(unsigned int, unsigned int)>& task)
+{
+	unique_lock<mutex> lck(m_mutex);
+	// A thread that woke too late to take part in the previous
+	// job may still be looking for a task
+	m_doneCV.wait(lck, [this]() { return m_active == 0; });
+	unsigned int workers = m_queues.size();
+	for (unsigned int i = 0; i < workers; i++)
+	{
+		m_queues[i].m_range = packRange(
+				(unsigned int)((uint64_t)tasks * i / workers),
+				(unsigned int)((uint64_t)tasks * (i + 1) / workers));
+	}
+	m_task = &task;
+	m_job++;
+	m_startCV.notify_all();
+	lck.unlock();
+
+	execute(0);
+
+	lck.lock();
+	m_doneCV.wait(lck, [this]() { return m_active == 0; });
+	m_task = NULL;
+}
+
+/**
+ * The body of each thread of the pool. Wait for a job and take part
+ * in it.
+ *
+ * @param id	The number of the worker
+ */
+void WorkerPool::worker(unsigned int id)
+{
+	unsigned long job = 0;
+	unique_lock<mutex> lck(m_mutex);
+	while (true)
+	{
+		m_startCV.wait(lck, [this, job]() { return m_shutdown || m_job != job; });
+		if (m_shutdown)
+			return;
+		job = m_job;
+		m_active++;
+		lck.unlock();
+
+		execute(id);
+
+		lck.lock();
+		if (--m_active == 0)
+			m_doneCV.notify_all();
+	}
+}
+
+/**
+ * Run tasks of the current job, first from the worker's own queue
+ * then from the queues of other workers, until none remain
+ *
+ * @param worker	The number of the worker
+ */
+void WorkerPool::execute(unsigned int worker)
+{
+	unsigned int task;
+	while (take(worker, task) || steal(worker, task))
+		(*m_task)(worker, task);
+}
+
+/**
+ * Take the task at the front of a worker's own queue
+ *
+ * @param worker	The number of the worker
+ * @param task		Set to the task taken
+ * @return bool		False if the queue is empty
+ */
+bool WorkerPool::take(unsigned int worker, unsigned int& task)
+{
+	atomic<uint64_t>& queue = m_queues[worker].m_range;
+	uint64_t range = queue.load();
+	while (true)
+	{
+		unsigned int first = range >> 32, end = range & 0xffffffff;
+		if (first >= end)
+			return false;
+		if (queue.compare_exchange_weak(range, packRange(first + 1, end)))
+		{
+			task = first;
+			return true;
+		}
+	}
+}
+
+/**
+ * Steal the task at the back of the queue of another worker. The
+ * queues are visited in turn starting with the next worker.
+ *
+ * @param worker	The number of the worker that steals
+ * @param task		Set to the task stolen
+ * @return bool		False if every queue is empty
+ */
+bool WorkerPool::steal(unsigned int worker, unsigned int& task)
+{
+	unsigned int workers = m_queues.size();
+	for (unsigned int i = 1; i < workers; i++)
+	{
+		atomic<uint64_t>& queue = m_queues[(worker + i) % workers].m_range;
+		uint64_t range = queue.load();
+		while (true)
+		{
+			unsigned int first = range >> 32, end = range & 0xffffffff;
+			if (first >= end)
+				break;
+			if (queue.compare_exchange_weak(range, packRange(first, end - 1)))
+			{
+				task = end - 1;
+				return true;
+			}
+		}
+	}
+	return false;
+}